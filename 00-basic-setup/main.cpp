@@ -1,63 +1,1117 @@
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.hpp>
 
-#include <GLFW/glfw3.h>
-
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/vec4.hpp>
-#include <glm/mat4x4.hpp>
+#include <common/command-line.hpp>
+#include <common/deletion-queue.hpp>
+#include <common/device-selection.hpp>
+#include <common/json-writer.hpp>
+#include <common/spirv-reflection.hpp>
+#include <common/statistics.hpp>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
-int main()
+// Dumps the capabilities of every physical device (properties, limits, memory heaps and types,
+// queue families, features and extensions) as JSON and runs a few microbenchmarks on each of them.
+// Runs headless, so it also works on machines without a window system.
+
+constexpr uint32_t DEFAULT_COPY_SIZE_MIB    = 64;
+constexpr uint32_t DEFAULT_COPY_ITERATIONS  = 10;
+constexpr uint32_t DEFAULT_SUBMIT_SAMPLES   = 1000;
+constexpr uint32_t DEFAULT_PIPELINE_SAMPLES = 20;
+
+using Clock = std::chrono::steady_clock;
+
+struct ProbeSettings
+{
+    std::optional<std::string> device;     // Index, UUID or part of the name, all devices if not set
+    std::string                outputPath; // JSON report, stdout if empty
+    bool                       benchmarks      = true;
+    uint32_t                   copySizeMiB     = DEFAULT_COPY_SIZE_MIB;
+    uint32_t                   copyIterations  = DEFAULT_COPY_ITERATIONS;
+    uint32_t                   submitSamples   = DEFAULT_SUBMIT_SAMPLES;
+    uint32_t                   pipelineSamples = DEFAULT_PIPELINE_SAMPLES;
+};
+
+static ProbeSettings parseCommandLine(int argc, char** argv)
+{
+    ProbeSettings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+
+        auto nextValue = [&]() -> std::string {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("missing value for option '" + option + "'");
+            }
+            return argv[++i];
+        };
+
+        if (option == "--device")
+        {
+            settings.device = nextValue();
+        }
+        else if (option == "--output")
+        {
+            settings.outputPath = nextValue();
+        }
+        else if (option == "--no-benchmarks")
+        {
+            settings.benchmarks = false;
+        }
+        else if (option == "--copy-size")
+        {
+            settings.copySizeMiB = parseCount(option, nextValue(), 1U, 4096U);
+        }
+        else if (option == "--copy-iterations")
+        {
+            settings.copyIterations = parseCount(option, nextValue(), 1U, 100000U);
+        }
+        else if (option == "--submit-samples")
+        {
+            settings.submitSamples = parseCount(option, nextValue(), 1U, 1000000U);
+        }
+        else if (option == "--pipeline-samples")
+        {
+            settings.pipelineSamples = parseCount(option, nextValue(), 1U, 100000U);
+        }
+        else
+        {
+            throw std::runtime_error("unknown option '" + option + "'");
+        }
+    }
+
+    return settings;
+}
+
+static std::vector<char> readFile(std::string const& filename)
+{
+    std::ifstream file(filename, std::ios_base::ate | std::ios_base::binary);
+
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open file '" + filename + "'");
+    }
+
+    size_t            fileSize = static_cast<size_t>(file.tellg());
+    std::vector<char> buffer(fileSize);
+
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+
+    return buffer;
+}
+
+static std::string formatVersion(uint32_t version)
+{
+    return std::to_string(VK_VERSION_MAJOR(version)) + "." + std::to_string(VK_VERSION_MINOR(version)) + "." + std::to_string(VK_VERSION_PATCH(version));
+}
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template<typename Bits>
+using FlagNames = std::vector<std::pair<Bits, char const*>>;
+
+template<typename Bits>
+static void writeFlagNames(JsonWriter& json, char const* name, vk::Flags<Bits> flags, FlagNames<Bits> const& names)
+{
+    json.beginArray(name);
+    for (auto const& [bit, bitName] : names)
+    {
+        if (flags & bit)
+        {
+            json.value(bitName);
+        }
+    }
+    json.endArray();
+}
+
+static FlagNames<vk::MemoryPropertyFlagBits> const MEMORY_PROPERTY_NAMES = {
+    {vk::MemoryPropertyFlagBits::eDeviceLocal, "device_local"},
+    {vk::MemoryPropertyFlagBits::eHostVisible, "host_visible"},
+    {vk::MemoryPropertyFlagBits::eHostCoherent, "host_coherent"},
+    {vk::MemoryPropertyFlagBits::eHostCached, "host_cached"},
+    {vk::MemoryPropertyFlagBits::eLazilyAllocated, "lazily_allocated"},
+    {vk::MemoryPropertyFlagBits::eProtected, "protected"},
+};
+
+static FlagNames<vk::MemoryHeapFlagBits> const MEMORY_HEAP_NAMES = {
+    {vk::MemoryHeapFlagBits::eDeviceLocal, "device_local"},
+    {vk::MemoryHeapFlagBits::eMultiInstance, "multi_instance"},
+};
+
+static FlagNames<vk::QueueFlagBits> const QUEUE_NAMES = {
+    {vk::QueueFlagBits::eGraphics, "graphics"},
+    {vk::QueueFlagBits::eCompute, "compute"},
+    {vk::QueueFlagBits::eTransfer, "transfer"},
+    {vk::QueueFlagBits::eSparseBinding, "sparse_binding"},
+    {vk::QueueFlagBits::eProtected, "protected"},
+};
+
+// Features are plain structs of booleans, listed by member so they can be written by name
+template<typename Features>
+using FeatureList = std::vector<std::pair<char const*, vk::Bool32 Features::*>>;
+
+#define FEATURE(type, name) {#name, &type::name}
+
+static FeatureList<vk::PhysicalDeviceFeatures> const CORE_FEATURES = {
+    FEATURE(vk::PhysicalDeviceFeatures, robustBufferAccess),
+    FEATURE(vk::PhysicalDeviceFeatures, fullDrawIndexUint32),
+    FEATURE(vk::PhysicalDeviceFeatures, imageCubeArray),
+    FEATURE(vk::PhysicalDeviceFeatures, independentBlend),
+    FEATURE(vk::PhysicalDeviceFeatures, geometryShader),
+    FEATURE(vk::PhysicalDeviceFeatures, tessellationShader),
+    FEATURE(vk::PhysicalDeviceFeatures, sampleRateShading),
+    FEATURE(vk::PhysicalDeviceFeatures, dualSrcBlend),
+    FEATURE(vk::PhysicalDeviceFeatures, logicOp),
+    FEATURE(vk::PhysicalDeviceFeatures, multiDrawIndirect),
+    FEATURE(vk::PhysicalDeviceFeatures, drawIndirectFirstInstance),
+    FEATURE(vk::PhysicalDeviceFeatures, depthClamp),
+    FEATURE(vk::PhysicalDeviceFeatures, depthBiasClamp),
+    FEATURE(vk::PhysicalDeviceFeatures, fillModeNonSolid),
+    FEATURE(vk::PhysicalDeviceFeatures, depthBounds),
+    FEATURE(vk::PhysicalDeviceFeatures, wideLines),
+    FEATURE(vk::PhysicalDeviceFeatures, largePoints),
+    FEATURE(vk::PhysicalDeviceFeatures, alphaToOne),
+    FEATURE(vk::PhysicalDeviceFeatures, multiViewport),
+    FEATURE(vk::PhysicalDeviceFeatures, samplerAnisotropy),
+    FEATURE(vk::PhysicalDeviceFeatures, textureCompressionETC2),
+    FEATURE(vk::PhysicalDeviceFeatures, textureCompressionASTC_LDR),
+    FEATURE(vk::PhysicalDeviceFeatures, textureCompressionBC),
+    FEATURE(vk::PhysicalDeviceFeatures, occlusionQueryPrecise),
+    FEATURE(vk::PhysicalDeviceFeatures, pipelineStatisticsQuery),
+    FEATURE(vk::PhysicalDeviceFeatures, vertexPipelineStoresAndAtomics),
+    FEATURE(vk::PhysicalDeviceFeatures, fragmentStoresAndAtomics),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderTessellationAndGeometryPointSize),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderImageGatherExtended),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderStorageImageExtendedFormats),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderStorageImageMultisample),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderStorageImageReadWithoutFormat),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderStorageImageWriteWithoutFormat),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderUniformBufferArrayDynamicIndexing),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderSampledImageArrayDynamicIndexing),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderStorageBufferArrayDynamicIndexing),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderStorageImageArrayDynamicIndexing),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderClipDistance),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderCullDistance),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderFloat64),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderInt64),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderInt16),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderResourceResidency),
+    FEATURE(vk::PhysicalDeviceFeatures, shaderResourceMinLod),
+    FEATURE(vk::PhysicalDeviceFeatures, sparseBinding),
+    FEATURE(vk::PhysicalDeviceFeatures, sparseResidencyBuffer),
+    FEATURE(vk::PhysicalDeviceFeatures, sparseResidencyImage2D),
+    FEATURE(vk::PhysicalDeviceFeatures, sparseResidencyImage3D),
+    FEATURE(vk::PhysicalDeviceFeatures, sparseResidency2Samples),
+    FEATURE(vk::PhysicalDeviceFeatures, sparseResidency4Samples),
+    FEATURE(vk::PhysicalDeviceFeatures, sparseResidency8Samples),
+    FEATURE(vk::PhysicalDeviceFeatures, sparseResidency16Samples),
+    FEATURE(vk::PhysicalDeviceFeatures, sparseResidencyAliased),
+    FEATURE(vk::PhysicalDeviceFeatures, variableMultisampleRate),
+    FEATURE(vk::PhysicalDeviceFeatures, inheritedQueries),
+};
+
+static FeatureList<vk::PhysicalDeviceVulkan11Features> const VULKAN11_FEATURES = {
+    FEATURE(vk::PhysicalDeviceVulkan11Features, storageBuffer16BitAccess),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, uniformAndStorageBuffer16BitAccess),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, storagePushConstant16),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, storageInputOutput16),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, multiview),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, multiviewGeometryShader),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, multiviewTessellationShader),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, variablePointersStorageBuffer),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, variablePointers),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, protectedMemory),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, samplerYcbcrConversion),
+    FEATURE(vk::PhysicalDeviceVulkan11Features, shaderDrawParameters),
+};
+
+static FeatureList<vk::PhysicalDeviceVulkan12Features> const VULKAN12_FEATURES = {
+    FEATURE(vk::PhysicalDeviceVulkan12Features, samplerMirrorClampToEdge),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, drawIndirectCount),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, storageBuffer8BitAccess),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, uniformAndStorageBuffer8BitAccess),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, storagePushConstant8),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderBufferInt64Atomics),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderSharedInt64Atomics),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderFloat16),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderInt8),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderInputAttachmentArrayDynamicIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderUniformTexelBufferArrayDynamicIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderStorageTexelBufferArrayDynamicIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderUniformBufferArrayNonUniformIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderSampledImageArrayNonUniformIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderStorageBufferArrayNonUniformIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderStorageImageArrayNonUniformIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderInputAttachmentArrayNonUniformIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderUniformTexelBufferArrayNonUniformIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderStorageTexelBufferArrayNonUniformIndexing),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorBindingUniformBufferUpdateAfterBind),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorBindingSampledImageUpdateAfterBind),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorBindingStorageImageUpdateAfterBind),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorBindingStorageBufferUpdateAfterBind),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorBindingUniformTexelBufferUpdateAfterBind),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorBindingStorageTexelBufferUpdateAfterBind),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorBindingUpdateUnusedWhilePending),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorBindingPartiallyBound),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, descriptorBindingVariableDescriptorCount),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, runtimeDescriptorArray),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, samplerFilterMinmax),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, scalarBlockLayout),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, imagelessFramebuffer),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, uniformBufferStandardLayout),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderSubgroupExtendedTypes),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, separateDepthStencilLayouts),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, hostQueryReset),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, timelineSemaphore),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, bufferDeviceAddress),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, bufferDeviceAddressCaptureReplay),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, bufferDeviceAddressMultiDevice),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, vulkanMemoryModel),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, vulkanMemoryModelDeviceScope),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, vulkanMemoryModelAvailabilityVisibilityChains),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderOutputViewportIndex),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, shaderOutputLayer),
+    FEATURE(vk::PhysicalDeviceVulkan12Features, subgroupBroadcastDynamicId),
+};
+
+#undef FEATURE
+
+template<typename Features>
+static void writeFeatures(JsonWriter& json, char const* name, Features const& features, FeatureList<Features> const& list)
+{
+    json.beginObject(name);
+    for (auto const& [featureName, member] : list)
+    {
+        json.field(featureName, features.*member == VK_TRUE);
+    }
+    json.endObject();
+}
+
+static void writeLimits(JsonWriter& json, vk::PhysicalDeviceLimits const& limits)
+{
+#define LIMIT(name) json.field(#name, limits.name)
+#define LIMIT_BOOL(name) json.field(#name, limits.name == VK_TRUE)
+
+    json.beginObject("limits");
+    LIMIT(maxImageDimension1D);
+    LIMIT(maxImageDimension2D);
+    LIMIT(maxImageDimension3D);
+    LIMIT(maxImageDimensionCube);
+    LIMIT(maxImageArrayLayers);
+    LIMIT(maxTexelBufferElements);
+    LIMIT(maxUniformBufferRange);
+    LIMIT(maxStorageBufferRange);
+    LIMIT(maxPushConstantsSize);
+    LIMIT(maxMemoryAllocationCount);
+    LIMIT(maxSamplerAllocationCount);
+    LIMIT(bufferImageGranularity);
+    LIMIT(sparseAddressSpaceSize);
+    LIMIT(maxBoundDescriptorSets);
+    LIMIT(maxPerStageDescriptorSamplers);
+    LIMIT(maxPerStageDescriptorUniformBuffers);
+    LIMIT(maxPerStageDescriptorStorageBuffers);
+    LIMIT(maxPerStageDescriptorSampledImages);
+    LIMIT(maxPerStageDescriptorStorageImages);
+    LIMIT(maxPerStageDescriptorInputAttachments);
+    LIMIT(maxPerStageResources);
+    LIMIT(maxDescriptorSetSamplers);
+    LIMIT(maxDescriptorSetUniformBuffers);
+    LIMIT(maxDescriptorSetUniformBuffersDynamic);
+    LIMIT(maxDescriptorSetStorageBuffers);
+    LIMIT(maxDescriptorSetStorageBuffersDynamic);
+    LIMIT(maxDescriptorSetSampledImages);
+    LIMIT(maxDescriptorSetStorageImages);
+    LIMIT(maxDescriptorSetInputAttachments);
+    LIMIT(maxVertexInputAttributes);
+    LIMIT(maxVertexInputBindings);
+    LIMIT(maxVertexInputAttributeOffset);
+    LIMIT(maxVertexInputBindingStride);
+    LIMIT(maxVertexOutputComponents);
+    LIMIT(maxTessellationGenerationLevel);
+    LIMIT(maxTessellationPatchSize);
+    LIMIT(maxTessellationControlPerVertexInputComponents);
+    LIMIT(maxTessellationControlPerVertexOutputComponents);
+    LIMIT(maxTessellationControlPerPatchOutputComponents);
+    LIMIT(maxTessellationControlTotalOutputComponents);
+    LIMIT(maxTessellationEvaluationInputComponents);
+    LIMIT(maxTessellationEvaluationOutputComponents);
+    LIMIT(maxGeometryShaderInvocations);
+    LIMIT(maxGeometryInputComponents);
+    LIMIT(maxGeometryOutputComponents);
+    LIMIT(maxGeometryOutputVertices);
+    LIMIT(maxGeometryTotalOutputComponents);
+    LIMIT(maxFragmentInputComponents);
+    LIMIT(maxFragmentOutputAttachments);
+    LIMIT(maxFragmentDualSrcAttachments);
+    LIMIT(maxFragmentCombinedOutputResources);
+    LIMIT(maxComputeSharedMemorySize);
+    LIMIT(maxComputeWorkGroupCount);
+    LIMIT(maxComputeWorkGroupInvocations);
+    LIMIT(maxComputeWorkGroupSize);
+    LIMIT(subPixelPrecisionBits);
+    LIMIT(subTexelPrecisionBits);
+    LIMIT(mipmapPrecisionBits);
+    LIMIT(maxDrawIndexedIndexValue);
+    LIMIT(maxDrawIndirectCount);
+    LIMIT(maxSamplerLodBias);
+    LIMIT(maxSamplerAnisotropy);
+    LIMIT(maxViewports);
+    LIMIT(maxViewportDimensions);
+    LIMIT(viewportBoundsRange);
+    LIMIT(viewportSubPixelBits);
+    LIMIT(minMemoryMapAlignment);
+    LIMIT(minTexelBufferOffsetAlignment);
+    LIMIT(minUniformBufferOffsetAlignment);
+    LIMIT(minStorageBufferOffsetAlignment);
+    LIMIT(minTexelOffset);
+    LIMIT(maxTexelOffset);
+    LIMIT(minTexelGatherOffset);
+    LIMIT(maxTexelGatherOffset);
+    LIMIT(minInterpolationOffset);
+    LIMIT(maxInterpolationOffset);
+    LIMIT(subPixelInterpolationOffsetBits);
+    LIMIT(maxFramebufferWidth);
+    LIMIT(maxFramebufferHeight);
+    LIMIT(maxFramebufferLayers);
+    LIMIT(framebufferColorSampleCounts);
+    LIMIT(framebufferDepthSampleCounts);
+    LIMIT(framebufferStencilSampleCounts);
+    LIMIT(framebufferNoAttachmentsSampleCounts);
+    LIMIT(maxColorAttachments);
+    LIMIT(sampledImageColorSampleCounts);
+    LIMIT(sampledImageIntegerSampleCounts);
+    LIMIT(sampledImageDepthSampleCounts);
+    LIMIT(sampledImageStencilSampleCounts);
+    LIMIT(storageImageSampleCounts);
+    LIMIT(maxSampleMaskWords);
+    LIMIT_BOOL(timestampComputeAndGraphics);
+    LIMIT(timestampPeriod);
+    LIMIT(maxClipDistances);
+    LIMIT(maxCullDistances);
+    LIMIT(maxCombinedClipAndCullDistances);
+    LIMIT(discreteQueuePriorities);
+    LIMIT(pointSizeRange);
+    LIMIT(lineWidthRange);
+    LIMIT(pointSizeGranularity);
+    LIMIT(lineWidthGranularity);
+    LIMIT_BOOL(strictLines);
+    LIMIT_BOOL(standardSampleLocations);
+    LIMIT(optimalBufferCopyOffsetAlignment);
+    LIMIT(optimalBufferCopyRowPitchAlignment);
+    LIMIT(nonCoherentAtomSize);
+    json.endObject();
+
+#undef LIMIT
+#undef LIMIT_BOOL
+}
+
+// Everything the device reports about itself, without creating a logical device
+static void writeCapabilities(JsonWriter& json, DeviceCandidate const& candidate)
+{
+    auto const& properties = candidate.properties;
+
+    json.field("index", candidate.index);
+    json.field("name", candidate.name());
+    json.field("type", deviceTypeName(properties.deviceType));
+    json.field("uuid", formatUuid(candidate.uuid));
+    json.field("api_version", formatVersion(properties.apiVersion));
+    json.field("driver_version", properties.driverVersion); // Encoding is vendor specific
+    json.field("vendor_id", properties.vendorID);
+    json.field("device_id", properties.deviceID);
+    json.field("score", candidate.score);
+
+    // Vulkan 1.2 knows the driver by name, useful to tell driver stacks of the same device apart
+    if (properties.apiVersion >= VK_API_VERSION_1_2)
+    {
+        auto        properties2 = candidate.device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan11Properties, vk::PhysicalDeviceVulkan12Properties>();
+        auto const& vulkan11    = properties2.get<vk::PhysicalDeviceVulkan11Properties>();
+        auto const& vulkan12    = properties2.get<vk::PhysicalDeviceVulkan12Properties>();
+
+        json.field("driver_name", std::string(vulkan12.driverName.data()));
+        json.field("driver_info", std::string(vulkan12.driverInfo.data()));
+        json.field("subgroup_size", vulkan11.subgroupSize);
+        json.field("max_memory_allocation_size", vulkan11.maxMemoryAllocationSize);
+    }
+
+    writeLimits(json, properties.limits);
+
+    auto memoryProperties = candidate.device.getMemoryProperties();
+    json.beginObject("memory");
+    json.beginArray("heaps");
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+    {
+        json.beginObject();
+        json.field("index", i);
+        json.field("size", memoryProperties.memoryHeaps[i].size);
+        writeFlagNames(json, "flags", memoryProperties.memoryHeaps[i].flags, MEMORY_HEAP_NAMES);
+        json.endObject();
+    }
+    json.endArray();
+    json.beginArray("types");
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+    {
+        json.beginObject();
+        json.field("index", i);
+        json.field("heap", memoryProperties.memoryTypes[i].heapIndex);
+        writeFlagNames(json, "flags", memoryProperties.memoryTypes[i].propertyFlags, MEMORY_PROPERTY_NAMES);
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+
+    json.beginArray("queue_families");
+    auto queueFamilies = candidate.device.getQueueFamilyProperties();
+    for (uint32_t i = 0; i < queueFamilies.size(); ++i)
+    {
+        auto const& family      = queueFamilies[i];
+        auto const& granularity = family.minImageTransferGranularity;
+
+        json.beginObject();
+        json.field("index", i);
+        json.field("queue_count", family.queueCount);
+        writeFlagNames(json, "flags", family.queueFlags, QUEUE_NAMES);
+        json.field("timestamp_valid_bits", family.timestampValidBits);
+        json.field("min_image_transfer_granularity", std::array<uint32_t, 3>{granularity.width, granularity.height, granularity.depth});
+        json.endObject();
+    }
+    json.endArray();
+
+    json.beginObject("features");
+    if (properties.apiVersion >= VK_API_VERSION_1_2)
+    {
+        auto features = candidate.device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan12Features>();
+        writeFeatures(json, "core", features.get<vk::PhysicalDeviceFeatures2>().features, CORE_FEATURES);
+        writeFeatures(json, "vulkan11", features.get<vk::PhysicalDeviceVulkan11Features>(), VULKAN11_FEATURES);
+        writeFeatures(json, "vulkan12", features.get<vk::PhysicalDeviceVulkan12Features>(), VULKAN12_FEATURES);
+    }
+    else
+    {
+        writeFeatures(json, "core", candidate.device.getFeatures(), CORE_FEATURES);
+    }
+    json.endObject();
+
+    auto extensions = candidate.device.enumerateDeviceExtensionProperties();
+    std::sort(std::begin(extensions), std::end(extensions), [](auto const& a, auto const& b) { return std::strcmp(a.extensionName.data(), b.extensionName.data()) < 0; });
+
+    json.beginObject("extensions");
+    for (auto const& extension : extensions)
+    {
+        json.field(extension.extensionName.data(), extension.specVersion);
+    }
+    json.endObject();
+}
+
+// Small timed tests on one device. Every test cleans up after itself, also when it fails,
+// so the remaining tests still run.
+class DeviceBenchmark
 {
-    // Vulkan test
-    auto instanceExtensions = vk::enumerateInstanceExtensionProperties();
+public:
+    DeviceBenchmark(DeviceCandidate const& candidate, ProbeSettings const& settings)
+        : m_physicalDevice(candidate.device)
+        , m_settings(settings)
+        , m_timestampPeriod(candidate.properties.limits.timestampPeriod)
+    {
+    }
 
-    std::cout << "Vulkan default instance extensions:" << std::endl;
-    for (auto extension : instanceExtensions)
+    ~DeviceBenchmark()
     {
-        std::cout << extension.extensionName << std::endl;
+        uninitialize();
     }
 
-    vk::ApplicationInfo applicationInfo;
-    applicationInfo.setPApplicationName("Basic Setup");
+    void initialize()
+    {
+        createLogicalDevice();
+        createCommandBuffer();
+        createSyncObjects();
+    }
 
-    vk::InstanceCreateInfo instanceInfo;
-    instanceInfo.setPApplicationInfo(&applicationInfo);
+    void run(JsonWriter& json)
+    {
+        json.field("queue_family", m_queueFamily);
+        json.field("gpu_timed", m_timestampsSupported);
 
-    vk::Instance instance = vk::createInstance(instanceInfo);
+        runTest(json, "copy_bandwidth", [this](JsonWriter& json) { measureCopyBandwidth(json); });
+        runTest(json, "host_bandwidth", [this](JsonWriter& json) { measureHostBandwidth(json); });
+        runTest(json, "submit_latency", [this](JsonWriter& json) { measureSubmitLatency(json); });
+        runTest(json, "pipeline_creation", [this](JsonWriter& json) { measurePipelineCreation(json); });
+    }
+
+private:
+    struct Buffer
+    {
+        vk::Buffer       buffer;
+        vk::DeviceMemory memory;
+    };
 
-    auto physicalDevices = instance.enumeratePhysicalDevices();
-    
-    std::cout << "\nVulkan devices:" << std::endl;
-    for (auto physicalDevice : physicalDevices)
+    // The test writes its results into an object of the given name, or an error if it throws
+    template<typename Test>
+    void runTest(JsonWriter& json, char const* name, Test&& test)
     {
-        auto deviceProperties = physicalDevice.getProperties();
-        std::cout << deviceProperties.deviceName << std::endl;
+        std::cerr << "  " << name << "..." << std::endl;
+
+        std::ostringstream results;
+        JsonWriter         resultsJson(results);
+
+        try
+        {
+            resultsJson.beginObject();
+            test(resultsJson);
+            resultsJson.endObject();
+
+            m_device.waitIdle();
+            m_cleanup.flush();
+        }
+        catch (std::exception const& e)
+        {
+            m_device.waitIdle();
+            m_cleanup.flush();
+
+            std::cerr << "  " << name << " failed: " << e.what() << std::endl;
+            json.beginObject(name);
+            json.field("error", std::string(e.what()));
+            json.endObject();
+            return;
+        }
+
+        // Written only once complete, so a failing test doesn't leave half an object behind
+        json.raw(name, results.str());
     }
 
-    // GLM test
-    glm::mat4 matrix;
-    glm::vec4 vec;
-    auto test = matrix * vec;
+    void createLogicalDevice()
+    {
+        // Graphics and compute queues support transfers as well
+        auto queueFamilies = m_physicalDevice.getQueueFamilyProperties();
+        auto family        = std::find_if(std::begin(queueFamilies), std::end(queueFamilies), [](auto const& f) {
+            return f.queueCount > 0 && (f.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+        });
 
-    // GLFW test
-    glfwInit();
+        if (family == std::end(queueFamilies))
+        {
+            throw std::runtime_error("no graphics or compute queue family");
+        }
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Vulkan window", nullptr, nullptr);
+        m_queueFamily         = static_cast<uint32_t>(std::distance(std::begin(queueFamilies), family));
+        m_timestampsSupported = family->timestampValidBits > 0;
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        float                     priority = 1.0f;
+        vk::DeviceQueueCreateInfo queueCreateInfo;
+        queueCreateInfo.queueFamilyIndex = m_queueFamily;
+        queueCreateInfo.queueCount       = 1U;
+        queueCreateInfo.pQueuePriorities = &priority;
+
+        vk::DeviceCreateInfo createInfo;
+        createInfo.pQueueCreateInfos    = &queueCreateInfo;
+        createInfo.queueCreateInfoCount = 1U;
+
+        m_device = m_physicalDevice.createDevice(createInfo);
+        m_queue  = m_device.getQueue(m_queueFamily, 0U);
+
+        m_pipelineLayoutCache.setDevice(m_device);
+    }
+
+    void createCommandBuffer()
+    {
+        vk::CommandPoolCreateInfo poolInfo;
+        poolInfo.queueFamilyIndex = m_queueFamily;
+        poolInfo.flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+
+        m_commandPool = m_device.createCommandPool(poolInfo);
+
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.commandPool        = m_commandPool;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = 1;
+
+        m_commandBuffer = m_device.allocateCommandBuffers(allocInfo)[0];
     }
 
-    glfwDestroyWindow(window);
+    void createSyncObjects()
+    {
+        m_fence = m_device.createFence(vk::FenceCreateInfo());
+
+        if (m_timestampsSupported)
+        {
+            // Begin and end of the measured commands
+            vk::QueryPoolCreateInfo queryPoolInfo;
+            queryPoolInfo.queryType  = vk::QueryType::eTimestamp;
+            queryPoolInfo.queryCount = 2;
 
-    glfwTerminate();
+            m_queryPool = m_device.createQueryPool(queryPoolInfo);
+        }
+    }
+
+    // Returns the wall clock time from submission to completion in milliseconds
+    double submitAndWait()
+    {
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers    = &m_commandBuffer;
+
+        auto start = Clock::now();
+        m_queue.submit({submitInfo}, m_fence);
+        if (m_device.waitForFences({m_fence}, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+        {
+            throw std::runtime_error("failed to wait for fence");
+        }
+        double duration = millisecondsSince(start);
+
+        m_device.resetFences({m_fence});
+        return duration;
+    }
+
+    // Time between the two timestamps of the last submission in milliseconds
+    double readGpuTime()
+    {
+        uint64_t timestamps[2] = {};
+        auto     result        = m_device.getQueryPoolResults(m_queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+        if (result != vk::Result::eSuccess)
+        {
+            throw std::runtime_error("failed to read timestamps");
+        }
+
+        return (timestamps[1] - timestamps[0]) * m_timestampPeriod / 1e6;
+    }
+
+    // Nothing if the memory type can't back a buffer with this usage
+    std::optional<Buffer> createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, uint32_t memoryType)
+    {
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.size        = size;
+        bufferInfo.usage       = usage;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+        Buffer buffer;
+        buffer.buffer = m_device.createBuffer(bufferInfo);
+        m_cleanup.push(0, [this, handle = buffer.buffer]() { m_device.destroyBuffer(handle); });
+
+        auto memoryRequirements = m_device.getBufferMemoryRequirements(buffer.buffer);
+        if (!(memoryRequirements.memoryTypeBits & (1U << memoryType)))
+        {
+            return std::nullopt;
+        }
+
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        buffer.memory = m_device.allocateMemory(allocInfo);
+        m_cleanup.push(0, [this, handle = buffer.memory]() { m_device.freeMemory(handle); });
+        m_device.bindBufferMemory(buffer.buffer, buffer.memory, 0);
+
+        return buffer;
+    }
+
+    // Skips memory types that are too small for two buffers of requiredSize or can't be used for plain buffers
+    bool isMemoryTypeTestable(uint32_t memoryType, vk::DeviceSize requiredSize)
+    {
+        auto memoryProperties = m_physicalDevice.getMemoryProperties();
+        auto flags            = memoryProperties.memoryTypes[memoryType].propertyFlags;
+        auto heapSize         = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+
+        return !(flags & (vk::MemoryPropertyFlagBits::eLazilyAllocated | vk::MemoryPropertyFlagBits::eProtected)) && heapSize >= 2 * requiredSize;
+    }
+
+    // GPU copies between two buffers of the same memory type
+    void measureCopyBandwidth(JsonWriter& json)
+    {
+        vk::DeviceSize size             = vk::DeviceSize(m_settings.copySizeMiB) << 20;
+        auto           memoryProperties = m_physicalDevice.getMemoryProperties();
+
+        json.field("size", size);
+        json.beginArray("memory_types");
+
+        for (uint32_t memoryType = 0; memoryType < memoryProperties.memoryTypeCount; ++memoryType)
+        {
+            if (!isMemoryTypeTestable(memoryType, size))
+            {
+                continue;
+            }
+
+            auto usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+            auto src   = createBuffer(size, usage, memoryType);
+            auto dst   = createBuffer(size, usage, memoryType);
+
+            if (src && dst)
+            {
+                m_commandBuffer.begin(vk::CommandBufferBeginInfo());
+                if (m_timestampsSupported)
+                {
+                    m_commandBuffer.resetQueryPool(m_queryPool, 0, 2);
+                    m_commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool, 0);
+                }
+
+                for (uint32_t i = 0; i < m_settings.copyIterations; ++i)
+                {
+                    m_commandBuffer.copyBuffer(src->buffer, dst->buffer, vk::BufferCopy(0, 0, size));
+
+                    // The copies write the same buffer, they have to run one after the other
+                    vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferWrite);
+                    m_commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), barrier, nullptr, nullptr);
+                }
+
+                if (m_timestampsSupported)
+                {
+                    m_commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 1);
+                }
+                m_commandBuffer.end();
+
+                // The first submission pays for the first use of the memory
+                submitAndWait();
+                double milliseconds = submitAndWait();
+                if (m_timestampsSupported)
+                {
+                    milliseconds = readGpuTime();
+                }
+
+                json.beginObject();
+                json.field("index", memoryType);
+                writeFlagNames(json, "flags", memoryProperties.memoryTypes[memoryType].propertyFlags, MEMORY_PROPERTY_NAMES);
+                json.field("gb_per_second", static_cast<double>(size) * m_settings.copyIterations / (milliseconds * 1e6));
+                json.endObject();
+            }
+
+            // Free the buffers before allocating the next pair
+            m_device.waitIdle();
+            m_cleanup.flush();
+        }
+
+        json.endArray();
+    }
+
+    // Writes to and reads from mapped memory of every host visible memory type
+    void measureHostBandwidth(JsonWriter& json)
+    {
+        vk::DeviceSize size             = vk::DeviceSize(m_settings.copySizeMiB) << 20;
+        auto           memoryProperties = m_physicalDevice.getMemoryProperties();
+
+        std::vector<uint8_t> hostData(size, 0x5A);
+
+        json.field("size", size);
+        json.beginArray("memory_types");
+
+        for (uint32_t memoryType = 0; memoryType < memoryProperties.memoryTypeCount; ++memoryType)
+        {
+            auto flags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+            if (!(flags & vk::MemoryPropertyFlagBits::eHostVisible) || !isMemoryTypeTestable(memoryType, size))
+            {
+                continue;
+            }
+
+            auto buffer = createBuffer(size, vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst, memoryType);
+            if (buffer)
+            {
+                bool                  coherent = static_cast<bool>(flags & vk::MemoryPropertyFlagBits::eHostCoherent);
+                vk::MappedMemoryRange range(buffer->memory, 0, VK_WHOLE_SIZE);
+
+                // Mapping is usually cheap, but some drivers set up page tables on every map
+                std::vector<double> mapTimes;
+                for (uint32_t i = 0; i < m_settings.copyIterations; ++i)
+                {
+                    auto start = Clock::now();
+                    m_device.mapMemory(buffer->memory, 0, VK_WHOLE_SIZE);
+                    m_device.unmapMemory(buffer->memory);
+                    mapTimes.push_back(millisecondsSince(start) * 1000.0);
+                }
+
+                auto* mapped = static_cast<uint8_t*>(m_device.mapMemory(buffer->memory, 0, VK_WHOLE_SIZE));
+
+                // Non-coherent memory is flushed as part of the write, the GPU would not see it otherwise
+                std::memcpy(mapped, hostData.data(), size);
+                auto writeStart = Clock::now();
+                for (uint32_t i = 0; i < m_settings.copyIterations; ++i)
+                {
+                    std::memcpy(mapped, hostData.data(), size);
+                    if (!coherent)
+                    {
+                        m_device.flushMappedMemoryRanges({range});
+                    }
+                }
+                double writeMilliseconds = millisecondsSince(writeStart);
+
+                // Reading uncached memory is notoriously slow, which is what this is meant to show.
+                // The words are summed into a checksum that goes into the report, so the reads can't be optimized away.
+                auto const* words     = reinterpret_cast<uint64_t const*>(mapped);
+                uint64_t    checksum  = 0;
+                auto        readStart = Clock::now();
+                for (uint32_t i = 0; i < m_settings.copyIterations; ++i)
+                {
+                    if (!coherent)
+                    {
+                        m_device.invalidateMappedMemoryRanges({range});
+                    }
+                    for (size_t w = 0; w < size / sizeof(uint64_t); ++w)
+                    {
+                        checksum += words[w];
+                    }
+                }
+                double readMilliseconds = millisecondsSince(readStart);
+
+                m_device.unmapMemory(buffer->memory);
+
+                json.beginObject();
+                json.field("index", memoryType);
+                writeFlagNames(json, "flags", flags, MEMORY_PROPERTY_NAMES);
+                json.field("map_us", percentile(mapTimes, 0.5));
+                json.field("write_gb_per_second", static_cast<double>(size) * m_settings.copyIterations / (writeMilliseconds * 1e6));
+                json.field("read_gb_per_second", static_cast<double>(size) * m_settings.copyIterations / (readMilliseconds * 1e6));
+                json.field("read_checksum", formatHex(checksum));
+                json.endObject();
+            }
+
+            m_cleanup.flush();
+        }
+
+        json.endArray();
+    }
+
+    // An empty command buffer, so only the submission and the fence signal are measured
+    void measureSubmitLatency(JsonWriter& json)
+    {
+        m_commandBuffer.begin(vk::CommandBufferBeginInfo());
+        m_commandBuffer.end();
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers    = &m_commandBuffer;
+
+        std::vector<double> submitTimes;    // Duration of the submit call
+        std::vector<double> roundTripTimes; // Submit until the fence is signaled and seen by the host
+
+        // A few warm up submissions, the first ones may set up driver internals
+        for (uint32_t i = 0; i < 10 + m_settings.submitSamples; ++i)
+        {
+            auto start = Clock::now();
+            m_queue.submit({submitInfo}, m_fence);
+            double submitTime = millisecondsSince(start);
+
+            if (m_device.waitForFences({m_fence}, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+            {
+                throw std::runtime_error("failed to wait for fence");
+            }
+            double roundTripTime = millisecondsSince(start);
+            m_device.resetFences({m_fence});
+
+            if (i >= 10)
+            {
+                submitTimes.push_back(submitTime * 1000.0);
+                roundTripTimes.push_back(roundTripTime * 1000.0);
+            }
+        }
+
+        json.field("samples", m_settings.submitSamples);
+        writeSeries(json, "submit_us", submitTimes);
+        writeSeries(json, "round_trip_us", roundTripTimes);
+    }
+
+    // Compute pipeline creation, without a pipeline cache (every pipeline specialized differently,
+    // so driver internal caches miss too) and with a pipeline cache that already contains it
+    void measurePipelineCreation(JsonWriter& json)
+    {
+        auto shaderCode = readFile(PATH_PROBE_SHADER_COMP);
+        auto reflection = reflectShader(shaderCode);
+        auto layout     = m_pipelineLayoutCache.getPipelineLayout({reflection});
+
+        vk::ShaderModuleCreateInfo moduleInfo;
+        moduleInfo.codeSize = shaderCode.size();
+        moduleInfo.pCode    = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+        auto   moduleStart  = Clock::now();
+        auto   shaderModule = m_device.createShaderModule(moduleInfo);
+        double moduleTime   = millisecondsSince(moduleStart);
+        m_cleanup.push(0, [this, shaderModule]() { m_device.destroyShaderModule(shaderModule); });
+
+        uint32_t                   seed = 0;
+        vk::SpecializationMapEntry specializationEntry(0, 0, sizeof(uint32_t));
+        vk::SpecializationInfo     specializationInfo(1, &specializationEntry, sizeof(uint32_t), &seed);
+
+        vk::ComputePipelineCreateInfo pipelineInfo;
+        pipelineInfo.stage.stage               = vk::ShaderStageFlagBits::eCompute;
+        pipelineInfo.stage.module              = shaderModule;
+        pipelineInfo.stage.pName               = "main";
+        pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+        pipelineInfo.layout                    = layout;
+
+        auto measure = [&](vk::PipelineCache cache) {
+            auto   start    = Clock::now();
+            auto   pipeline = m_device.createComputePipelines(cache, {pipelineInfo}).value[0];
+            double time     = millisecondsSince(start);
+
+            m_device.destroyPipeline(pipeline);
+            return time;
+        };
+
+        std::vector<double> uncachedTimes;
+        for (uint32_t i = 0; i < m_settings.pipelineSamples; ++i)
+        {
+            seed = i + 1;
+            uncachedTimes.push_back(measure(vk::PipelineCache()));
+        }
+
+        auto cache = m_device.createPipelineCache(vk::PipelineCacheCreateInfo());
+        m_cleanup.push(0, [this, cache]() { m_device.destroyPipelineCache(cache); });
+
+        // Fill the cache
+        seed = 0;
+        measure(cache);
+
+        std::vector<double> cachedTimes;
+        for (uint32_t i = 0; i < m_settings.pipelineSamples; ++i)
+        {
+            cachedTimes.push_back(measure(cache));
+        }
+
+        json.field("samples", m_settings.pipelineSamples);
+        json.field("shader_module_ms", moduleTime);
+        writeSeries(json, "uncached_ms", uncachedTimes);
+        writeSeries(json, "cached_ms", cachedTimes);
+        json.field("cache_size", m_device.getPipelineCacheData(cache).size());
+    }
+
+    void uninitialize()
+    {
+        if (!m_device)
+        {
+            return;
+        }
+
+        m_device.waitIdle();
+        m_cleanup.flush();
+        m_pipelineLayoutCache.destroy();
+
+        if (m_queryPool)
+        {
+            m_device.destroyQueryPool(m_queryPool);
+        }
+        m_device.destroyFence(m_fence);
+        m_device.destroyCommandPool(m_commandPool);
+        m_device.destroy();
+        m_device = vk::Device();
+    }
+
+    vk::PhysicalDevice   m_physicalDevice;
+    ProbeSettings        m_settings;
+    float                m_timestampPeriod     = 1.f; // Nanoseconds per timestamp tick
+    bool                 m_timestampsSupported = false;
+    uint32_t             m_queueFamily         = 0;
+    vk::Device           m_device;
+    vk::Queue            m_queue;
+    vk::CommandPool      m_commandPool;
+    vk::CommandBuffer    m_commandBuffer;
+    vk::Fence            m_fence;
+    vk::QueryPool        m_queryPool;
+    PipelineLayoutCache  m_pipelineLayoutCache;
+    DeletionQueue        m_cleanup; // Resources of the running test, everything is tagged 0 and flushed when idle
+};
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        ProbeSettings settings = parseCommandLine(argc, argv);
+
+        vk::ApplicationInfo applicationInfo;
+        applicationInfo.pApplicationName   = "Basic Setup";
+        applicationInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+        applicationInfo.apiVersion         = VK_API_VERSION_1_2;
+
+        vk::InstanceCreateInfo instanceInfo;
+        instanceInfo.pApplicationInfo = &applicationInfo;
+
+        vk::Instance instance = vk::createInstance(instanceInfo);
+
+        // Every device is probed, the ranking only provides the score and the UUID
+        auto devices = rankPhysicalDevices(instance, [](vk::PhysicalDevice const&) { return true; });
+        std::sort(std::begin(devices), std::end(devices), [](auto const& a, auto const& b) { return a.index < b.index; });
+
+        if (settings.device)
+        {
+            // Only the exact matches if there are any, otherwise every device whose name matches
+            SelectorMatch required = bestSelectorMatch(devices, settings.device.value());
+            devices.erase(std::remove_if(std::begin(devices), std::end(devices), [&](auto const& d) { return required == SelectorMatch::None || matchDeviceSelector(d, settings.device.value()) != required; }), std::end(devices));
+            if (devices.empty())
+            {
+                throw std::runtime_error("requested device '" + settings.device.value() + "' is not available");
+            }
+        }
+
+        std::ofstream outputFile;
+        if (!settings.outputPath.empty())
+        {
+            outputFile.open(settings.outputPath);
+            if (!outputFile.is_open())
+            {
+                throw std::runtime_error("failed to open output file '" + settings.outputPath + "'");
+            }
+        }
+
+        JsonWriter json(settings.outputPath.empty() ? std::cout : outputFile);
+        json.beginObject();
+        json.field("loader_version", formatVersion(vk::enumerateInstanceVersion()));
+
+        json.beginArray("instance_extensions");
+        for (auto const& extension : vk::enumerateInstanceExtensionProperties())
+        {
+            json.value(std::string(extension.extensionName.data()));
+        }
+        json.endArray();
+
+        json.beginArray("devices");
+        for (auto const& device : devices)
+        {
+            std::cerr << "probing [" << device.index << "] " << device.name() << "..." << std::endl;
+
+            json.beginObject();
+            writeCapabilities(json, device);
+
+            if (settings.benchmarks)
+            {
+                json.beginObject("benchmarks");
+                try
+                {
+                    DeviceBenchmark benchmark(device, settings);
+                    benchmark.initialize();
+                    benchmark.run(json);
+                }
+                catch (std::exception const& e)
+                {
+                    // Devices that can't even be opened are still reported with their capabilities
+                    std::cerr << "  benchmarks failed: " << e.what() << std::endl;
+                    json.field("error", std::string(e.what()));
+                }
+                json.endObject();
+            }
+
+            json.endObject();
+        }
+        json.endArray();
+
+        json.endObject();
+
+        instance.destroy();
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
 
-    return 0;
-}
\ No newline at end of file
+    return EXIT_SUCCESS;
+}
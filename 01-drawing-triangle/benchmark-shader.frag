@@ -0,0 +1,16 @@
+//////////////
+// TYPEDEFS //
+//////////////
+struct PixelInputType
+{
+    float4 position : SV_Position;
+    float4 color : COLOR0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Fragment Shader
+////////////////////////////////////////////////////////////////////////////////
+float4 main(PixelInputType input) : SV_Target0
+{
+    return input.color;
+}
\ No newline at end of file
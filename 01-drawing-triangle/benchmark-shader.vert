@@ -0,0 +1,106 @@
+//////////////
+// TYPEDEFS //
+//////////////
+struct VertexInputType
+{
+    uint vertexId : SV_VertexId;
+    uint instanceId : SV_InstanceID;
+};
+
+struct PixelInputType
+{
+    float4 position : SV_Position;
+    float4 color : COLOR0;
+};
+
+// Set per draw, so consecutive draws continue the grid where the previous one stopped
+[[vk::push_constant]]
+cbuffer DrawConstants
+{
+    uint  instanceOffset;
+    uint  gridSize;
+    float depth;
+    uint  shape;
+    uint  cellCount; // Cells covered by an occlusion proxy
+};
+
+// A triangle in the grid cell of each instance
+static const uint SHAPE_TRIANGLE = 0;
+// Bounding rectangle of the cells [instanceOffset, instanceOffset + cellCount), used as occlusion proxy
+static const uint SHAPE_PROXY = 1;
+// Rectangle in front of the left three quarters of the viewport
+static const uint SHAPE_OCCLUDER = 2;
+
+// Distinguishes the pipelines of the many pipelines scenario
+[[vk::constant_id(0)]] const uint pipelineIndex = 0;
+
+static float2 positions[3] =
+{
+    float2(0.0f, -0.5f),
+    float2(0.5f, 0.5f),
+    float2(-0.5f, 0.5f)
+};
+
+// Two clockwise triangles covering [0, 1]
+static float2 quadCorners[6] =
+{
+    float2(0.0f, 0.0f),
+    float2(1.0f, 0.0f),
+    float2(1.0f, 1.0f),
+    float2(0.0f, 0.0f),
+    float2(1.0f, 1.0f),
+    float2(0.0f, 1.0f)
+};
+
+static float3 colors[3] =
+{
+    float3(1.0, 0.0, 0.0),
+    float3(0.0, 1.0, 0.0),
+    float3(0.0, 0.0, 1.0)
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Vertex Shader
+////////////////////////////////////////////////////////////////////////////////
+PixelInputType main(VertexInputType input)
+{
+    PixelInputType output;
+
+    float  cellSize = 2.0f / gridSize;
+    float2 pos;
+
+    if (shape == SHAPE_OCCLUDER)
+    {
+        pos = lerp(float2(-1.0f, -1.0f), float2(0.5f, 1.0f), quadCorners[input.vertexId]);
+        output.color = float4(0.25f, 0.25f, 0.25f, 1.0f);
+    }
+    else if (shape == SHAPE_PROXY)
+    {
+        // Cells spanning several rows are bounded by the full rows
+        uint   last    = instanceOffset + cellCount - 1;
+        float2 minCell = float2(instanceOffset % gridSize, instanceOffset / gridSize);
+        float2 maxCell = float2(last % gridSize, last / gridSize);
+        if (minCell.y != maxCell.y)
+        {
+            minCell.x = 0.0f;
+            maxCell.x = gridSize - 1;
+        }
+
+        pos = float2(-1.0f, -1.0f) + lerp(minCell, maxCell + 1.0f, quadCorners[input.vertexId]) * cellSize;
+        output.color = float4(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+    else
+    {
+        // Place each instance in its own cell of a grid covering the viewport
+        uint   instance = instanceOffset + input.instanceId;
+        float2 cell     = float2(instance % gridSize, instance / gridSize);
+        float2 center   = float2(-1.0f, -1.0f) + (cell + 0.5f) * cellSize;
+
+        pos = center + positions[input.vertexId] * cellSize;
+        output.color = float4(colors[(input.vertexId + pipelineIndex) % 3], 1.0f);
+    }
+
+    output.position = float4(pos, depth, 1.0f);
+
+    return output;
+}
@@ -0,0 +1,1472 @@
+#include <vulkan/vulkan.hpp>
+
+#include <common/command-line.hpp>
+#include <common/device-selection.hpp>
+#include <common/draw-list.hpp>
+#include <common/json-writer.hpp>
+#include <common/spirv-reflection.hpp>
+#include <common/statistics.hpp>
+#include <common/utilities.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+constexpr uint32_t   RENDER_WIDTH     = 800;
+constexpr uint32_t   RENDER_HEIGHT    = 600;
+constexpr uint32_t   FRAMES_IN_FLIGHT = 2;
+constexpr uint32_t   DEFAULT_FRAMES   = 500;
+constexpr uint32_t   BASELINE_FRAMES  = 100; // Rendered without culling to measure the saved GPU time
+constexpr vk::Format RENDER_FORMAT    = vk::Format::eR8G8B8A8Unorm;
+// Mandatory as depth attachment, so no format query is needed
+constexpr vk::Format DEPTH_FORMAT = vk::Format::eD16Unorm;
+
+using Clock = std::chrono::steady_clock;
+
+// A fixed workload, rendered the same way every frame
+struct Scenario
+{
+    char const* name;
+    uint32_t    drawCount;
+    uint32_t    instancesPerDraw;
+    uint32_t    pipelineCount; // Draws cycle through the pipelines
+    bool        occluder;      // Draw a rectangle in front of three quarters of the grid first
+};
+
+static Scenario const SCENARIOS[] = {
+    {"single-triangle", 1, 1, 1, false},
+    {"instanced-triangles", 1, 65536, 1, false},
+    {"many-pipelines", 4096, 1, 64, false},
+    {"many-draws", 16384, 1, 1, false},
+    {"many-draws-many-pipelines", 16384, 1, 64, false},
+    {"occluded-draws", 4096, 16, 1, true},
+};
+
+// Skipping draws hidden behind others, decided by occlusion queries of their bounding rectangles
+enum class OcclusionCulling
+{
+    Off,
+    // The CPU reads the query results back and skips hidden draws. The results of the previous
+    // frame are used if it has already finished, otherwise the ones of the oldest frame in flight.
+    Readback,
+    // The GPU copies the query results into a buffer used as predicate for conditional
+    // rendering (VK_EXT_conditional_rendering) in the next frame, without CPU involvement.
+    Conditional,
+};
+
+static char const* occlusionCullingName(OcclusionCulling culling)
+{
+    switch (culling)
+    {
+    case OcclusionCulling::Readback:
+        return "readback";
+    case OcclusionCulling::Conditional:
+        return "conditional";
+    default:
+        return "off";
+    }
+}
+
+struct BenchmarkSettings
+{
+    uint32_t                   frameCount = DEFAULT_FRAMES;
+    std::vector<std::string>   scenarios;  // All scenarios if empty
+    std::optional<std::string> device;     // Index, UUID or part of the name, best device if not set
+    std::string                outputPath; // JSON report, stdout if empty
+    std::string                goldenPath       = BENCHMARK_GOLDEN_FILE;
+    bool                       updateGolden     = false;
+    bool                       requireGolden    = false; // Fail scenarios without a reference, for CI machines that have them
+    bool                       sortDraws        = true; // Record draws sorted by pipeline instead of in submission order
+    OcclusionCulling           occlusionCulling = OcclusionCulling::Off;
+};
+
+struct BenchmarkResult
+{
+    std::string         scenario;
+    uint32_t            frameCount = 0;
+    double              framesPerSecond = 0.0;
+    std::vector<double> cpuFrameTimes; // ms, recording and submission
+    std::vector<double> gpuFrameTimes; // ms, from timestamps
+    DrawListStatistics  drawStatistics; // Of a single frame, the same for every frame
+    uint64_t            imageHash = 0;
+    std::string         goldenStatus; // "match", "mismatch", "missing" or "updated"
+
+    // Only set with occlusion culling
+    double culledDraws          = 0.0; // Per frame, mean
+    double resultAge            = 0.0; // Frames between a query and the draw decided by it, mean
+    double baselineGpuFrameTime = 0.0; // ms, mean of the frames rendered without culling
+};
+
+static BenchmarkSettings parseCommandLine(int argc, char** argv)
+{
+    BenchmarkSettings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+
+        auto nextValue = [&]() -> std::string {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("missing value for option '" + option + "'");
+            }
+            return argv[++i];
+        };
+
+        if (option == "--frames")
+        {
+            settings.frameCount = parseCount(option, nextValue(), 1U, 1000000U);
+        }
+        else if (option == "--scenario")
+        {
+            settings.scenarios.push_back(nextValue());
+        }
+        else if (option == "--device")
+        {
+            settings.device = nextValue();
+        }
+        else if (option == "--output")
+        {
+            settings.outputPath = nextValue();
+        }
+        else if (option == "--golden")
+        {
+            settings.goldenPath = nextValue();
+        }
+        else if (option == "--update-golden")
+        {
+            settings.updateGolden = true;
+        }
+        else if (option == "--require-golden")
+        {
+            settings.requireGolden = true;
+        }
+        else if (option == "--unsorted")
+        {
+            settings.sortDraws = false;
+        }
+        else if (option == "--occlusion-culling")
+        {
+            auto mode = nextValue();
+            if (mode == "readback")
+            {
+                settings.occlusionCulling = OcclusionCulling::Readback;
+            }
+            else if (mode == "conditional")
+            {
+                settings.occlusionCulling = OcclusionCulling::Conditional;
+            }
+            else if (mode != "off")
+            {
+                throw std::runtime_error("unknown occlusion culling mode '" + mode + "'");
+            }
+        }
+        else
+        {
+            throw std::runtime_error("unknown option '" + option + "'");
+        }
+    }
+
+    return settings;
+}
+
+// Golden references are stored as one line per scenario and device: "<scenario> <hash> <device name>".
+// Empty lines and lines starting with '#' are ignored, and kept at the top of the file when saving.
+// Rasterization may differ slightly between implementations, so references are per device.
+class GoldenReferences
+{
+public:
+    explicit GoldenReferences(std::string const& path)
+        : m_path(path)
+    {
+        std::ifstream file(path);
+        std::string   line;
+        while (std::getline(file, line))
+        {
+            std::istringstream stream(line);
+            std::string        scenario;
+            std::string        hash;
+            std::string        device;
+            if (line.empty() || line[0] == '#')
+            {
+                m_header.push_back(line);
+                continue;
+            }
+
+            if (stream >> scenario >> hash && std::getline(stream >> std::ws, device))
+            {
+                m_references[{scenario, device}] = std::stoull(hash, nullptr, 16);
+            }
+        }
+    }
+
+    std::optional<uint64_t> find(std::string const& scenario, std::string const& device) const
+    {
+        auto it = m_references.find({scenario, device});
+        return it != std::end(m_references) ? std::optional<uint64_t>(it->second) : std::nullopt;
+    }
+
+    void set(std::string const& scenario, std::string const& device, uint64_t hash)
+    {
+        m_references[{scenario, device}] = hash;
+    }
+
+    void save() const
+    {
+        std::ofstream file(m_path);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to write golden references to '" + m_path + "'");
+        }
+
+        for (auto const& line : m_header)
+        {
+            file << line << "\n";
+        }
+
+        for (auto const& entry : m_references)
+        {
+            file << entry.first.first << " " << std::hex << std::setw(16) << std::setfill('0') << entry.second << std::dec << " " << entry.first.second << "\n";
+        }
+    }
+
+private:
+    std::string                                             m_path;
+    std::vector<std::string>                                m_header;
+    std::map<std::pair<std::string, std::string>, uint64_t> m_references;
+};
+
+// Renders the scenarios into an offscreen image, so it runs without a window system
+// and on any implementation, including software ones like lavapipe.
+class TriangleBenchmark
+{
+public:
+    explicit TriangleBenchmark(BenchmarkSettings const& settings)
+        : m_settings(settings)
+    {
+    }
+
+    ~TriangleBenchmark()
+    {
+        uninitialize();
+    }
+
+    std::string deviceName() const
+    {
+        return m_deviceName;
+    }
+
+    // The requested mode, unless conditional rendering isn't supported
+    OcclusionCulling occlusionCulling() const
+    {
+        return m_occlusionCulling;
+    }
+
+    void initialize()
+    {
+        createInstance();
+        selectPhysicalDevice();
+        createLogicalDevice();
+        createRenderTarget();
+        createDepthTarget();
+        createRenderPass();
+        createFramebuffer();
+        createCommandPool();
+        createCommandBuffers();
+        createSyncObjects();
+        createQueryPool();
+        createReadbackBuffer();
+    }
+
+    BenchmarkResult run(Scenario const& scenario)
+    {
+        createPipelines(scenario);
+
+        BenchmarkResult result;
+        result.scenario   = scenario.name;
+        result.frameCount = m_settings.frameCount;
+
+        if (m_occlusionCulling != OcclusionCulling::Off)
+        {
+            createOcclusionResources(scenario);
+
+            // The same scenario without culling, as reference for the GPU time saved by it
+            auto baseline               = renderFrames(scenario, std::min(m_settings.frameCount, BASELINE_FRAMES), OcclusionCulling::Off, result);
+            result.baselineGpuFrameTime = mean(baseline.gpuFrameTimes);
+        }
+
+        auto timings = renderFrames(scenario, m_settings.frameCount, m_occlusionCulling, result);
+
+        result.cpuFrameTimes   = timings.cpuFrameTimes;
+        result.gpuFrameTimes   = timings.gpuFrameTimes;
+        result.framesPerSecond = m_settings.frameCount / timings.seconds;
+        result.imageHash       = readbackImageHash();
+
+        destroyOcclusionResources();
+        destroyPipelines();
+
+        return result;
+    }
+
+private:
+    void createInstance()
+    {
+        vk::ApplicationInfo applicationInfo;
+        applicationInfo.pApplicationName   = "Drawing Triangle Benchmark";
+        applicationInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+        applicationInfo.apiVersion         = VK_API_VERSION_1_2;
+
+        vk::InstanceCreateInfo instanceCreateInfo;
+        instanceCreateInfo.pApplicationInfo = &applicationInfo;
+
+        m_instance = vk::createInstance(instanceCreateInfo);
+    }
+
+    std::optional<uint32_t> findGraphicsQueueFamily(vk::PhysicalDevice const& device)
+    {
+        auto familyProperties = device.getQueueFamilyProperties();
+
+        for (uint32_t i = 0; i < familyProperties.size(); ++i)
+        {
+            if (familyProperties[i].queueCount > 0 && familyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics)
+            {
+                return i;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    bool isDeviceSuitable(vk::PhysicalDevice const& device)
+    {
+        if (!findGraphicsQueueFamily(device) || device.getProperties().apiVersion < VK_API_VERSION_1_2)
+        {
+            return false;
+        }
+
+        auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+        return features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore;
+    }
+
+    void selectPhysicalDevice()
+    {
+        auto ranking = rankPhysicalDevices(m_instance, [this](auto const& d) { return isDeviceSuitable(d); });
+
+        if (ranking.empty())
+        {
+            throw std::runtime_error("failed to find GPUs with Vulkan support");
+        }
+
+        // The report goes to stdout, so the ranking is logged to stderr
+        auto selected = findDevice(ranking, m_settings.device);
+        logDeviceRanking(std::cerr, ranking, selected);
+
+        if (selected == nullptr)
+        {
+            throw std::runtime_error(m_settings.device ? "requested device '" + m_settings.device.value() + "' is not available or not suitable"
+                                                       : std::string("failed to find a suitable GPU!"));
+        }
+
+        m_physicalDevice = selected->device;
+
+        auto properties   = m_physicalDevice.getProperties();
+        m_deviceName      = properties.deviceName.data();
+        m_timestampPeriod = properties.limits.timestampPeriod;
+    }
+
+    void createLogicalDevice()
+    {
+        m_queueFamily = findGraphicsQueueFamily(m_physicalDevice).value();
+
+        float                     priority = 1.0f;
+        vk::DeviceQueueCreateInfo queueCreateInfo;
+        queueCreateInfo.queueFamilyIndex = m_queueFamily;
+        queueCreateInfo.queueCount       = 1U;
+        queueCreateInfo.pQueuePriorities = &priority;
+
+        vk::PhysicalDeviceVulkan12Features vulkan12Features;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+
+        vk::PhysicalDeviceFeatures2 deviceFeatures;
+        deviceFeatures.pNext = &vulkan12Features;
+
+        std::vector<char const*> deviceExtensions;
+
+        // Conditional rendering is an extension, fall back to reading the results back without it
+        m_occlusionCulling = m_settings.occlusionCulling;
+
+        vk::PhysicalDeviceConditionalRenderingFeaturesEXT conditionalRenderingFeatures;
+        if (m_occlusionCulling == OcclusionCulling::Conditional)
+        {
+            if (isConditionalRenderingSupported())
+            {
+                conditionalRenderingFeatures.conditionalRendering = VK_TRUE;
+                vulkan12Features.pNext                            = &conditionalRenderingFeatures;
+                deviceExtensions.push_back(VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME);
+            }
+            else
+            {
+                std::cerr << "conditional rendering not supported, falling back to occlusion query readback." << std::endl;
+                m_occlusionCulling = OcclusionCulling::Readback;
+            }
+        }
+
+        vk::DeviceCreateInfo createInfo;
+        createInfo.pNext                   = &deviceFeatures;
+        createInfo.pQueueCreateInfos       = &queueCreateInfo;
+        createInfo.queueCreateInfoCount    = 1U;
+        createInfo.enabledExtensionCount   = static_cast<uint32_t>(deviceExtensions.size());
+        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+        m_device = m_physicalDevice.createDevice(createInfo);
+        m_queue  = m_device.getQueue(m_queueFamily, 0U);
+
+        // Extension commands aren't exported by the loader
+        m_dispatch = vk::DispatchLoaderDynamic(m_instance, vkGetInstanceProcAddr, m_device);
+
+        m_pipelineLayoutCache.setDevice(m_device);
+
+        auto timestampValidBits = m_physicalDevice.getQueueFamilyProperties()[m_queueFamily].timestampValidBits;
+        m_timestampsSupported   = timestampValidBits > 0;
+        if (!m_timestampsSupported)
+        {
+            std::cerr << "timestamps not supported, GPU frame times will not be reported." << std::endl;
+        }
+    }
+
+    bool isConditionalRenderingSupported()
+    {
+        auto extensions = m_physicalDevice.enumerateDeviceExtensionProperties();
+        bool available  = std::any_of(std::begin(extensions), std::end(extensions), [](auto const& extension) {
+            return std::string(extension.extensionName.data()) == VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME;
+        });
+
+        if (!available)
+        {
+            return false;
+        }
+
+        auto features = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceConditionalRenderingFeaturesEXT>();
+        return features.get<vk::PhysicalDeviceConditionalRenderingFeaturesEXT>().conditionalRendering;
+    }
+
+    void createRenderTarget()
+    {
+        vk::ImageCreateInfo imageInfo;
+        imageInfo.imageType     = vk::ImageType::e2D;
+        imageInfo.format        = RENDER_FORMAT;
+        imageInfo.extent        = vk::Extent3D(RENDER_WIDTH, RENDER_HEIGHT, 1);
+        imageInfo.mipLevels     = 1;
+        imageInfo.arrayLayers   = 1;
+        imageInfo.samples       = vk::SampleCountFlagBits::e1;
+        imageInfo.tiling        = vk::ImageTiling::eOptimal;
+        imageInfo.usage         = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+        imageInfo.sharingMode   = vk::SharingMode::eExclusive;
+        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+        m_renderTarget = m_device.createImage(imageInfo);
+
+        auto                   memoryRequirements = m_device.getImageMemoryRequirements(m_renderTarget);
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        m_renderTargetMemory = m_device.allocateMemory(allocInfo);
+        m_device.bindImageMemory(m_renderTarget, m_renderTargetMemory, 0);
+
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.image                           = m_renderTarget;
+        viewInfo.format                          = RENDER_FORMAT;
+        viewInfo.viewType                        = vk::ImageViewType::e2D;
+        viewInfo.subresourceRange.aspectMask     = vk::ImageAspectFlagBits::eColor;
+        viewInfo.subresourceRange.baseMipLevel   = 0U;
+        viewInfo.subresourceRange.levelCount     = 1U;
+        viewInfo.subresourceRange.baseArrayLayer = 0U;
+        viewInfo.subresourceRange.layerCount     = 1U;
+
+        m_renderTargetView = m_device.createImageView(viewInfo);
+    }
+
+    void createDepthTarget()
+    {
+        vk::ImageCreateInfo imageInfo;
+        imageInfo.imageType     = vk::ImageType::e2D;
+        imageInfo.format        = DEPTH_FORMAT;
+        imageInfo.extent        = vk::Extent3D(RENDER_WIDTH, RENDER_HEIGHT, 1);
+        imageInfo.mipLevels     = 1;
+        imageInfo.arrayLayers   = 1;
+        imageInfo.samples       = vk::SampleCountFlagBits::e1;
+        imageInfo.tiling        = vk::ImageTiling::eOptimal;
+        imageInfo.usage         = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+        imageInfo.sharingMode   = vk::SharingMode::eExclusive;
+        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+        m_depthTarget = m_device.createImage(imageInfo);
+
+        auto                   memoryRequirements = m_device.getImageMemoryRequirements(m_depthTarget);
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        m_depthTargetMemory = m_device.allocateMemory(allocInfo);
+        m_device.bindImageMemory(m_depthTarget, m_depthTargetMemory, 0);
+
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.image                           = m_depthTarget;
+        viewInfo.format                          = DEPTH_FORMAT;
+        viewInfo.viewType                        = vk::ImageViewType::e2D;
+        viewInfo.subresourceRange.aspectMask     = vk::ImageAspectFlagBits::eDepth;
+        viewInfo.subresourceRange.baseMipLevel   = 0U;
+        viewInfo.subresourceRange.levelCount     = 1U;
+        viewInfo.subresourceRange.baseArrayLayer = 0U;
+        viewInfo.subresourceRange.layerCount     = 1U;
+
+        m_depthTargetView = m_device.createImageView(viewInfo);
+    }
+
+    void createRenderPass()
+    {
+        vk::AttachmentDescription colorAttachment;
+        colorAttachment.format         = RENDER_FORMAT;
+        colorAttachment.samples        = vk::SampleCountFlagBits::e1;
+        colorAttachment.loadOp         = vk::AttachmentLoadOp::eClear;
+        colorAttachment.storeOp        = vk::AttachmentStoreOp::eStore;
+        colorAttachment.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
+        colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        colorAttachment.initialLayout  = vk::ImageLayout::eUndefined;
+        // Ready for the readback once rendering is done
+        colorAttachment.finalLayout    = vk::ImageLayout::eTransferSrcOptimal;
+
+        // Only needed while rendering, the occluders hide the draws behind them through it
+        vk::AttachmentDescription depthAttachment;
+        depthAttachment.format         = DEPTH_FORMAT;
+        depthAttachment.samples        = vk::SampleCountFlagBits::e1;
+        depthAttachment.loadOp         = vk::AttachmentLoadOp::eClear;
+        depthAttachment.storeOp        = vk::AttachmentStoreOp::eDontCare;
+        depthAttachment.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
+        depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        depthAttachment.initialLayout  = vk::ImageLayout::eUndefined;
+        depthAttachment.finalLayout    = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+        vk::AttachmentDescription attachments[2] = {colorAttachment, depthAttachment};
+
+        vk::AttachmentReference colorAttachmentRef;
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout     = vk::ImageLayout::eColorAttachmentOptimal;
+
+        vk::AttachmentReference depthAttachmentRef;
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout     = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+        vk::SubpassDescription subpass;
+        subpass.pipelineBindPoint       = vk::PipelineBindPoint::eGraphics;
+        subpass.colorAttachmentCount    = 1;
+        subpass.pColorAttachments       = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        // Every frame renders to the same image, so the frames (and the final copy) have to be ordered
+        vk::SubpassDependency dependencies[2];
+        dependencies[0].srcSubpass    = VK_SUBPASS_EXTERNAL;
+        dependencies[0].srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eLateFragmentTests;
+        dependencies[0].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dependencies[0].dstSubpass    = 0;
+        dependencies[0].dstStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+        dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+        dependencies[1].srcSubpass    = 0;
+        dependencies[1].srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        dependencies[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
+        dependencies[1].dstStageMask  = vk::PipelineStageFlagBits::eTransfer;
+        dependencies[1].dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+        vk::RenderPassCreateInfo renderPassInfo;
+        renderPassInfo.attachmentCount = 2;
+        renderPassInfo.pAttachments    = attachments;
+        renderPassInfo.subpassCount    = 1;
+        renderPassInfo.pSubpasses      = &subpass;
+        renderPassInfo.dependencyCount = 2;
+        renderPassInfo.pDependencies   = dependencies;
+
+        m_renderPass = m_device.createRenderPass(renderPassInfo);
+    }
+
+    void createFramebuffer()
+    {
+        vk::ImageView attachments[2] = {m_renderTargetView, m_depthTargetView};
+
+        vk::FramebufferCreateInfo framebufferInfo;
+        framebufferInfo.renderPass      = m_renderPass;
+        framebufferInfo.attachmentCount = 2;
+        framebufferInfo.pAttachments    = attachments;
+        framebufferInfo.width           = RENDER_WIDTH;
+        framebufferInfo.height          = RENDER_HEIGHT;
+        framebufferInfo.layers          = 1;
+
+        m_framebuffer = m_device.createFramebuffer(framebufferInfo);
+    }
+
+    void createCommandPool()
+    {
+        vk::CommandPoolCreateInfo poolInfo;
+        poolInfo.queueFamilyIndex = m_queueFamily;
+        poolInfo.flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+
+        m_commandPool = m_device.createCommandPool(poolInfo);
+    }
+
+    void createCommandBuffers()
+    {
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.commandPool        = m_commandPool;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = FRAMES_IN_FLIGHT;
+
+        m_commandBuffers = m_device.allocateCommandBuffers(allocInfo);
+    }
+
+    void createSyncObjects()
+    {
+        vk::SemaphoreTypeCreateInfo timelineInfo;
+        timelineInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        timelineInfo.initialValue  = 0U;
+
+        vk::SemaphoreCreateInfo semaphoreInfo;
+        semaphoreInfo.pNext = &timelineInfo;
+
+        m_timeline = m_device.createSemaphore(semaphoreInfo);
+        m_frameTimelineValues.resize(FRAMES_IN_FLIGHT, 0U);
+    }
+
+    void createQueryPool()
+    {
+        if (!m_timestampsSupported)
+        {
+            return;
+        }
+
+        // Two timestamps (begin and end) per frame in flight
+        vk::QueryPoolCreateInfo queryPoolInfo;
+        queryPoolInfo.queryType  = vk::QueryType::eTimestamp;
+        queryPoolInfo.queryCount = 2 * FRAMES_IN_FLIGHT;
+
+        m_queryPool = m_device.createQueryPool(queryPoolInfo);
+    }
+
+    void createReadbackBuffer()
+    {
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.size        = RENDER_WIDTH * RENDER_HEIGHT * 4;
+        bufferInfo.usage       = vk::BufferUsageFlagBits::eTransferDst;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+        m_readbackBuffer = m_device.createBuffer(bufferInfo);
+
+        auto                   memoryRequirements = m_device.getBufferMemoryRequirements(m_readbackBuffer);
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+        m_readbackMemory = m_device.allocateMemory(allocInfo);
+        m_device.bindBufferMemory(m_readbackBuffer, m_readbackMemory, 0);
+    }
+
+    void createOcclusionResources(Scenario const& scenario)
+    {
+        // One query per draw and frame in flight
+        vk::QueryPoolCreateInfo queryPoolInfo;
+        queryPoolInfo.queryType  = vk::QueryType::eOcclusion;
+        queryPoolInfo.queryCount = scenario.drawCount * FRAMES_IN_FLIGHT;
+
+        m_occlusionQueryPool = m_device.createQueryPool(queryPoolInfo);
+        m_drawVisible.assign(scenario.drawCount, 1);
+
+        if (m_occlusionCulling != OcclusionCulling::Conditional)
+        {
+            return;
+        }
+
+        // The predicates, a 32-bit value per query. Only the GPU touches them.
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.size        = queryPoolInfo.queryCount * sizeof(uint32_t);
+        bufferInfo.usage       = vk::BufferUsageFlagBits::eConditionalRenderingEXT | vk::BufferUsageFlagBits::eTransferDst;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+        m_conditionBuffer = m_device.createBuffer(bufferInfo);
+
+        auto                   memoryRequirements = m_device.getBufferMemoryRequirements(m_conditionBuffer);
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        m_conditionMemory = m_device.allocateMemory(allocInfo);
+        m_device.bindBufferMemory(m_conditionBuffer, m_conditionMemory, 0);
+    }
+
+    void destroyOcclusionResources()
+    {
+        if (m_occlusionQueryPool)
+        {
+            m_device.destroyQueryPool(m_occlusionQueryPool);
+            m_occlusionQueryPool = vk::QueryPool();
+        }
+        if (m_conditionBuffer)
+        {
+            m_device.destroyBuffer(m_conditionBuffer);
+            m_device.freeMemory(m_conditionMemory);
+            m_conditionBuffer = vk::Buffer();
+            m_conditionMemory = vk::DeviceMemory();
+        }
+    }
+
+    void createPipelines(Scenario const& scenario)
+    {
+        auto vertShaderCode = readFile(PATH_BENCHMARK_SHADER_VERT);
+        auto fragShaderCode = readFile(PATH_BENCHMARK_SHADER_FRAG);
+
+        auto vertReflection = reflectShader(vertShaderCode);
+        auto fragReflection = reflectShader(fragShaderCode);
+        m_pipelineLayout    = m_pipelineLayoutCache.getPipelineLayout({vertReflection, fragReflection});
+
+        vk::ShaderModuleCreateInfo moduleInfo;
+        moduleInfo.codeSize   = vertShaderCode.size();
+        moduleInfo.pCode      = reinterpret_cast<const uint32_t*>(vertShaderCode.data());
+        auto vertShaderModule = m_device.createShaderModule(moduleInfo);
+        moduleInfo.codeSize   = fragShaderCode.size();
+        moduleInfo.pCode      = reinterpret_cast<const uint32_t*>(fragShaderCode.data());
+        auto fragShaderModule = m_device.createShaderModule(moduleInfo);
+
+        // The pipelines only differ in a specialization constant
+        uint32_t                   pipelineIndex = 0;
+        vk::SpecializationMapEntry specializationEntry(0, 0, sizeof(uint32_t));
+        vk::SpecializationInfo     specializationInfo(1, &specializationEntry, sizeof(uint32_t), &pipelineIndex);
+
+        vk::PipelineShaderStageCreateInfo shaderStages[2];
+        shaderStages[0].stage               = vk::ShaderStageFlagBits::eVertex;
+        shaderStages[0].module              = vertShaderModule;
+        shaderStages[0].pName               = "main";
+        shaderStages[0].pSpecializationInfo = &specializationInfo;
+        shaderStages[1].stage               = vk::ShaderStageFlagBits::eFragment;
+        shaderStages[1].module              = fragShaderModule;
+        shaderStages[1].pName               = "main";
+
+        VertexInputLayout                      vertexInputLayout(vertReflection);
+        vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vertexInputLayout.createInfo();
+
+        vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+        inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
+
+        vk::Viewport viewport(0.f, 0.f, static_cast<float>(RENDER_WIDTH), static_cast<float>(RENDER_HEIGHT), 0.f, 1.f);
+        vk::Rect2D   scissor({0, 0}, {RENDER_WIDTH, RENDER_HEIGHT});
+
+        vk::PipelineViewportStateCreateInfo viewportState;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports    = &viewport;
+        viewportState.scissorCount  = 1;
+        viewportState.pScissors     = &scissor;
+
+        vk::PipelineRasterizationStateCreateInfo rasterizer;
+        rasterizer.polygonMode = vk::PolygonMode::eFill;
+        rasterizer.lineWidth   = 1.f;
+        rasterizer.cullMode    = vk::CullModeFlagBits::eBack;
+        rasterizer.frontFace   = vk::FrontFace::eClockwise;
+
+        vk::PipelineMultisampleStateCreateInfo multisampling;
+        multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+        // Equal passes, so the draws are not hidden by their own occlusion proxies
+        vk::PipelineDepthStencilStateCreateInfo depthStencil;
+        depthStencil.depthTestEnable  = VK_TRUE;
+        depthStencil.depthWriteEnable = VK_TRUE;
+        depthStencil.depthCompareOp   = vk::CompareOp::eLessOrEqual;
+
+        vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+        colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+
+        vk::PipelineColorBlendStateCreateInfo colorBlending;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments    = &colorBlendAttachment;
+
+        vk::GraphicsPipelineCreateInfo pipelineInfo;
+        pipelineInfo.stageCount          = 2;
+        pipelineInfo.pStages             = shaderStages;
+        pipelineInfo.pVertexInputState   = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState      = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState   = &multisampling;
+        pipelineInfo.pDepthStencilState  = &depthStencil;
+        pipelineInfo.pColorBlendState    = &colorBlending;
+        pipelineInfo.layout              = m_pipelineLayout;
+        pipelineInfo.renderPass          = m_renderPass;
+        pipelineInfo.subpass             = 0;
+
+        for (pipelineIndex = 0; pipelineIndex < scenario.pipelineCount; ++pipelineIndex)
+        {
+            m_pipelines.push_back(m_device.createGraphicsPipelines(vk::PipelineCache(), {pipelineInfo}).value[0]);
+        }
+
+        // The occlusion proxies only test depth, they leave no trace in the image
+        if (m_occlusionCulling != OcclusionCulling::Off)
+        {
+            pipelineIndex                       = 0;
+            colorBlendAttachment.colorWriteMask = vk::ColorComponentFlags();
+            depthStencil.depthWriteEnable       = VK_FALSE;
+            rasterizer.cullMode                 = vk::CullModeFlagBits::eNone;
+
+            m_proxyPipeline = m_device.createGraphicsPipelines(vk::PipelineCache(), {pipelineInfo}).value[0];
+        }
+
+        m_device.destroyShaderModule(vertShaderModule);
+        m_device.destroyShaderModule(fragShaderModule);
+    }
+
+    void destroyPipelines()
+    {
+        for (auto pipeline : m_pipelines)
+        {
+            m_device.destroyPipeline(pipeline);
+        }
+        m_pipelines.clear();
+
+        if (m_proxyPipeline)
+        {
+            m_device.destroyPipeline(m_proxyPipeline);
+            m_proxyPipeline = vk::Pipeline();
+        }
+    }
+
+    struct FrameTimings
+    {
+        std::vector<double> cpuFrameTimes; // ms, recording and submission
+        std::vector<double> gpuFrameTimes; // ms, from timestamps
+        double              seconds = 0.0;
+    };
+
+    FrameTimings renderFrames(Scenario const& scenario, uint32_t frameCount, OcclusionCulling culling, BenchmarkResult& result)
+    {
+        FrameTimings timings;
+
+        std::vector<bool>     timestampsPending(FRAMES_IN_FLIGHT, false);
+        std::vector<bool>     queriesPending(FRAMES_IN_FLIGHT, false);
+        std::vector<uint32_t> slotFrames(FRAMES_IN_FLIGHT, 0U); // Frame last rendered with each slot
+
+        // Until the first results arrive every draw is considered visible
+        std::fill(std::begin(m_drawVisible), std::end(m_drawVisible), uint8_t(1));
+        std::optional<uint32_t> visibilityFrame; // Frame the visibility was queried in
+
+        uint64_t culledDraws   = 0;
+        uint64_t culledFrames  = 0;
+        uint64_t resultAge     = 0;
+        uint64_t decidedFrames = 0;
+
+        auto start = Clock::now();
+
+        for (uint32_t frame = 0; frame < frameCount; ++frame)
+        {
+            uint32_t slot         = frame % FRAMES_IN_FLIGHT;
+            uint32_t previousSlot = (slot + FRAMES_IN_FLIGHT - 1) % FRAMES_IN_FLIGHT;
+
+            // Wait until the frame that previously used this slot is done and collect its GPU time
+            waitForTimeline(m_frameTimelineValues[slot]);
+            if (timestampsPending[slot])
+            {
+                collectGpuFrameTime(slot, timings.gpuFrameTimes);
+            }
+
+            // Its occlusion queries are complete as well
+            if (queriesPending[slot])
+            {
+                uint32_t hiddenDraws = readOcclusionResults(slot, scenario.drawCount);
+                visibilityFrame      = slotFrames[slot];
+                queriesPending[slot] = false;
+
+                // With conditional rendering these results were the predicates of the following frame
+                if (culling == OcclusionCulling::Conditional)
+                {
+                    culledDraws += hiddenDraws;
+                    ++culledFrames;
+                }
+            }
+
+            // Newer results if the previous frame has already finished, checked without waiting for it
+            if (culling == OcclusionCulling::Readback && queriesPending[previousSlot] && completedTimelineValue() >= m_frameTimelineValues[previousSlot])
+            {
+                readOcclusionResults(previousSlot, scenario.drawCount);
+                visibilityFrame              = slotFrames[previousSlot];
+                queriesPending[previousSlot] = false;
+            }
+
+            auto cpuStart = Clock::now();
+
+            result.drawStatistics = DrawListStatistics();
+            uint32_t skippedDraws = recordCommandBuffer(m_commandBuffers[slot], slot, scenario, culling, frame == 0, result.drawStatistics);
+            m_frameTimelineValues[slot] = submit(m_commandBuffers[slot]);
+            timestampsPending[slot]     = m_timestampsSupported;
+            queriesPending[slot]        = culling != OcclusionCulling::Off;
+            slotFrames[slot]            = frame;
+
+            timings.cpuFrameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - cpuStart).count());
+
+            if (culling == OcclusionCulling::Readback && visibilityFrame)
+            {
+                culledDraws += skippedDraws;
+                ++culledFrames;
+                resultAge += frame - visibilityFrame.value();
+                ++decidedFrames;
+            }
+        }
+
+        for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; ++slot)
+        {
+            waitForTimeline(m_frameTimelineValues[slot]);
+            if (timestampsPending[slot])
+            {
+                collectGpuFrameTime(slot, timings.gpuFrameTimes);
+            }
+        }
+
+        timings.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (culling != OcclusionCulling::Off)
+        {
+            result.culledDraws = culledFrames > 0 ? static_cast<double>(culledDraws) / culledFrames : 0.0;
+            // The predicates of conditional rendering are always from the previous frame
+            result.resultAge = culling == OcclusionCulling::Conditional ? 1.0 : (decidedFrames > 0 ? static_cast<double>(resultAge) / decidedFrames : 0.0);
+        }
+
+        return timings;
+    }
+
+    // Must match the shapes of the vertex shader
+    static constexpr uint32_t SHAPE_TRIANGLE = 0;
+    static constexpr uint32_t SHAPE_PROXY    = 1;
+    static constexpr uint32_t SHAPE_OCCLUDER = 2;
+
+    // The occluder is in front of the draws
+    static constexpr float OCCLUDER_DEPTH = 0.25f;
+    static constexpr float DRAW_DEPTH     = 0.5f;
+
+    struct DrawConstants
+    {
+        uint32_t instanceOffset = 0;
+        uint32_t gridSize       = 0;
+        float    depth          = DRAW_DEPTH;
+        uint32_t shape          = SHAPE_TRIANGLE;
+        uint32_t cellCount      = 0;
+    };
+
+    // Returns the number of draws skipped because they were hidden
+    uint32_t recordCommandBuffer(vk::CommandBuffer   commandBuffer,
+                                 uint32_t            slot,
+                                 Scenario const&     scenario,
+                                 OcclusionCulling    culling,
+                                 bool                firstFrame,
+                                 DrawListStatistics& drawStatistics)
+    {
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+        commandBuffer.begin(beginInfo);
+
+        if (m_timestampsSupported)
+        {
+            commandBuffer.resetQueryPool(m_queryPool, 2 * slot, 2);
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool, 2 * slot);
+        }
+
+        // One occlusion query per draw and frame in flight
+        uint32_t firstQuery         = slot * scenario.drawCount;
+        uint32_t previousFirstQuery = ((slot + FRAMES_IN_FLIGHT - 1) % FRAMES_IN_FLIGHT) * scenario.drawCount;
+
+        if (culling != OcclusionCulling::Off)
+        {
+            commandBuffer.resetQueryPool(m_occlusionQueryPool, firstQuery, scenario.drawCount);
+        }
+
+        if (culling == OcclusionCulling::Conditional && firstFrame)
+        {
+            // Nothing has been copied yet, so every draw is considered visible
+            commandBuffer.fillBuffer(m_conditionBuffer, 0, VK_WHOLE_SIZE, 1U);
+            conditionBufferBarrier(commandBuffer,
+                                   vk::PipelineStageFlagBits::eTransfer,
+                                   vk::AccessFlagBits::eTransferWrite,
+                                   vk::PipelineStageFlagBits::eConditionalRenderingEXT,
+                                   vk::AccessFlagBits::eConditionalRenderingReadEXT);
+        }
+
+        vk::RenderPassBeginInfo renderPassInfo;
+        renderPassInfo.renderPass        = m_renderPass;
+        renderPassInfo.framebuffer       = m_framebuffer;
+        renderPassInfo.renderArea.offset = vk::Offset2D(0, 0);
+        renderPassInfo.renderArea.extent = vk::Extent2D(RENDER_WIDTH, RENDER_HEIGHT);
+
+        std::array<vk::ClearValue, 2> clearValues;
+        clearValues[0].color           = vk::ClearColorValue(std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f}));
+        clearValues[1].depthStencil    = vk::ClearDepthStencilValue(1.0f, 0U);
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues    = clearValues.data();
+
+        commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+
+        DrawConstants constants;
+        constants.gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(scenario.drawCount) * scenario.instancesPerDraw)));
+
+        // Occluders are never culled, they are what hides the other draws
+        if (scenario.occluder)
+        {
+            DrawConstants occluderConstants = constants;
+            occluderConstants.depth         = OCCLUDER_DEPTH;
+            occluderConstants.shape         = SHAPE_OCCLUDER;
+
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipelines[0]);
+            commandBuffer.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(occluderConstants), &occluderConstants);
+            commandBuffer.draw(6, 1, 0, 0);
+        }
+
+        // The proxies neither write color nor depth, so they are only tested against the occluders
+        if (culling != OcclusionCulling::Off)
+        {
+            DrawConstants proxyConstants = constants;
+            proxyConstants.shape         = SHAPE_PROXY;
+            proxyConstants.cellCount     = scenario.instancesPerDraw;
+
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_proxyPipeline);
+
+            for (uint32_t draw = 0; draw < scenario.drawCount; ++draw)
+            {
+                proxyConstants.instanceOffset = draw * scenario.instancesPerDraw;
+                commandBuffer.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(proxyConstants), &proxyConstants);
+
+                commandBuffer.beginQuery(m_occlusionQueryPool, firstQuery + draw, vk::QueryControlFlags());
+                commandBuffer.draw(6, 1, 0, 0);
+                commandBuffer.endQuery(m_occlusionQueryPool, firstQuery + draw);
+            }
+        }
+
+        // Draws are submitted cycling through the pipelines, the worst case for state changes.
+        // Sorting groups them by pipeline. The triangles don't overlap, so the image doesn't depend on the order.
+        m_drawList.clear();
+        uint32_t skippedDraws = 0;
+        for (uint32_t draw = 0; draw < scenario.drawCount; ++draw)
+        {
+            if (culling == OcclusionCulling::Readback && !m_drawVisible[draw])
+            {
+                ++skippedDraws;
+                continue;
+            }
+
+            uint32_t pipelineIndex   = draw % static_cast<uint32_t>(m_pipelines.size());
+            constants.instanceOffset = draw * scenario.instancesPerDraw;
+
+            DrawCommand command;
+            command.pipeline      = m_pipelines[pipelineIndex];
+            command.layout        = m_pipelineLayout;
+            command.vertexCount   = 3;
+            command.instanceCount = scenario.instancesPerDraw;
+            command.setPushConstants(vk::ShaderStageFlagBits::eVertex, constants);
+
+            // Decided by the queries of the previous frame
+            if (culling == OcclusionCulling::Conditional)
+            {
+                command.conditionBuffer = m_conditionBuffer;
+                command.conditionOffset = (previousFirstQuery + draw) * sizeof(uint32_t);
+            }
+
+            m_drawList.add(DrawKey::make(0, pipelineIndex, 0), command);
+        }
+
+        if (m_settings.sortDraws)
+        {
+            m_drawList.sort();
+        }
+
+        m_drawList.record(commandBuffer, drawStatistics, &m_dispatch);
+
+        commandBuffer.endRenderPass();
+
+        if (culling == OcclusionCulling::Conditional)
+        {
+            // Earlier frames read the predicates of this slot, they have to be done before it is overwritten
+            conditionBufferBarrier(commandBuffer,
+                                   vk::PipelineStageFlagBits::eConditionalRenderingEXT,
+                                   vk::AccessFlags(),
+                                   vk::PipelineStageFlagBits::eTransfer,
+                                   vk::AccessFlags());
+
+            // The sample counts as 32-bit values, non-zero means visible
+            commandBuffer.copyQueryPoolResults(m_occlusionQueryPool, firstQuery, scenario.drawCount, m_conditionBuffer, firstQuery * sizeof(uint32_t), sizeof(uint32_t), vk::QueryResultFlagBits::eWait);
+
+            conditionBufferBarrier(commandBuffer,
+                                   vk::PipelineStageFlagBits::eTransfer,
+                                   vk::AccessFlagBits::eTransferWrite,
+                                   vk::PipelineStageFlagBits::eConditionalRenderingEXT,
+                                   vk::AccessFlagBits::eConditionalRenderingReadEXT);
+        }
+
+        if (m_timestampsSupported)
+        {
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 2 * slot + 1);
+        }
+
+        commandBuffer.end();
+
+        return skippedDraws;
+    }
+
+    void conditionBufferBarrier(vk::CommandBuffer       commandBuffer,
+                                vk::PipelineStageFlags  srcStage,
+                                vk::AccessFlags         srcAccess,
+                                vk::PipelineStageFlags  dstStage,
+                                vk::AccessFlags         dstAccess)
+    {
+        vk::BufferMemoryBarrier barrier;
+        barrier.srcAccessMask       = srcAccess;
+        barrier.dstAccessMask       = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer              = m_conditionBuffer;
+        barrier.offset              = 0;
+        barrier.size                = VK_WHOLE_SIZE;
+
+        commandBuffer.pipelineBarrier(srcStage, dstStage, vk::DependencyFlags(), nullptr, barrier, nullptr);
+    }
+
+    // Update the visibility of the draws from the occlusion queries of a finished frame,
+    // returns the number of hidden draws
+    uint32_t readOcclusionResults(uint32_t slot, uint32_t drawCount)
+    {
+        m_occlusionResults.resize(drawCount);
+
+        auto result = m_device.getQueryPoolResults(m_occlusionQueryPool, slot * drawCount, drawCount, drawCount * sizeof(uint64_t), m_occlusionResults.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess)
+        {
+            // Keep the previous visibility
+            return 0;
+        }
+
+        uint32_t hiddenDraws = 0;
+        for (uint32_t draw = 0; draw < drawCount; ++draw)
+        {
+            m_drawVisible[draw] = m_occlusionResults[draw] > 0 ? 1 : 0;
+            hiddenDraws += 1 - m_drawVisible[draw];
+        }
+
+        return hiddenDraws;
+    }
+
+    uint64_t submit(vk::CommandBuffer commandBuffer)
+    {
+        uint64_t signalValue = ++m_timelineValue;
+
+        vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo;
+        timelineSubmitInfo.signalSemaphoreValueCount = 1;
+        timelineSubmitInfo.pSignalSemaphoreValues    = &signalValue;
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.pNext                = &timelineSubmitInfo;
+        submitInfo.commandBufferCount   = 1;
+        submitInfo.pCommandBuffers      = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores    = &m_timeline;
+
+        m_queue.submit({submitInfo}, vk::Fence());
+
+        return signalValue;
+    }
+
+    uint64_t completedTimelineValue()
+    {
+        return m_device.getSemaphoreCounterValue(m_timeline);
+    }
+
+    void waitForTimeline(uint64_t value)
+    {
+        vk::SemaphoreWaitInfo waitInfo;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores    = &m_timeline;
+        waitInfo.pValues        = &value;
+
+        m_device.waitSemaphores(waitInfo, UINT64_MAX);
+    }
+
+    std::optional<double> readGpuFrameTime(uint32_t slot)
+    {
+        uint64_t timestamps[2] = {};
+        auto     result        = m_device.getQueryPoolResults(m_queryPool, 2 * slot, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess)
+        {
+            return std::nullopt;
+        }
+
+        return (timestamps[1] - timestamps[0]) * m_timestampPeriod / 1e6;
+    }
+
+    // A failed read is skipped, a zero would pull the percentiles down
+    void collectGpuFrameTime(uint32_t slot, std::vector<double>& gpuFrameTimes)
+    {
+        auto gpuFrameTime = readGpuFrameTime(slot);
+        if (gpuFrameTime)
+        {
+            gpuFrameTimes.push_back(gpuFrameTime.value());
+        }
+    }
+
+    // Copy the render target into the readback buffer and hash its contents
+    uint64_t readbackImageHash()
+    {
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.commandPool        = m_commandPool;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = 1;
+
+        vk::CommandBuffer commandBuffer = m_device.allocateCommandBuffers(allocInfo)[0];
+
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        commandBuffer.begin(beginInfo);
+
+        vk::BufferImageCopy region;
+        region.bufferOffset                    = 0;
+        region.bufferRowLength                 = 0; // Tightly packed
+        region.bufferImageHeight               = 0;
+        region.imageSubresource.aspectMask     = vk::ImageAspectFlagBits::eColor;
+        region.imageSubresource.mipLevel       = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount     = 1;
+        region.imageOffset                     = vk::Offset3D(0, 0, 0);
+        region.imageExtent                     = vk::Extent3D(RENDER_WIDTH, RENDER_HEIGHT, 1);
+
+        commandBuffer.copyImageToBuffer(m_renderTarget, vk::ImageLayout::eTransferSrcOptimal, m_readbackBuffer, region);
+
+        // Make the transfer visible to the host
+        vk::BufferMemoryBarrier barrier;
+        barrier.srcAccessMask       = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask       = vk::AccessFlagBits::eHostRead;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer              = m_readbackBuffer;
+        barrier.offset              = 0;
+        barrier.size                = VK_WHOLE_SIZE;
+
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), nullptr, barrier, nullptr);
+        commandBuffer.end();
+
+        waitForTimeline(submit(commandBuffer));
+        m_device.freeCommandBuffers(m_commandPool, commandBuffer);
+
+        size_t   size = RENDER_WIDTH * RENDER_HEIGHT * 4;
+        auto*    data = static_cast<uint8_t const*>(m_device.mapMemory(m_readbackMemory, 0, size));
+        uint64_t hash = hashBytes(data, size);
+        m_device.unmapMemory(m_readbackMemory);
+
+        return hash;
+    }
+
+    void uninitialize()
+    {
+        if (!m_device)
+        {
+            return;
+        }
+
+        m_device.waitIdle();
+
+        destroyOcclusionResources();
+        destroyPipelines();
+        m_pipelineLayoutCache.destroy();
+
+        m_device.destroyBuffer(m_readbackBuffer);
+        m_device.freeMemory(m_readbackMemory);
+        if (m_queryPool)
+        {
+            m_device.destroyQueryPool(m_queryPool);
+        }
+        m_device.destroySemaphore(m_timeline);
+        m_device.destroyCommandPool(m_commandPool);
+        m_device.destroyFramebuffer(m_framebuffer);
+        m_device.destroyRenderPass(m_renderPass);
+        m_device.destroyImageView(m_depthTargetView);
+        m_device.destroyImage(m_depthTarget);
+        m_device.freeMemory(m_depthTargetMemory);
+        m_device.destroyImageView(m_renderTargetView);
+        m_device.destroyImage(m_renderTarget);
+        m_device.freeMemory(m_renderTargetMemory);
+        m_device.destroy();
+        m_device = vk::Device();
+
+        m_instance.destroy();
+    }
+
+    BenchmarkSettings              m_settings;
+    OcclusionCulling               m_occlusionCulling = OcclusionCulling::Off;
+    vk::Instance                   m_instance;
+    vk::PhysicalDevice             m_physicalDevice;
+    std::string                    m_deviceName;
+    float                          m_timestampPeriod = 1.f; // Nanoseconds per timestamp tick
+    bool                           m_timestampsSupported = false;
+    uint32_t                       m_queueFamily = 0;
+    vk::Device                     m_device;
+    vk::Queue                      m_queue;
+    vk::DispatchLoaderDynamic      m_dispatch;
+    vk::Image                      m_renderTarget;
+    vk::DeviceMemory               m_renderTargetMemory;
+    vk::ImageView                  m_renderTargetView;
+    vk::Image                      m_depthTarget;
+    vk::DeviceMemory               m_depthTargetMemory;
+    vk::ImageView                  m_depthTargetView;
+    vk::RenderPass                 m_renderPass;
+    vk::Framebuffer                m_framebuffer;
+    PipelineLayoutCache            m_pipelineLayoutCache;
+    vk::PipelineLayout             m_pipelineLayout;
+    std::vector<vk::Pipeline>      m_pipelines;
+    vk::Pipeline                   m_proxyPipeline;
+    DrawList                       m_drawList;
+    vk::CommandPool                m_commandPool;
+    std::vector<vk::CommandBuffer> m_commandBuffers;
+    vk::Semaphore                  m_timeline;
+    uint64_t                       m_timelineValue = 0;
+    std::vector<uint64_t>          m_frameTimelineValues;
+    vk::QueryPool                  m_queryPool;
+    vk::Buffer                     m_readbackBuffer;
+    vk::DeviceMemory               m_readbackMemory;
+    vk::QueryPool                  m_occlusionQueryPool;
+    vk::Buffer                     m_conditionBuffer;
+    vk::DeviceMemory               m_conditionMemory;
+    std::vector<uint8_t>           m_drawVisible; // Per draw, from the latest occlusion query results
+    std::vector<uint64_t>          m_occlusionResults;
+};
+
+static void writeReport(std::ostream& stream, std::string const& deviceName, bool sortDraws, OcclusionCulling culling, std::vector<BenchmarkResult> const& results)
+{
+    JsonWriter json(stream);
+    json.beginObject();
+    json.field("device", deviceName);
+    json.field("sorted_draws", sortDraws);
+    json.field("occlusion_culling", occlusionCullingName(culling));
+
+    json.beginArray("scenarios");
+    for (auto const& result : results)
+    {
+        json.beginObject();
+        json.field("name", result.scenario);
+        json.field("frames", result.frameCount);
+        json.field("frames_per_second", result.framesPerSecond);
+        writeSeries(json, "cpu_frame_time_ms", result.cpuFrameTimes);
+        writeSeries(json, "gpu_frame_time_ms", result.gpuFrameTimes);
+        json.field("draws", result.drawStatistics.draws);
+        json.field("pipeline_binds", result.drawStatistics.pipelineBinds);
+        json.field("pipeline_binds_elided", result.drawStatistics.pipelineBindsElided);
+        if (culling != OcclusionCulling::Off)
+        {
+            json.field("culled_draws", result.culledDraws);
+            json.field("result_age_frames", result.resultAge);
+            json.field("baseline_gpu_frame_time_ms", result.baselineGpuFrameTime);
+            json.field("saved_gpu_time_ms", result.baselineGpuFrameTime - mean(result.gpuFrameTimes));
+        }
+        json.field("image_hash", formatHex(result.imageHash));
+        json.field("golden", result.goldenStatus);
+        json.endObject();
+    }
+    json.endArray();
+
+    json.endObject();
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        BenchmarkSettings settings = parseCommandLine(argc, argv);
+
+        std::vector<Scenario> scenarios;
+        for (auto const& scenario : SCENARIOS)
+        {
+            if (settings.scenarios.empty() || std::find(std::begin(settings.scenarios), std::end(settings.scenarios), scenario.name) != std::end(settings.scenarios))
+            {
+                scenarios.push_back(scenario);
+            }
+        }
+
+        if (scenarios.empty())
+        {
+            throw std::runtime_error("no matching scenario");
+        }
+
+        TriangleBenchmark benchmark(settings);
+        benchmark.initialize();
+
+        GoldenReferences golden(settings.goldenPath);
+        bool             failed = false;
+
+        std::vector<BenchmarkResult> results;
+        for (auto const& scenario : scenarios)
+        {
+            std::cerr << "running scenario '" << scenario.name << "'..." << std::endl;
+
+            BenchmarkResult result = benchmark.run(scenario);
+
+            auto reference = golden.find(result.scenario, benchmark.deviceName());
+            if (settings.updateGolden)
+            {
+                golden.set(result.scenario, benchmark.deviceName(), result.imageHash);
+                result.goldenStatus = "updated";
+            }
+            else if (!reference)
+            {
+                // Only an error where references are expected, other machines can still run the benchmark
+                result.goldenStatus = "missing";
+                failed              = failed || settings.requireGolden;
+                std::cerr << "scenario '" << result.scenario << "' has no golden reference for this device, run with --update-golden to record it" << std::endl;
+            }
+            else if (reference.value() == result.imageHash)
+            {
+                result.goldenStatus = "match";
+            }
+            else
+            {
+                result.goldenStatus = "mismatch";
+                failed              = true;
+                std::cerr << "scenario '" << result.scenario << "' does not match its golden reference" << std::endl;
+            }
+
+            results.push_back(result);
+        }
+
+        if (settings.updateGolden)
+        {
+            golden.save();
+        }
+
+        if (settings.outputPath.empty())
+        {
+            writeReport(std::cout, benchmark.deviceName(), settings.sortDraws, benchmark.occlusionCulling(), results);
+        }
+        else
+        {
+            std::ofstream output(settings.outputPath);
+            if (!output.is_open())
+            {
+                throw std::runtime_error("failed to open output file '" + settings.outputPath + "'");
+            }
+            writeReport(output, benchmark.deviceName(), settings.sortDraws, benchmark.occlusionCulling(), results);
+        }
+
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -2,18 +2,160 @@
 
 #include <GLFW/glfw3.h>
 
+#include <common/command-line.hpp>
+#include <common/debug-messenger.hpp>
+#include <common/deletion-queue.hpp>
+#include <common/device-selection.hpp>
+#include <common/file-watcher.hpp>
+#include <common/frame-capture.hpp>
+#include <common/job-system.hpp>
+#include <common/spirv-reflection.hpp>
+#include <common/startup-profile.hpp>
+#include <common/statistics.hpp>
+
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <optional>
 #include <set>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
+
+constexpr int      WINDOW_WIDTH             = 800;
+constexpr int      WINDOW_HEIGHT            = 600;
+constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT     = 8;
+constexpr uint32_t DEFAULT_CAPTURE_FRAME    = 100; // Late enough for startup effects to have settled
+
+using Clock = std::chrono::steady_clock;
+
+struct ApplicationSettings
+{
+    // Preferred present mode. If not set (or not available) mailbox is preferred with FIFO as fallback.
+    std::optional<vk::PresentModeKHR> presentMode;
+    // Requested number of swap chain images. If not set minImageCount + 1 is used.
+    std::optional<uint32_t> swapchainImageCount;
+    uint32_t                framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    // Wait for the oldest frame in flight right before sampling input instead of right before rendering.
+    bool framePacing = false;
+    // Recompile and reload the shaders whenever their sources change (development mode).
+    bool hotReload = false;
+    // Index, UUID or part of the name of the device to render on. The best ranked device if not set.
+    std::optional<std::string> device;
+    // Worker threads of the job system. One per hardware thread besides the main thread if not set.
+    std::optional<uint32_t> workerCount;
+    // Filter and rate limit of the validation layer messages, only used in debug builds
+    DebugMessengerSettings debugMessages;
+    // Write the commands of one frame to this file, for replaying them with drawing-triangle-replay.
+    // Nothing is captured if empty.
+    std::string capturePath;
+    uint32_t    captureFrame = DEFAULT_CAPTURE_FRAME;
+};
+
+static vk::PresentModeKHR parsePresentMode(std::string const& name)
+{
+    if (name == "immediate")
+    {
+        return vk::PresentModeKHR::eImmediate;
+    }
+    else if (name == "mailbox")
+    {
+        return vk::PresentModeKHR::eMailbox;
+    }
+    else if (name == "fifo")
+    {
+        return vk::PresentModeKHR::eFifo;
+    }
+    else if (name == "fifo-relaxed")
+    {
+        return vk::PresentModeKHR::eFifoRelaxed;
+    }
+
+    throw std::runtime_error("unknown present mode '" + name + "'");
+}
+
+static ApplicationSettings parseCommandLine(int argc, char** argv)
+{
+    ApplicationSettings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+
+        auto nextValue = [&]() -> std::string {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("missing value for option '" + option + "'");
+            }
+            return argv[++i];
+        };
+
+        if (option == "--present-mode")
+        {
+            settings.presentMode = parsePresentMode(nextValue());
+        }
+        else if (option == "--image-count")
+        {
+            settings.swapchainImageCount = parseCount(option, nextValue(), 1U, 16U);
+        }
+        else if (option == "--frames-in-flight")
+        {
+            settings.framesInFlight = parseCount(option, nextValue(), 1U, MAX_FRAMES_IN_FLIGHT);
+        }
+        else if (option == "--frame-pacing")
+        {
+            settings.framePacing = true;
+        }
+        else if (option == "--hot-reload")
+        {
+            settings.hotReload = true;
+        }
+        else if (option == "--device")
+        {
+            settings.device = nextValue();
+        }
+        else if (option == "--workers")
+        {
+            settings.workerCount = parseCount(option, nextValue(), 0U, 256U);
+        }
+        else if (option == "--debug-severity")
+        {
+            settings.debugMessages.minimumSeverity = parseDebugSeverity(nextValue());
+        }
+        else if (option == "--debug-types")
+        {
+            settings.debugMessages.types = parseDebugTypes(nextValue());
+        }
+        else if (option == "--debug-rate")
+        {
+            settings.debugMessages.messagesPerInterval = parseCount(option, nextValue(), 1U, 1000U);
+        }
+        else if (option == "--capture")
+        {
+            settings.capturePath = nextValue();
+        }
+        else if (option == "--capture-frame")
+        {
+            settings.captureFrame = parseCount(option, nextValue(), 0U, UINT32_MAX);
+        }
+        else
+        {
+            throw std::runtime_error("unknown option '" + option + "'");
+        }
+    }
 
-constexpr int WINDOW_WIDTH         = 800;
-constexpr int WINDOW_HEIGHT        = 600;
-constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    return settings;
+}
 
 static std::vector<char> readFile(std::string const& filename)
 {
@@ -33,20 +175,11 @@ static std::vector<char> readFile(std::string const& filename)
     return buffer;
 }
 
-static VKAPI_ATTR VkBool32 VKAPI_CALL
-debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT      messageSeverity,
-              VkDebugUtilsMessageTypeFlagsEXT             messageTypes,
-              VkDebugUtilsMessengerCallbackDataEXT const* pCallbackData,
-              void*                                       pUserData)
+// Compile an HLSL shader to SPIR-V the same way the build does
+static bool compileShader(std::string const& sourcePath, std::string const& spirvPath)
 {
-    std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
-
-    if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
-    {
-        // Important message
-    }
-
-    return VK_FALSE;
+    std::string command = std::string(SHADER_COMPILER) + " -V -D \"" + sourcePath + "\" -o \"" + spirvPath + "\" -e main";
+    return std::system(command.c_str()) == 0;
 }
 
 struct QueueFamilyIndices
@@ -68,9 +201,73 @@ struct SwapChainSupportDetails
     std::vector<vk::PresentModeKHR>   presentModes;
 };
 
+struct GraphicsPipeline
+{
+    vk::Pipeline       pipeline;
+    vk::PipelineLayout layout; // Owned by the pipeline layout cache
+};
+
+// Collects per frame timings to compare the latency of different
+// present mode/image count/frames in flight configurations
+class FrameStatistics
+{
+public:
+    using Duration = std::chrono::duration<double, std::milli>;
+
+    void addFrameTime(Duration frameTime)
+    {
+        m_frameTimes.push_back(frameTime.count());
+    }
+
+    // Time between sampling the input for a frame and observing its completion
+    void addLatency(Duration latency)
+    {
+        m_latencies.push_back(latency.count());
+    }
+
+    void report(std::ostream& stream, std::string const& configuration) const
+    {
+        stream << "frame statistics [" << configuration << "], " << m_frameTimes.size() << " frames" << std::endl;
+        reportSeries(stream, "frame time", m_frameTimes);
+        reportSeries(stream, "latency", m_latencies);
+    }
+
+private:
+    static void reportSeries(std::ostream& stream, char const* name, std::vector<double> const& values)
+    {
+        if (values.empty())
+        {
+            return;
+        }
+
+        double average  = mean(values);
+        double variance = std::accumulate(std::begin(values), std::end(values), 0.0,
+                                          [average](double sum, double v) { return sum + (v - average) * (v - average); }) /
+                          values.size();
+
+        stream << std::fixed << std::setprecision(3)
+               << "  " << name << ": mean " << average << " ms, variance " << variance << " ms^2, std dev " << std::sqrt(variance)
+               << " ms, p50 " << percentile(values, 0.5) << " ms, p99 " << percentile(values, 0.99) << " ms, max " << percentile(values, 1.0) << " ms"
+               << std::defaultfloat << std::endl;
+    }
+
+    std::vector<double> m_frameTimes;
+    std::vector<double> m_latencies;
+};
+
 class HelloTriangleApplication
 {
 public:
+    explicit HelloTriangleApplication(ApplicationSettings const& settings)
+        : m_settings(settings)
+#if !defined(NDEBUG)
+        , m_debugMessenger(settings.debugMessages)
+#endif
+        , m_frameCapture(settings.capturePath.empty() ? nullptr : std::make_unique<FrameCapture>())
+        , m_jobSystem(std::make_unique<JobSystem>(settings.workerCount.value_or(JobSystem::defaultWorkerCount())))
+    {
+    }
+
     void run()
     {
         initialize();
@@ -81,7 +278,7 @@ public:
 private:
     void initialize()
     {
-        initializeWindow();
+        m_startupProfile.measure("initializeWindow", [this] { initializeWindow(); });
         initializeVulkan();
     }
 
@@ -97,21 +294,67 @@ private:
 
     void initializeVulkan()
     {
-        createInstance();
+        std::pair<std::vector<char>, std::vector<char>> shaderCode;
+        JobCounter                                      shadersLoaded;
+        JobCounter                                      pipelineCreated;
+
+        // The jobs reference the locals above, so they are waited for before
+        // leaving this function, also when an exception is thrown
+        auto waitForJobs = [&]() {
+            m_jobSystem->wait(shadersLoaded);
+            m_jobSystem->wait(pipelineCreated);
+        };
+
+        // Loading the shaders doesn't depend on anything, so it starts right away
+        auto loadShaders = [this, &shaderCode]() {
+            m_startupProfile.measure("loadShaders", [&]() {
+                shaderCode = std::make_pair(readFile(PATH_TRIANGLE_SHADER_VERT), readFile(PATH_TRIANGLE_SHADER_FRAG));
+            });
+        };
+        m_jobSystem->run(loadShaders, &shadersLoaded);
+
+        try
+        {
+            m_startupProfile.measure("createInstance", [this]() { createInstance(); });
 #if !defined(NDEBUG)
-        createDebugMessenger();
+            m_startupProfile.measure("createDebugMessenger", [this]() { m_debugMessenger.create(m_instance); });
 #endif
-        createSurface();
-        selectPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain();
-        createImageViews();
-        createRenderPass();
-        createGraphicsPipeline();
-        createFramebuffers();
-        createCommandPool();
-        createCommandBuffers();
-        createSyncObjects();
+            m_startupProfile.measure("createSurface", [this]() { createSurface(); });
+            m_startupProfile.measure("selectPhysicalDevice", [this]() { selectPhysicalDevice(); });
+            m_startupProfile.measure("createLogicalDevice", [this]() { createLogicalDevice(); });
+            m_startupProfile.measure("chooseSwapChainSettings", [this]() { chooseSwapChainSettings(); });
+            m_startupProfile.measure("createRenderPass", [this]() { createRenderPass(); });
+
+            // The pipeline only depends on the render pass, the swap chain settings and the shaders,
+            // so it is compiled on a worker thread while the swap chain and the remaining objects are created.
+            // Until it's finished, the main thread must not touch the pipeline members.
+            auto createPipeline = [this, &shaderCode, &shadersLoaded]() {
+                // Pass a failed shader load on instead of compiling nothing
+                shadersLoaded.rethrowIfFailed();
+                m_startupProfile.measure("createGraphicsPipeline", [&]() { createGraphicsPipeline(shaderCode.first, shaderCode.second); });
+            };
+            m_jobSystem->runAfter(shadersLoaded, createPipeline, &pipelineCreated);
+
+            m_startupProfile.measure("createSwapChain", [this]() { createSwapChain(); });
+            m_startupProfile.measure("createImageViews", [this]() { createImageViews(); });
+            m_startupProfile.measure("createFramebuffers", [this]() { createFramebuffers(); });
+            m_startupProfile.measure("createCommandPool", [this]() { createCommandPool(); });
+            m_startupProfile.measure("createCommandBuffers", [this]() { createCommandBuffers(); });
+            m_startupProfile.measure("createSyncObjects", [this]() { createSyncObjects(); });
+        }
+        catch (...)
+        {
+            waitForJobs();
+            throw;
+        }
+
+        m_startupProfile.measure("waitForGraphicsPipeline", waitForJobs);
+        pipelineCreated.rethrowIfFailed();
+
+        if (m_settings.hotReload)
+        {
+            startShaderHotReload();
+        }
     }
 
     void createInstance()
@@ -156,7 +399,7 @@ private:
         instanceCreateInfo.enabledExtensionCount   = static_cast<uint32_t>(requiredExtensions.size());
 
 #if !defined(NDEBUG)
-        VkDebugUtilsMessengerCreateInfoEXT messengerCreateInfo = getDebugMessengerCreateInfo();
+        VkDebugUtilsMessengerCreateInfoEXT messengerCreateInfo = m_debugMessenger.createInfo();
         instanceCreateInfo.pNext                               = &messengerCreateInfo;
 #endif
 
@@ -227,28 +470,6 @@ private:
                            [&deviceExtensionNames](char const* name) { return std::find(std::begin(deviceExtensionNames), std::end(deviceExtensionNames), std::string(name)) != std::end(deviceExtensionNames); });
     }
 
-    vk::DebugUtilsMessengerCreateInfoEXT getDebugMessengerCreateInfo()
-    {
-        vk::DebugUtilsMessengerCreateInfoEXT createInfo;
-        createInfo.messageSeverity =
-            vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose |
-            vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning |
-            vk::DebugUtilsMessageSeverityFlagBitsEXT::eError;
-        createInfo.messageType =
-            vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral |
-            vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation |
-            vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance;
-        createInfo.pfnUserCallback = debugCallback;
-
-        return createInfo;
-    }
-
-    void createDebugMessenger()
-    {
-        vk::DebugUtilsMessengerCreateInfoEXT createInfo = getDebugMessengerCreateInfo();        
-        m_debugMessenger                                = m_instance.createDebugUtilsMessengerEXT(createInfo, nullptr, vk::DispatchLoaderDynamic(m_instance, &vkGetInstanceProcAddr));
-    }
-
     void createSurface()
     {
         VkSurfaceKHR surfaceRaw;
@@ -317,6 +538,16 @@ private:
 
     vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes)
     {
+        if (m_settings.presentMode.has_value())
+        {
+            if (std::find(std::begin(availablePresentModes), std::end(availablePresentModes), m_settings.presentMode.value()) != std::end(availablePresentModes))
+            {
+                return m_settings.presentMode.value();
+            }
+
+            std::cerr << "requested present mode '" << vk::to_string(m_settings.presentMode.value()) << "' not available, using default." << std::endl;
+        }
+
         for (const auto& presentMode : availablePresentModes)
         {
             if (presentMode == vk::PresentModeKHR::eMailbox)
@@ -358,32 +589,62 @@ private:
             swapChainAdequate                        = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
 
-        return queueFamilies.isComplete() && requiredExtensionsSupported && swapChainAdequate;
+        return queueFamilies.isComplete() && requiredExtensionsSupported && swapChainAdequate && isTimelineSemaphoreSupported(device);
+    }
+
+    bool isTimelineSemaphoreSupported(vk::PhysicalDevice const& device)
+    {
+        if (device.getProperties().apiVersion < VK_API_VERSION_1_2)
+        {
+            return false;
+        }
+
+        auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+        return features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore;
     }
 
     void selectPhysicalDevice()
     {
-        auto physicalDevices = m_instance.enumeratePhysicalDevices();
+        // Rank all devices instead of taking the first suitable one, which on hybrid
+        // systems is often the integrated GPU or a software implementation.
+        // With frame pacing requested, devices supporting present wait are preferred.
+        auto preferredFeaturesScore = [this](vk::PhysicalDevice const& device) -> int64_t {
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+            if (m_settings.framePacing && isPresentWaitSupported(device))
+            {
+                return 1000;
+            }
+#endif
+            return 0;
+        };
+
+        auto ranking = rankPhysicalDevices(m_instance, [this](auto const& d) { return isDeviceSuitable(d); }, preferredFeaturesScore);
 
-        if (physicalDevices.empty())
+        if (ranking.empty())
         {
             throw std::runtime_error("failed to find GPUs with Vulkan support");
         }
 
-        auto it = std::find_if(std::begin(physicalDevices), std::end(physicalDevices), [this](auto&& d) { return isDeviceSuitable(d); });
-        if (it == std::end(physicalDevices))
-        {
-            throw std::runtime_error("failed to find a suitable GPU!");
-        }
-        else
+        auto selected = findDevice(ranking, m_settings.device);
+        logDeviceRanking(std::cout, ranking, selected);
+
+        if (selected == nullptr)
         {
-            m_physicalDevice = *it;
+            throw std::runtime_error(m_settings.device ? "requested device '" + m_settings.device.value() + "' is not available or not suitable"
+                                                       : std::string("failed to find a suitable GPU!"));
         }
+
+        m_physicalDevice = selected->device;
+
+        // Queried once for the selected device and reused by the following stages.
+        // The window is not resizable, so the surface capabilities don't change.
+        m_queueFamilyIndices = findQueueFamilies(m_physicalDevice);
+        m_swapChainSupport   = querySwapChainSupport(m_physicalDevice);
     }
 
     void createLogicalDevice()
     {
-        QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+        QueueFamilyIndices const& indices = m_queueFamilyIndices;
 
         std::set<uint32_t> uniqueQueueFamilies{indices.graphicsFamily.value(), indices.presentFamily.value()};
 
@@ -400,14 +661,39 @@ private:
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
-        vk::PhysicalDeviceFeatures deviceFeatures;
+        vk::PhysicalDeviceVulkan12Features vulkan12Features;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+
+        vk::PhysicalDeviceFeatures2 deviceFeatures;
+        deviceFeatures.pNext = &vulkan12Features;
+
+        auto requiredDeviceExtensions = getRequiredDeviceExtensions();
+
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+        // Present wait lets the frame pacer block until a frame is actually on screen
+        // instead of until the GPU finished rendering it
+        vk::PhysicalDevicePresentIdFeaturesKHR   presentIdFeatures;
+        vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures;
+
+        if (m_settings.framePacing && isPresentWaitSupported(m_physicalDevice))
+        {
+            presentIdFeatures.presentId     = VK_TRUE;
+            presentIdFeatures.pNext         = &presentWaitFeatures;
+            presentWaitFeatures.presentWait = VK_TRUE;
+            vulkan12Features.pNext          = &presentIdFeatures;
+
+            requiredDeviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            requiredDeviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+            m_presentWaitEnabled = true;
+        }
+#endif
 
         vk::DeviceCreateInfo createInfo;
-        createInfo.pEnabledFeatures     = &deviceFeatures;
+        createInfo.pNext                = &deviceFeatures;
+        createInfo.pEnabledFeatures     = nullptr;
         createInfo.pQueueCreateInfos    = queueCreateInfos.data();
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
-        auto requiredDeviceExtensions      = getRequiredDeviceExtensions();
         createInfo.ppEnabledExtensionNames = requiredDeviceExtensions.data();
         createInfo.enabledExtensionCount   = static_cast<uint32_t>(requiredDeviceExtensions.size());
 
@@ -420,18 +706,51 @@ private:
 
         m_graphicsQueue = m_device.getQueue(indices.graphicsFamily.value(), 0U);
         m_presentQueue  = m_device.getQueue(indices.presentFamily.value(), 0U);
+
+        m_pipelineLayoutCache.setDevice(m_device);
+
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+        if (m_presentWaitEnabled)
+        {
+            // Not exported by the loader, so it has to be fetched from the device
+            m_vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(m_device.getProcAddr("vkWaitForPresentKHR"));
+        }
+#endif
+    }
+
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+    bool isPresentWaitSupported(vk::PhysicalDevice const& device)
+    {
+        if (!checkDeviceExtensionSupport(device, {VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME}))
+        {
+            return false;
+        }
+
+        auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        return features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+               features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+    }
+#endif
+
+    // Determine everything the render pass and the pipeline need to know about the swap chain
+    // up front, so they can be created before (or while) the swap chain itself is created.
+    void chooseSwapChainSettings()
+    {
+        m_swapchainExtent      = chooseSwapExtent(m_swapChainSupport.capabilities);
+        m_surfaceFormat        = chooseSwapSurfaceFormat(m_swapChainSupport.formats);
+        m_swapchainImageFormat = m_surfaceFormat.format;
+        m_presentMode          = chooseSwapPresentMode(m_swapChainSupport.presentModes);
     }
 
     void createSwapChain()
     {
-        auto swapChainSupport = querySwapChainSupport(m_physicalDevice);
+        SwapChainSupportDetails const& swapChainSupport = m_swapChainSupport;
 
-        m_swapchainExtent      = chooseSwapExtent(swapChainSupport.capabilities);
-        auto format            = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        m_swapchainImageFormat = format.format;
-        auto mode              = chooseSwapPresentMode(swapChainSupport.presentModes);
+        auto format = m_surfaceFormat;
+        auto mode   = m_presentMode;
 
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        uint32_t imageCount = m_settings.swapchainImageCount.value_or(swapChainSupport.capabilities.minImageCount + 1);
+        imageCount          = std::max(imageCount, swapChainSupport.capabilities.minImageCount);
 
         if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
         {
@@ -447,8 +766,8 @@ private:
         createInfo.imageArrayLayers = 1U;
         createInfo.imageUsage       = vk::ImageUsageFlagBits::eColorAttachment;
 
-        QueueFamilyIndices    indices = findQueueFamilies(m_physicalDevice);
-        std::vector<uint32_t> queueFamilyIndices{indices.graphicsFamily.value(), indices.presentFamily.value()};
+        QueueFamilyIndices const& indices = m_queueFamilyIndices;
+        std::vector<uint32_t>     queueFamilyIndices{indices.graphicsFamily.value(), indices.presentFamily.value()};
 
         if (indices.graphicsFamily.value() != indices.presentFamily.value())
         {
@@ -553,10 +872,22 @@ private:
         m_renderPass = m_device.createRenderPass(renderPassInfo);
     }
 
-    void createGraphicsPipeline()
+    void createGraphicsPipeline(std::vector<char> const& vertShaderCode, std::vector<char> const& fragShaderCode)
     {
-        auto vertShaderCode = readFile(PATH_TRIANGLE_SHADER_VERT);
-        auto fragShaderCode = readFile(PATH_TRIANGLE_SHADER_FRAG);
+        auto graphicsPipeline = buildGraphicsPipeline(vertShaderCode, fragShaderCode);
+        m_graphicsPipeline    = graphicsPipeline.pipeline;
+        m_pipelineLayout      = graphicsPipeline.layout;
+    }
+
+    // Only reads state that is fixed after initialization, so it can also be called from the shader reload thread
+    GraphicsPipeline buildGraphicsPipeline(std::vector<char> const& vertShaderCode, std::vector<char> const& fragShaderCode)
+    {
+        // The pipeline layout and vertex input are derived from the shaders,
+        // shaders with the same interface share the same pipeline layout.
+        auto vertReflection = reflectShader(vertShaderCode);
+        auto fragReflection = reflectShader(fragShaderCode);
+
+        vk::PipelineLayout pipelineLayout = m_pipelineLayoutCache.getPipelineLayout({vertReflection, fragReflection});
 
         auto vertShaderModule = createShaderModule(vertShaderCode);
         auto fragShaderModule = createShaderModule(fragShaderCode);
@@ -577,11 +908,8 @@ private:
             vertShaderStageInfo, fragShaderStageInfo
         };
 
-        vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
-        vertexInputInfo.pVertexBindingDescriptions      = nullptr;
-        vertexInputInfo.vertexBindingDescriptionCount   = 0U;
-        vertexInputInfo.pVertexAttributeDescriptions    = nullptr;
-        vertexInputInfo.vertexAttributeDescriptionCount = 0U;
+        VertexInputLayout                      vertexInputLayout(vertReflection);
+        vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vertexInputLayout.createInfo();
 
         vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
         inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
@@ -662,14 +990,6 @@ private:
         dynamicState.dynamicStateCount = 2;
         dynamicState.pDynamicStates    = dynamicStates;
 
-        vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
-        pipelineLayoutInfo.setLayoutCount         = 0;
-        pipelineLayoutInfo.pSetLayouts            = nullptr; // Optional
-        pipelineLayoutInfo.pushConstantRangeCount = 0;       // Optional
-        pipelineLayoutInfo.pPushConstantRanges    = nullptr; // Optional
-
-        m_pipelineLayout = m_device.createPipelineLayout(pipelineLayoutInfo);
-
         vk::GraphicsPipelineCreateInfo pipelineInfo;
         // Dynamic parts
         pipelineInfo.stageCount = 2;
@@ -683,7 +1003,7 @@ private:
         pipelineInfo.pDepthStencilState  = nullptr;
         pipelineInfo.pColorBlendState    = &colorBlending;
         pipelineInfo.pDynamicState       = nullptr;
-        pipelineInfo.layout              = m_pipelineLayout;
+        pipelineInfo.layout              = pipelineLayout;
         pipelineInfo.renderPass          = m_renderPass;
         pipelineInfo.subpass             = 0;
         // "Vulkan allows you to create a new graphics pipeline by deriving from an existing pipeline."
@@ -691,10 +1011,118 @@ private:
         pipelineInfo.basePipelineHandle  = vk::Pipeline(); // Optional
         pipelineInfo.basePipelineIndex   = -1;             // Optional
 
-        m_graphicsPipeline = m_device.createGraphicsPipelines(vk::PipelineCache(), { pipelineInfo }).value[0];
+        vk::Pipeline pipeline = m_device.createGraphicsPipelines(vk::PipelineCache(), { pipelineInfo }).value[0];
 
         m_device.destroyShaderModule(vertShaderModule);
         m_device.destroyShaderModule(fragShaderModule);
+
+        // The capture has to be able to create the pipeline again, also after a shader reload
+        if (m_frameCapture)
+        {
+            m_frameCapture->registerPipeline(pipeline, {vertShaderCode, fragShaderCode, inputAssembly.topology, rasterizer.polygonMode, rasterizer.cullMode, rasterizer.frontFace});
+        }
+
+        return {pipeline, pipelineLayout};
+    }
+
+    void startShaderHotReload()
+    {
+        m_hotReloadShaders = {
+            {SOURCE_PATH_TRIANGLE_SHADER_VERT, std::string(PATH_TRIANGLE_SHADER_VERT) + ".reload", readFile(PATH_TRIANGLE_SHADER_VERT)},
+            {SOURCE_PATH_TRIANGLE_SHADER_FRAG, std::string(PATH_TRIANGLE_SHADER_FRAG) + ".reload", readFile(PATH_TRIANGLE_SHADER_FRAG)},
+        };
+
+        std::vector<std::string> sourcePaths;
+        for (auto const& shader : m_hotReloadShaders)
+        {
+            sourcePaths.push_back(shader.sourcePath);
+        }
+
+        m_shaderWatcher = std::make_unique<FileWatcher>(sourcePaths, [this](std::set<std::string> const& changedFiles) { reloadShaders(changedFiles); });
+    }
+
+    // Runs on the file watcher thread. Compiles the changed shaders and builds a new pipeline,
+    // which is swapped in by the render loop at the next frame boundary.
+    void reloadShaders(std::set<std::string> const& changedFiles)
+    {
+        auto start = Clock::now();
+
+        for (auto& shader : m_hotReloadShaders)
+        {
+            if (changedFiles.count(shader.sourcePath) == 0)
+            {
+                continue;
+            }
+
+            if (!compileShader(shader.sourcePath, shader.spirvPath))
+            {
+                // Keep the current pipeline, the compiler already printed the errors
+                std::cerr << "failed to compile shader '" << shader.sourcePath << "'" << std::endl;
+                return;
+            }
+
+            shader.code = readFile(shader.spirvPath);
+        }
+
+        GraphicsPipeline pipeline;
+        try
+        {
+            pipeline = buildGraphicsPipeline(m_hotReloadShaders[0].code, m_hotReloadShaders[1].code);
+        }
+        catch (std::exception const& e)
+        {
+            std::cerr << "failed to rebuild graphics pipeline: " << e.what() << std::endl;
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_pendingPipelineMutex);
+        if (m_pendingPipeline)
+        {
+            // Superseded before the render loop picked it up, so it was never used
+            unregisterCapturedPipeline(m_pendingPipeline->pipeline);
+            m_device.destroyPipeline(m_pendingPipeline->pipeline);
+        }
+        m_pendingPipeline = pipeline;
+
+        std::cout << "reloaded shaders in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() << " ms" << std::endl;
+    }
+
+    // Swap in a reloaded pipeline. The old one may still be used by frames in flight, so its destruction is deferred.
+    void applyPendingPipeline()
+    {
+        std::lock_guard<std::mutex> lock(m_pendingPipelineMutex);
+        if (m_pendingPipeline)
+        {
+            // Layouts are owned by the cache and stay alive
+            unregisterCapturedPipeline(m_graphicsPipeline);
+            destroyDeferred(m_graphicsPipeline);
+            m_graphicsPipeline = m_pendingPipeline->pipeline;
+            m_pipelineLayout   = m_pendingPipeline->layout;
+            m_pendingPipeline.reset();
+        }
+    }
+
+    void stopShaderHotReload()
+    {
+        // Joins the watcher thread, so no reload can be in progress afterwards
+        m_shaderWatcher.reset();
+
+        if (m_pendingPipeline)
+        {
+            unregisterCapturedPipeline(m_pendingPipeline->pipeline);
+            m_device.destroyPipeline(m_pendingPipeline->pipeline);
+            m_pendingPipeline.reset();
+        }
+    }
+
+    // Without this, every hot reload would keep the shaders of the replaced pipeline around
+    void unregisterCapturedPipeline(vk::Pipeline pipeline)
+    {
+        if (m_frameCapture)
+        {
+            m_frameCapture->unregisterPipeline(pipeline);
+        }
     }
 
     void createFramebuffers()
@@ -721,11 +1149,10 @@ private:
 
     void createCommandPool()
     {
-        auto queueFamilyIndices = findQueueFamilies(m_physicalDevice);
-
         vk::CommandPoolCreateInfo poolInfo;
-        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-        poolInfo.flags            = vk::CommandPoolCreateFlags();               // Optional
+        poolInfo.queueFamilyIndex = m_queueFamilyIndices.graphicsFamily.value();
+        // Command buffers are recorded every frame
+        poolInfo.flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
 
         m_commandPool = m_device.createCommandPool(poolInfo);
     }
@@ -738,74 +1165,234 @@ private:
         // but not executed from other command buffers.
         // For secondary ones it's the other way around.
         allocInfo.level              = vk::CommandBufferLevel::ePrimary;
-        allocInfo.commandBufferCount = m_swapchainFramebuffers.size();
+        // One command buffer per frame in flight, which is re-recorded every frame,
+        // so changes (like a reloaded pipeline) don't require touching command buffers in use
+        allocInfo.commandBufferCount = m_settings.framesInFlight;
 
         m_commandBuffers = m_device.allocateCommandBuffers(allocInfo);
 
-        for (size_t i = 0; i < m_commandBuffers.size(); i++)
-        {
-            vk::CommandBufferBeginInfo beginInfo;
-            beginInfo.flags            = vk::CommandBufferUsageFlags();
-            beginInfo.pInheritanceInfo = nullptr;
+        // The draws are recorded into secondary command buffers on a worker thread,
+        // the primary one just wraps them in the render pass of the acquired image
+        allocInfo.level      = vk::CommandBufferLevel::eSecondary;
+        m_drawCommandBuffers = m_device.allocateCommandBuffers(allocInfo);
+    }
 
-            // "If the command buffer was already recorded once, 
-            // then a call to vkBeginCommandBuffer will implicitly reset it".
-            m_commandBuffers[i].begin(beginInfo);
+    // Runs as a job. It doesn't need the swap chain image, so it is recorded while the
+    // main thread waits for the image to be acquired.
+    // The commands are also appended to the capture if one is given.
+    void recordDrawCommands(vk::CommandBuffer commandBuffer, CommandCapture* capture)
+    {
+        // The framebuffer isn't known yet, it is optional for secondary command buffers
+        vk::CommandBufferInheritanceInfo inheritanceInfo;
+        inheritanceInfo.renderPass = m_renderPass;
+        inheritanceInfo.subpass    = 0;
 
-            vk::RenderPassBeginInfo renderPassInfo;
-            renderPassInfo.renderPass        = m_renderPass;
-            renderPassInfo.framebuffer       = m_swapchainFramebuffers[i];
-            renderPassInfo.renderArea.offset = {0, 0};
-            renderPassInfo.renderArea.extent = m_swapchainExtent; 
+        vk::CommandBufferBeginInfo beginInfo;
+        // The whole secondary command buffer is executed inside the render pass
+        beginInfo.flags            = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-            vk::ClearValue clearColor      = std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f});
-            renderPassInfo.clearValueCount = 1;
-            renderPassInfo.pClearValues    = &clearColor;
+        commandBuffer.begin(beginInfo);
 
-            m_commandBuffers[i].beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-            m_commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphicsPipeline);
-            m_commandBuffers[i].draw(3, 1, 0, 0);
-            m_commandBuffers[i].endRenderPass();
+        CapturingCommandBuffer recorder(commandBuffer, m_frameCapture.get(), capture);
+        recorder.bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphicsPipeline);
+        recorder.draw(3, 1, 0, 0);
 
-            m_commandBuffers[i].end();
-        }
+        commandBuffer.end();
     }
 
-    void createSyncObjects()
+    void recordCommandBuffer(vk::CommandBuffer commandBuffer, vk::CommandBuffer drawCommandBuffer, uint32_t imageIndex, CommandCapture* capture, CommandCapture const* drawCapture)
     {
-        m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        m_imagesInFlight.resize(m_swapchainImages.size());
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.flags            = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        beginInfo.pInheritanceInfo = nullptr;
+
+        // "If the command buffer was already recorded once, 
+        // then a call to vkBeginCommandBuffer will implicitly reset it".
+        commandBuffer.begin(beginInfo);
+
+        vk::RenderPassBeginInfo renderPassInfo;
+        renderPassInfo.renderPass        = m_renderPass;
+        renderPassInfo.framebuffer       = m_swapchainFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = m_swapchainExtent; 
+
+        vk::ClearValue clearColor      = std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f});
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues    = &clearColor;
+
+        // The contents of the render pass come from the secondary command buffer
+        CapturingCommandBuffer recorder(commandBuffer, m_frameCapture.get(), capture);
+        recorder.beginRenderPass(renderPassInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+        recorder.executeCommands(drawCommandBuffer, drawCapture);
+        recorder.endRenderPass();
+
+        commandBuffer.end();
+    }
 
+    void createSyncObjects()
+    {
+        m_imageAvailableSemaphores.resize(m_settings.framesInFlight);
+        m_renderFinishedSemaphores.resize(m_settings.framesInFlight);
+        m_frameTimelineValues.resize(m_settings.framesInFlight, 0U);
+        m_inputTimestamps.resize(m_settings.framesInFlight);
+        m_imageTimelineValues.resize(m_swapchainImages.size(), 0U);
+
+        // The swap chain only works with binary semaphores,
+        // so these are still needed for acquiring and presenting images.
         vk::SemaphoreCreateInfo semaphoreInfo;
-        vk::FenceCreateInfo     fenceInfo;
-        fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
 
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        for (uint32_t i = 0; i < m_settings.framesInFlight; ++i)
         {
             m_imageAvailableSemaphores[i] = m_device.createSemaphore(semaphoreInfo);
             m_renderFinishedSemaphores[i] = m_device.createSemaphore(semaphoreInfo);   
-            m_inFlightFences[i]           = m_device.createFence(fenceInfo);
         }
 
+        // Everything else is tracked by a single timeline semaphore for the graphics queue.
+        // Each submission signals the next value, so waiting for a frame (or for any work
+        // recorded alongside it) means waiting for the value of its submission.
+        vk::SemaphoreTypeCreateInfo timelineInfo;
+        timelineInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        timelineInfo.initialValue  = 0U;
+
+        vk::SemaphoreCreateInfo timelineSemaphoreInfo;
+        timelineSemaphoreInfo.pNext = &timelineInfo;
+
+        m_graphicsTimeline = m_device.createSemaphore(timelineSemaphoreInfo);
+    }
+
+    // Block until the graphics queue has reached the given timeline value
+    void waitForGraphicsTimeline(uint64_t value)
+    {
+        vk::SemaphoreWaitInfo waitInfo;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores    = &m_graphicsTimeline;
+        waitInfo.pValues        = &value;
+
+        m_device.waitSemaphores(waitInfo, UINT64_MAX);
+    }
+
+    // Destroy a device object once all work submitted so far has finished
+    template<typename T>
+    void destroyDeferred(T handle)
+    {
+        m_deletionQueue.push(m_graphicsTimelineValue, [device = m_device, handle]() { device.destroy(handle); });
+    }
+
+    // Last timeline value the graphics queue has finished, i.e. all work
+    // submitted with a value less or equal to this is done.
+    uint64_t completedGraphicsTimelineValue()
+    {
+        return m_device.getSemaphoreCounterValue(m_graphicsTimeline);
     }
 
     void mainLoop()
     {
+        std::optional<Clock::time_point> previousInputTimestamp;
+
         while (!glfwWindowShouldClose(m_window))
         {
+            // With frame pacing, the wait for the oldest frame in flight happens
+            // before sampling the input, so the input is as fresh as possible
+            // when the frame is recorded.
+            if (m_settings.framePacing)
+            {
+                waitForFrameSlot();
+            }
+
             glfwPollEvents();
-            drawFrame();
+
+            auto inputTimestamp = Clock::now();
+            if (previousInputTimestamp)
+            {
+                m_frameStatistics.addFrameTime(inputTimestamp - previousInputTimestamp.value());
+            }
+            previousInputTimestamp = inputTimestamp;
+
+            drawFrame(inputTimestamp);
+
+            if (m_frameCount++ == 0)
+            {
+                m_startupProfile.mark("first frame submitted");
+                m_startupProfile.report(std::cout);
+            }
         }
 
         m_device.waitIdle();
+
+        m_frameStatistics.report(std::cout, describeConfiguration());
     }
 
-    void drawFrame()
+    std::string describeConfiguration()
+    {
+        std::ostringstream stream;
+        stream << "present mode: " << vk::to_string(m_presentMode)
+               << ", images: " << m_swapchainImages.size()
+               << ", frames in flight: " << m_settings.framesInFlight
+               << ", frame pacing: " << (m_settings.framePacing ? "on" : "off")
+               << ", present wait: " << (m_presentWaitEnabled ? "on" : "off")
+               << ", job workers: " << m_jobSystem->workerCount();
+        return stream.str();
+    }
+
+    // Wait until the oldest frame in flight (the one using the current frame id) is finished
+    void waitForFrameSlot()
+    {
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+        if (m_presentWaitEnabled && m_presentId >= m_settings.framesInFlight)
+        {
+            // The oldest frame in flight was presented with this id
+            uint64_t presentId = m_presentId + 1 - m_settings.framesInFlight;
+            VkResult result    = m_vkWaitForPresentKHR(m_device, m_swapchain, presentId, UINT64_MAX);
+            if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            {
+                // Out of date, lost surface or timeout. The swap chain isn't recreated by this sample,
+                // so the timeline wait below has to do for the rest of the run.
+                std::cerr << "waiting for present failed (" << vk::to_string(static_cast<vk::Result>(result)) << "), present wait disabled" << std::endl;
+                m_presentWaitEnabled = false;
+            }
+        }
+#endif
+
+        waitForGraphicsTimeline(m_frameTimelineValues[m_currentFrame]);
+
+        // The completion of the frame that used the slot before is only observed here, so the latency
+        // is an upper bound. Its timestamp is replaced by the one of the next frame after this wait.
+        if (m_inputTimestamps[m_currentFrame])
+        {
+            m_frameStatistics.addLatency(Clock::now() - m_inputTimestamps[m_currentFrame].value());
+            m_inputTimestamps[m_currentFrame].reset();
+        }
+    }
+
+    void drawFrame(Clock::time_point inputTimestamp)
     {
         // Wait until a previous draw call finished using this frame id
-        m_device.waitForFences({m_inFlightFences[m_currentFrame]}, VK_TRUE, UINT64_MAX);
+        if (!m_settings.framePacing)
+        {
+            waitForFrameSlot();
+        }
+
+        // Only now, on both paths, the slot's timestamp of the previous frame has been consumed
+        m_inputTimestamps[m_currentFrame] = inputTimestamp;
+
+        // Release everything the GPU is done with in one go
+        m_deletionQueue.collect(completedGraphicsTimelineValue());
+
+        if (m_settings.hotReload)
+        {
+            applyPendingPipeline();
+        }
+
+        // The frame slot is free again, so its draws can be recorded while the main thread
+        // acquires the image. Both command buffers come from the same pool, which is fine
+        // since the primary one is only recorded after the job has finished.
+        vk::CommandBuffer drawCommandBuffer = m_drawCommandBuffers[m_currentFrame];
+
+        // Only the requested frame is captured, all others just forward the commands
+        bool            capturing   = m_frameCapture && m_frameCount == m_settings.captureFrame;
+        CommandCapture* drawCapture = capturing ? &m_drawCapture : nullptr;
+        m_jobSystem->run([this, drawCommandBuffer, drawCapture]() { recordDrawCommands(drawCommandBuffer, drawCapture); }, &m_frameJobs);
 
         // Get the next available swap chain image and a semaphore that signals 
         // when the device has finished writing to it
@@ -813,13 +1400,20 @@ private:
 
         // Check if a previous frame (not equal to the current frame id) 
         // is using this image and wait for its draw call to finish
-        if (m_imagesInFlight[imageIndex])
-        {
-            m_device.waitForFences({m_imagesInFlight[imageIndex]}, VK_TRUE, UINT64_MAX);
-        }
+        waitForGraphicsTimeline(m_imageTimelineValues[imageIndex]);
+
+        // This frame's submission signals the next timeline value
+        uint64_t frameTimelineValue = ++m_graphicsTimelineValue;
+
+        // Mark the image and the frame id as now being in use by this frame
+        m_imageTimelineValues[imageIndex]     = frameTimelineValue;
+        m_frameTimelineValues[m_currentFrame] = frameTimelineValue;
 
-        // Mark the image as now being in use by this frame
-        m_imagesInFlight[imageIndex] = m_inFlightFences[m_currentFrame];
+        // Help with the jobs of the frame instead of blocking
+        m_jobSystem->wait(m_frameJobs);
+        m_frameJobs.rethrowIfFailed();
+
+        recordCommandBuffer(m_commandBuffers[m_currentFrame], drawCommandBuffer, imageIndex, capturing ? &m_capture : nullptr, drawCapture);
 
         vk::SubmitInfo submitInfo;
 
@@ -831,20 +1425,39 @@ private:
         submitInfo.pWaitDstStageMask            = waitStages;
 
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers    = &m_commandBuffers[imageIndex];
+        submitInfo.pCommandBuffers    = &m_commandBuffers[m_currentFrame];
 
-        vk::Semaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame]};
-        submitInfo.signalSemaphoreCount  = 1;
+        vk::Semaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame], m_graphicsTimeline};
+        submitInfo.signalSemaphoreCount  = 2;
         submitInfo.pSignalSemaphores     = signalSemaphores;
 
-        // Reset the fence for this frame and make sure 
-        // it is signalled after the queue finishes
-        m_device.resetFences(1, &m_inFlightFences[m_currentFrame]);
-        m_graphicsQueue.submit({submitInfo}, m_inFlightFences[m_currentFrame]);
+        // Values for binary semaphores are ignored
+        uint64_t waitValues[]   = {0U};
+        uint64_t signalValues[] = {0U, frameTimelineValue};
+
+        vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo;
+        timelineSubmitInfo.waitSemaphoreValueCount   = 1;
+        timelineSubmitInfo.pWaitSemaphoreValues      = waitValues;
+        timelineSubmitInfo.signalSemaphoreValueCount = 2;
+        timelineSubmitInfo.pSignalSemaphoreValues    = signalValues;
+        submitInfo.pNext                             = &timelineSubmitInfo;
+
+        m_graphicsQueue.submit({submitInfo}, vk::Fence());
+
+        // Presenting isn't part of the capture, the replay renders into an offscreen image of the same format and size
+        if (capturing)
+        {
+            m_frameCapture->save(m_settings.capturePath, m_swapchainImageFormat, m_swapchainExtent, m_capture);
+            std::cout << "captured frame " << m_frameCount << " to '" << m_settings.capturePath << "'" << std::endl;
+            m_captureSaved = true;
+
+            m_drawCapture.clear();
+            m_capture.clear();
+        }
 
         vk::PresentInfoKHR presentInfo;
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores    = signalSemaphores;
+        presentInfo.pWaitSemaphores    = &m_renderFinishedSemaphores[m_currentFrame];
 
         vk::SwapchainKHR swapchains[] = {m_swapchain};
         presentInfo.swapchainCount    = 1;
@@ -852,23 +1465,47 @@ private:
         presentInfo.pImageIndices     = &imageIndex;
         presentInfo.pResults = nullptr;
 
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+        vk::PresentIdKHR presentIdInfo;
+        uint64_t         presentId = m_presentId + 1;
+        if (m_presentWaitEnabled)
+        {
+            presentIdInfo.swapchainCount = 1;
+            presentIdInfo.pPresentIds    = &presentId;
+            presentInfo.pNext            = &presentIdInfo;
+        }
+#endif
+
         m_presentQueue.presentKHR(presentInfo);
+        ++m_presentId;
 
-        m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        m_currentFrame = (m_currentFrame + 1) % m_settings.framesInFlight;
     }
 
     void uninitialize()
     {
+        if (m_frameCapture && !m_captureSaved)
+        {
+            std::cerr << "the window was closed after " << m_frameCount << " frames, before frame " << m_settings.captureFrame
+                      << " could be captured. Nothing was written to '" << m_settings.capturePath << "'" << std::endl;
+        }
+
+        stopShaderHotReload();
+
+        // The device is idle at this point
+        m_deletionQueue.flush();
+
         glfwDestroyWindow(m_window);
         glfwTerminate();
 
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        for (uint32_t i = 0; i < m_settings.framesInFlight; ++i)
         {
             m_device.destroySemaphore(m_imageAvailableSemaphores[i]);
             m_device.destroySemaphore(m_renderFinishedSemaphores[i]);
-            m_device.destroyFence(m_inFlightFences[i]);
         }
 
+        m_device.destroySemaphore(m_graphicsTimeline);
+
         m_device.destroyCommandPool(m_commandPool);
 
         for (auto framebuffer : m_swapchainFramebuffers)
@@ -882,52 +1519,90 @@ private:
         }
 
         m_device.destroyPipeline(m_graphicsPipeline);
-        m_device.destroyPipelineLayout(m_pipelineLayout);
+        m_pipelineLayoutCache.destroy();
         m_device.destroyRenderPass(m_renderPass);
         m_device.destroySwapchainKHR(m_swapchain);
         m_device.destroy();
 
 #if !defined(NDEBUG)
-        m_instance.destroyDebugUtilsMessengerEXT(m_debugMessenger, nullptr, vk::DispatchLoaderDynamic(m_instance, &vkGetInstanceProcAddr));
+        m_debugMessenger.destroy();
 #endif
         m_instance.destroySurfaceKHR(m_surface);
         m_instance.destroy();
     }
 
-    GLFWwindow*  m_window;
-    vk::Instance m_instance;
+    ApplicationSettings m_settings;
+    GLFWwindow*         m_window;
+    vk::Instance        m_instance;
 #if !defined(NDEBUG)
-    vk::DebugUtilsMessengerEXT m_debugMessenger;
+    DebugMessenger m_debugMessenger; // Outlives the instance, it receives the messages of its destruction
 #endif
     vk::SurfaceKHR                 m_surface;
     vk::PhysicalDevice             m_physicalDevice;
+    QueueFamilyIndices             m_queueFamilyIndices;
+    SwapChainSupportDetails        m_swapChainSupport;
     vk::Device                     m_device;
     vk::Queue                      m_graphicsQueue;
     vk::Queue                      m_presentQueue;
     vk::SwapchainKHR               m_swapchain;
+    vk::SurfaceFormatKHR           m_surfaceFormat;
     vk::Format                     m_swapchainImageFormat;
     vk::Extent2D                   m_swapchainExtent;
     std::vector<vk::Image>         m_swapchainImages;
     std::vector<vk::ImageView>     m_swapchainImageViews;
     vk::RenderPass                 m_renderPass;
+    PipelineLayoutCache            m_pipelineLayoutCache;
     vk::PipelineLayout             m_pipelineLayout;
     vk::Pipeline                   m_graphicsPipeline;
+    std::optional<GraphicsPipeline> m_pendingPipeline; // Reloaded pipeline waiting to be swapped in
+    std::mutex                      m_pendingPipelineMutex;
     std::vector<vk::Framebuffer>   m_swapchainFramebuffers;
     vk::CommandPool                m_commandPool;
     std::vector<vk::CommandBuffer> m_commandBuffers;
+    std::vector<vk::CommandBuffer> m_drawCommandBuffers; // Secondary, recorded by a job
     std::vector<vk::Semaphore>     m_imageAvailableSemaphores;
     std::vector<vk::Semaphore>     m_renderFinishedSemaphores;
-    std::vector<vk::Fence>         m_inFlightFences;
-    std::vector<vk::Fence>         m_imagesInFlight;
+    vk::Semaphore                  m_graphicsTimeline;
+    uint64_t                       m_graphicsTimelineValue = 0; // Last value submitted to the graphics queue
+    std::vector<uint64_t>          m_frameTimelineValues;       // Per frame id
+    std::vector<uint64_t>          m_imageTimelineValues;       // Per swap chain image
+    DeletionQueue                  m_deletionQueue;
+
+    struct HotReloadShader
+    {
+        std::string       sourcePath;
+        std::string       spirvPath;
+        std::vector<char> code; // Last successfully compiled SPIR-V
+    };
+
+    std::vector<HotReloadShader> m_hotReloadShaders; // Vertex and fragment shader, only accessed by the watcher thread
+    std::unique_ptr<FileWatcher> m_shaderWatcher;
     size_t                         m_currentFrame = 0;
+    vk::PresentModeKHR             m_presentMode;
+    bool                           m_presentWaitEnabled = false;
+    uint64_t                       m_presentId          = 0;
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+    PFN_vkWaitForPresentKHR m_vkWaitForPresentKHR = nullptr;
+#endif
+    std::vector<std::optional<Clock::time_point>> m_inputTimestamps;
+    FrameStatistics                                m_frameStatistics;
+    uint64_t                                       m_frameCount = 0;
+    StartupProfile                                 m_startupProfile;
+    JobCounter                                     m_frameJobs;
+    std::unique_ptr<FrameCapture>                  m_frameCapture; // Only created when a capture is requested
+    CommandCapture                                 m_capture;      // Primary command buffer of the captured frame
+    CommandCapture                                 m_drawCapture;  // Secondary command buffer of the captured frame
+    bool                                           m_captureSaved = false;
+    // Declared last, so it is destroyed first and the jobs still in flight finish
+    // while everything they touch is alive
+    std::unique_ptr<JobSystem> m_jobSystem;
 };
 
-int main()
+int main(int argc, char** argv)
 {
-    HelloTriangleApplication app;
-
     try
     {
+        HelloTriangleApplication app(parseCommandLine(argc, argv));
         app.run();
     }
     catch (std::exception const& e)
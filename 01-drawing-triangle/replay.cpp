@@ -0,0 +1,808 @@
+#include <vulkan/vulkan.hpp>
+
+#include <common/command-line.hpp>
+#include <common/device-selection.hpp>
+#include <common/frame-capture.hpp>
+#include <common/json-writer.hpp>
+#include <common/spirv-reflection.hpp>
+#include <common/statistics.hpp>
+#include <common/utilities.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Executes a frame captured by drawing-triangle --capture again, headless and as often as requested,
+// and reports how long it took. The frame is recorded once and submitted for every iteration,
+// so the timings only contain the submission and the GPU work of the captured commands.
+
+constexpr uint32_t DEFAULT_ITERATIONS = 100;
+constexpr uint32_t WARMUP_ITERATIONS  = 3;
+
+using Clock = std::chrono::steady_clock;
+
+struct ReplaySettings
+{
+    std::string                capturePath;
+    uint32_t                   iterations = DEFAULT_ITERATIONS;
+    std::optional<std::string> device;     // Index, UUID or part of the name, best device if not set
+    std::string                outputPath; // JSON report, stdout if empty
+};
+
+struct ReplayResult
+{
+    uint32_t            iterations = 0;
+    uint32_t            commands   = 0;
+    uint32_t            draws      = 0;
+    std::vector<double> cpuFrameTimes; // ms, submission until the fence is seen
+    std::vector<double> gpuFrameTimes; // ms, from timestamps
+    uint64_t            firstImageHash = 0;
+    uint64_t            lastImageHash  = 0;
+};
+
+static ReplaySettings parseCommandLine(int argc, char** argv)
+{
+    ReplaySettings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+
+        auto nextValue = [&]() -> std::string {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("missing value for option '" + option + "'");
+            }
+            return argv[++i];
+        };
+
+        if (option == "--iterations")
+        {
+            settings.iterations = parseCount(option, nextValue(), 1U, 1000000U);
+        }
+        else if (option == "--device")
+        {
+            settings.device = nextValue();
+        }
+        else if (option == "--output")
+        {
+            settings.outputPath = nextValue();
+        }
+        else if (option.rfind("--", 0) == 0)
+        {
+            throw std::runtime_error("unknown option '" + option + "'");
+        }
+        else if (settings.capturePath.empty())
+        {
+            settings.capturePath = option;
+        }
+        else
+        {
+            throw std::runtime_error("only one capture can be replayed at a time");
+        }
+    }
+
+    if (settings.capturePath.empty())
+    {
+        throw std::runtime_error("usage: drawing-triangle-replay CAPTURE [--iterations N] [--device INDEX|UUID|NAME] [--output FILE]");
+    }
+
+    return settings;
+}
+
+// Bytes per pixel of the formats a swap chain is created with in practice
+static uint32_t formatSize(vk::Format format)
+{
+    switch (format)
+    {
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eA2B10G10R10UnormPack32:
+    case vk::Format::eA2R10G10B10UnormPack32:
+        return 4;
+    case vk::Format::eR16G16B16A16Sfloat:
+        return 8;
+    default:
+        throw std::runtime_error("unsupported render target format " + vk::to_string(format));
+    }
+}
+
+class FrameReplay
+{
+public:
+    FrameReplay(ReplaySettings const& settings, FrameCaptureFile capture)
+        : m_settings(settings)
+        , m_capture(std::move(capture))
+    {
+    }
+
+    ~FrameReplay()
+    {
+        uninitialize();
+    }
+
+    std::string deviceName() const
+    {
+        return m_deviceName;
+    }
+
+    void initialize()
+    {
+        createInstance();
+        selectPhysicalDevice();
+        createLogicalDevice();
+        createRenderTarget();
+        createRenderPass();
+        createFramebuffer();
+        createPipelines();
+        createCommandPool();
+        createSyncObjects();
+        createQueryPool();
+        createReadbackBuffer();
+    }
+
+    ReplayResult run()
+    {
+        ReplayResult result;
+        result.iterations = m_settings.iterations;
+
+        recordFrame(result);
+
+        // The first submissions may still pay for lazy initialization in the driver
+        for (uint32_t i = 0; i < WARMUP_ITERATIONS; ++i)
+        {
+            submitFrame();
+        }
+        result.firstImageHash = readbackImageHash();
+
+        for (uint32_t i = 0; i < m_settings.iterations; ++i)
+        {
+            result.cpuFrameTimes.push_back(submitFrame());
+
+            // A failed read is skipped, a zero would pull the percentiles down
+            auto gpuFrameTime = m_timestampsSupported ? readGpuFrameTime() : std::nullopt;
+            if (gpuFrameTime)
+            {
+                result.gpuFrameTimes.push_back(gpuFrameTime.value());
+            }
+        }
+        result.lastImageHash = readbackImageHash();
+
+        return result;
+    }
+
+private:
+    void createInstance()
+    {
+        vk::ApplicationInfo applicationInfo;
+        applicationInfo.pApplicationName   = "Drawing Triangle Replay";
+        applicationInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+        applicationInfo.apiVersion         = VK_API_VERSION_1_2;
+
+        vk::InstanceCreateInfo instanceCreateInfo;
+        instanceCreateInfo.pApplicationInfo = &applicationInfo;
+
+        m_instance = vk::createInstance(instanceCreateInfo);
+    }
+
+    std::optional<uint32_t> findGraphicsQueueFamily(vk::PhysicalDevice const& device)
+    {
+        auto familyProperties = device.getQueueFamilyProperties();
+
+        for (uint32_t i = 0; i < familyProperties.size(); ++i)
+        {
+            if (familyProperties[i].queueCount > 0 && familyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics)
+            {
+                return i;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    bool isDeviceSuitable(vk::PhysicalDevice const& device)
+    {
+        if (!findGraphicsQueueFamily(device))
+        {
+            return false;
+        }
+
+        // The captured format has to be renderable and copyable
+        auto formatProperties = device.getFormatProperties(m_capture.format);
+        auto required         = vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eTransferSrc;
+        return (formatProperties.optimalTilingFeatures & required) == required;
+    }
+
+    void selectPhysicalDevice()
+    {
+        auto ranking = rankPhysicalDevices(m_instance, [this](auto const& d) { return isDeviceSuitable(d); });
+
+        if (ranking.empty())
+        {
+            throw std::runtime_error("failed to find GPUs with Vulkan support");
+        }
+
+        // The report goes to stdout, so the ranking is logged to stderr
+        auto selected = findDevice(ranking, m_settings.device);
+        logDeviceRanking(std::cerr, ranking, selected);
+
+        if (selected == nullptr)
+        {
+            throw std::runtime_error(m_settings.device ? "requested device '" + m_settings.device.value() + "' is not available or not suitable"
+                                                       : std::string("failed to find a suitable GPU!"));
+        }
+
+        m_physicalDevice = selected->device;
+
+        auto properties   = m_physicalDevice.getProperties();
+        m_deviceName      = properties.deviceName.data();
+        m_timestampPeriod = properties.limits.timestampPeriod;
+    }
+
+    void createLogicalDevice()
+    {
+        m_queueFamily = findGraphicsQueueFamily(m_physicalDevice).value();
+
+        float                     priority = 1.0f;
+        vk::DeviceQueueCreateInfo queueCreateInfo;
+        queueCreateInfo.queueFamilyIndex = m_queueFamily;
+        queueCreateInfo.queueCount       = 1U;
+        queueCreateInfo.pQueuePriorities = &priority;
+
+        vk::DeviceCreateInfo createInfo;
+        createInfo.pQueueCreateInfos    = &queueCreateInfo;
+        createInfo.queueCreateInfoCount = 1U;
+
+        m_device = m_physicalDevice.createDevice(createInfo);
+        m_queue  = m_device.getQueue(m_queueFamily, 0U);
+
+        m_pipelineLayoutCache.setDevice(m_device);
+
+        auto timestampValidBits = m_physicalDevice.getQueueFamilyProperties()[m_queueFamily].timestampValidBits;
+        m_timestampsSupported   = timestampValidBits > 0;
+        if (!m_timestampsSupported)
+        {
+            std::cerr << "timestamps not supported, GPU frame times will not be reported." << std::endl;
+        }
+    }
+
+    // Stands in for the swap chain image the frame was rendered to
+    void createRenderTarget()
+    {
+        vk::ImageCreateInfo imageInfo;
+        imageInfo.imageType     = vk::ImageType::e2D;
+        imageInfo.format        = m_capture.format;
+        imageInfo.extent        = vk::Extent3D(m_capture.extent.width, m_capture.extent.height, 1);
+        imageInfo.mipLevels     = 1;
+        imageInfo.arrayLayers   = 1;
+        imageInfo.samples       = vk::SampleCountFlagBits::e1;
+        imageInfo.tiling        = vk::ImageTiling::eOptimal;
+        imageInfo.usage         = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+        imageInfo.sharingMode   = vk::SharingMode::eExclusive;
+        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+        m_renderTarget = m_device.createImage(imageInfo);
+
+        auto                   memoryRequirements = m_device.getImageMemoryRequirements(m_renderTarget);
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        m_renderTargetMemory = m_device.allocateMemory(allocInfo);
+        m_device.bindImageMemory(m_renderTarget, m_renderTargetMemory, 0);
+
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.image                           = m_renderTarget;
+        viewInfo.format                          = m_capture.format;
+        viewInfo.viewType                        = vk::ImageViewType::e2D;
+        viewInfo.subresourceRange.aspectMask     = vk::ImageAspectFlagBits::eColor;
+        viewInfo.subresourceRange.baseMipLevel   = 0U;
+        viewInfo.subresourceRange.levelCount     = 1U;
+        viewInfo.subresourceRange.baseArrayLayer = 0U;
+        viewInfo.subresourceRange.layerCount     = 1U;
+
+        m_renderTargetView = m_device.createImageView(viewInfo);
+    }
+
+    // Same as the render pass of the sample, except that the image ends up ready for the readback instead of presenting
+    void createRenderPass()
+    {
+        vk::AttachmentDescription colorAttachment;
+        colorAttachment.format         = m_capture.format;
+        colorAttachment.samples        = vk::SampleCountFlagBits::e1;
+        colorAttachment.loadOp         = vk::AttachmentLoadOp::eClear;
+        colorAttachment.storeOp        = vk::AttachmentStoreOp::eStore;
+        colorAttachment.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
+        colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        colorAttachment.initialLayout  = vk::ImageLayout::eUndefined;
+        colorAttachment.finalLayout    = vk::ImageLayout::eTransferSrcOptimal;
+
+        vk::AttachmentReference colorAttachmentRef;
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout     = vk::ImageLayout::eColorAttachmentOptimal;
+
+        vk::SubpassDescription subpass;
+        subpass.pipelineBindPoint    = vk::PipelineBindPoint::eGraphics;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments    = &colorAttachmentRef;
+
+        // Every iteration renders to the same image, so the iterations (and the readback) have to be ordered
+        vk::SubpassDependency dependencies[2];
+        dependencies[0].srcSubpass    = VK_SUBPASS_EXTERNAL;
+        dependencies[0].srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer;
+        dependencies[0].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eTransferRead;
+        dependencies[0].dstSubpass    = 0;
+        dependencies[0].dstStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+
+        dependencies[1].srcSubpass    = 0;
+        dependencies[1].srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        dependencies[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
+        dependencies[1].dstStageMask  = vk::PipelineStageFlagBits::eTransfer;
+        dependencies[1].dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+        vk::RenderPassCreateInfo renderPassInfo;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments    = &colorAttachment;
+        renderPassInfo.subpassCount    = 1;
+        renderPassInfo.pSubpasses      = &subpass;
+        renderPassInfo.dependencyCount = 2;
+        renderPassInfo.pDependencies   = dependencies;
+
+        m_renderPass = m_device.createRenderPass(renderPassInfo);
+    }
+
+    void createFramebuffer()
+    {
+        vk::FramebufferCreateInfo framebufferInfo;
+        framebufferInfo.renderPass      = m_renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments    = &m_renderTargetView;
+        framebufferInfo.width           = m_capture.extent.width;
+        framebufferInfo.height          = m_capture.extent.height;
+        framebufferInfo.layers          = 1;
+
+        m_framebuffer = m_device.createFramebuffer(framebufferInfo);
+    }
+
+    vk::ShaderModule createShaderModule(std::vector<char> const& code)
+    {
+        vk::ShaderModuleCreateInfo createInfo;
+        createInfo.codeSize = code.size();
+        createInfo.pCode    = reinterpret_cast<const uint32_t*>(code.data());
+
+        return m_device.createShaderModule(createInfo);
+    }
+
+    void createPipelines()
+    {
+        for (auto const& [id, captured] : m_capture.pipelines)
+        {
+            auto vertReflection = reflectShader(captured.vertexShader);
+            auto fragReflection = reflectShader(captured.fragmentShader);
+
+            vk::PipelineLayout pipelineLayout = m_pipelineLayoutCache.getPipelineLayout({vertReflection, fragReflection});
+
+            auto vertShaderModule = createShaderModule(captured.vertexShader);
+            auto fragShaderModule = createShaderModule(captured.fragmentShader);
+
+            vk::PipelineShaderStageCreateInfo shaderStages[2];
+            shaderStages[0].stage  = vk::ShaderStageFlagBits::eVertex;
+            shaderStages[0].module = vertShaderModule;
+            shaderStages[0].pName  = "main";
+            shaderStages[1].stage  = vk::ShaderStageFlagBits::eFragment;
+            shaderStages[1].module = fragShaderModule;
+            shaderStages[1].pName  = "main";
+
+            VertexInputLayout                      vertexInputLayout(vertReflection);
+            vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vertexInputLayout.createInfo();
+
+            vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+            inputAssembly.topology = captured.topology;
+
+            vk::Viewport viewport(0.f, 0.f, static_cast<float>(m_capture.extent.width), static_cast<float>(m_capture.extent.height), 0.f, 1.f);
+            vk::Rect2D   scissor({0, 0}, m_capture.extent);
+
+            vk::PipelineViewportStateCreateInfo viewportState;
+            viewportState.viewportCount = 1;
+            viewportState.pViewports    = &viewport;
+            viewportState.scissorCount  = 1;
+            viewportState.pScissors     = &scissor;
+
+            vk::PipelineRasterizationStateCreateInfo rasterizer;
+            rasterizer.polygonMode = captured.polygonMode;
+            rasterizer.lineWidth   = 1.f;
+            rasterizer.cullMode    = captured.cullMode;
+            rasterizer.frontFace   = captured.frontFace;
+
+            vk::PipelineMultisampleStateCreateInfo multisampling;
+            multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+            vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+            colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+
+            vk::PipelineColorBlendStateCreateInfo colorBlending;
+            colorBlending.attachmentCount = 1;
+            colorBlending.pAttachments    = &colorBlendAttachment;
+
+            vk::GraphicsPipelineCreateInfo pipelineInfo;
+            pipelineInfo.stageCount          = 2;
+            pipelineInfo.pStages             = shaderStages;
+            pipelineInfo.pVertexInputState   = &vertexInputInfo;
+            pipelineInfo.pInputAssemblyState = &inputAssembly;
+            pipelineInfo.pViewportState      = &viewportState;
+            pipelineInfo.pRasterizationState = &rasterizer;
+            pipelineInfo.pMultisampleState   = &multisampling;
+            pipelineInfo.pColorBlendState    = &colorBlending;
+            pipelineInfo.layout              = pipelineLayout;
+            pipelineInfo.renderPass          = m_renderPass;
+            pipelineInfo.subpass             = 0;
+
+            m_pipelines[id] = m_device.createGraphicsPipelines(vk::PipelineCache(), {pipelineInfo}).value[0];
+
+            m_device.destroyShaderModule(vertShaderModule);
+            m_device.destroyShaderModule(fragShaderModule);
+        }
+    }
+
+    void createCommandPool()
+    {
+        vk::CommandPoolCreateInfo poolInfo;
+        poolInfo.queueFamilyIndex = m_queueFamily;
+        poolInfo.flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+
+        m_commandPool = m_device.createCommandPool(poolInfo);
+
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.commandPool        = m_commandPool;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = 1;
+
+        m_commandBuffer = m_device.allocateCommandBuffers(allocInfo)[0];
+    }
+
+    void createSyncObjects()
+    {
+        m_fence = m_device.createFence(vk::FenceCreateInfo());
+    }
+
+    void createQueryPool()
+    {
+        if (!m_timestampsSupported)
+        {
+            return;
+        }
+
+        // Begin and end of the frame
+        vk::QueryPoolCreateInfo queryPoolInfo;
+        queryPoolInfo.queryType  = vk::QueryType::eTimestamp;
+        queryPoolInfo.queryCount = 2;
+
+        m_queryPool = m_device.createQueryPool(queryPoolInfo);
+    }
+
+    void createReadbackBuffer()
+    {
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.size        = readbackSize();
+        bufferInfo.usage       = vk::BufferUsageFlagBits::eTransferDst;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+        m_readbackBuffer = m_device.createBuffer(bufferInfo);
+
+        auto                   memoryRequirements = m_device.getBufferMemoryRequirements(m_readbackBuffer);
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+        m_readbackMemory = m_device.allocateMemory(allocInfo);
+        m_device.bindBufferMemory(m_readbackBuffer, m_readbackMemory, 0);
+    }
+
+    size_t readbackSize() const
+    {
+        return static_cast<size_t>(m_capture.extent.width) * m_capture.extent.height * formatSize(m_capture.format);
+    }
+
+    // Translate the captured commands into a command buffer, which is then submitted for every iteration
+    void recordFrame(ReplayResult& result)
+    {
+        m_commandBuffer.begin(vk::CommandBufferBeginInfo());
+
+        if (m_timestampsSupported)
+        {
+            m_commandBuffer.resetQueryPool(m_queryPool, 0, 2);
+            m_commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool, 0);
+        }
+
+        uint32_t renderPasses = 0;
+
+        CaptureStream commands = m_capture.commands;
+        while (!commands.atEnd())
+        {
+            auto command = commands.read<CaptureCommand>();
+            ++result.commands;
+
+            switch (command)
+            {
+            case CaptureCommand::BeginRenderPass:
+            {
+                vk::ClearValue clearColor(vk::ClearColorValue(commands.read<std::array<float, 4>>()));
+
+                vk::RenderPassBeginInfo renderPassInfo;
+                renderPassInfo.renderPass        = m_renderPass;
+                renderPassInfo.framebuffer       = m_framebuffer;
+                renderPassInfo.renderArea.offset = vk::Offset2D(0, 0);
+                renderPassInfo.renderArea.extent = m_capture.extent;
+                renderPassInfo.clearValueCount   = 1;
+                renderPassInfo.pClearValues      = &clearColor;
+
+                // Secondary command buffers were inlined by the capture
+                m_commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+                break;
+            }
+            case CaptureCommand::EndRenderPass:
+                m_commandBuffer.endRenderPass();
+                ++renderPasses;
+                break;
+            case CaptureCommand::BindPipeline:
+            {
+                auto pipeline = m_pipelines.find(commands.read<uint32_t>());
+                if (pipeline == std::end(m_pipelines))
+                {
+                    throw std::runtime_error("capture binds a pipeline it doesn't contain");
+                }
+                m_commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->second);
+                break;
+            }
+            case CaptureCommand::Draw:
+            {
+                auto draw = commands.read<std::array<uint32_t, 4>>();
+                m_commandBuffer.draw(draw[0], draw[1], draw[2], draw[3]);
+                ++result.draws;
+                break;
+            }
+            default:
+                throw std::runtime_error("unknown command " + std::to_string(static_cast<uint32_t>(command)) + " in capture");
+            }
+        }
+
+        // The render pass moves the render target out of the undefined layout, the readback relies on that
+        if (renderPasses == 0)
+        {
+            throw std::runtime_error("capture doesn't render into its render target");
+        }
+
+        if (m_timestampsSupported)
+        {
+            m_commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 1);
+        }
+
+        m_commandBuffer.end();
+    }
+
+    // Returns the time from submission until the host sees the fence in milliseconds
+    double submitFrame()
+    {
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers    = &m_commandBuffer;
+
+        auto start = Clock::now();
+        m_queue.submit({submitInfo}, m_fence);
+        if (m_device.waitForFences({m_fence}, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+        {
+            throw std::runtime_error("failed to wait for fence");
+        }
+        auto end = Clock::now();
+
+        m_device.resetFences({m_fence});
+
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    std::optional<double> readGpuFrameTime()
+    {
+        uint64_t timestamps[2] = {};
+        auto     result        = m_device.getQueryPoolResults(m_queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess)
+        {
+            return std::nullopt;
+        }
+
+        return (timestamps[1] - timestamps[0]) * m_timestampPeriod / 1e6;
+    }
+
+    // Copy the render target into the readback buffer and hash its contents
+    uint64_t readbackImageHash()
+    {
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.commandPool        = m_commandPool;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = 1;
+
+        vk::CommandBuffer commandBuffer = m_device.allocateCommandBuffers(allocInfo)[0];
+
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        commandBuffer.begin(beginInfo);
+
+        vk::BufferImageCopy region;
+        region.bufferOffset                    = 0;
+        region.bufferRowLength                 = 0; // Tightly packed
+        region.bufferImageHeight               = 0;
+        region.imageSubresource.aspectMask     = vk::ImageAspectFlagBits::eColor;
+        region.imageSubresource.mipLevel       = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount     = 1;
+        region.imageOffset                     = vk::Offset3D(0, 0, 0);
+        region.imageExtent                     = vk::Extent3D(m_capture.extent.width, m_capture.extent.height, 1);
+
+        commandBuffer.copyImageToBuffer(m_renderTarget, vk::ImageLayout::eTransferSrcOptimal, m_readbackBuffer, region);
+
+        // Make the transfer visible to the host
+        vk::BufferMemoryBarrier barrier;
+        barrier.srcAccessMask       = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask       = vk::AccessFlagBits::eHostRead;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer              = m_readbackBuffer;
+        barrier.offset              = 0;
+        barrier.size                = VK_WHOLE_SIZE;
+
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), nullptr, barrier, nullptr);
+        commandBuffer.end();
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers    = &commandBuffer;
+
+        m_queue.submit({submitInfo}, m_fence);
+        if (m_device.waitForFences({m_fence}, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+        {
+            throw std::runtime_error("failed to wait for fence");
+        }
+        m_device.resetFences({m_fence});
+        m_device.freeCommandBuffers(m_commandPool, commandBuffer);
+
+        size_t   size = readbackSize();
+        auto*    data = static_cast<uint8_t const*>(m_device.mapMemory(m_readbackMemory, 0, size));
+        uint64_t hash = hashBytes(data, size);
+        m_device.unmapMemory(m_readbackMemory);
+
+        return hash;
+    }
+
+    void uninitialize()
+    {
+        if (!m_device)
+        {
+            return;
+        }
+
+        m_device.waitIdle();
+
+        for (auto const& entry : m_pipelines)
+        {
+            m_device.destroyPipeline(entry.second);
+        }
+        m_pipelineLayoutCache.destroy();
+
+        m_device.destroyBuffer(m_readbackBuffer);
+        m_device.freeMemory(m_readbackMemory);
+        if (m_queryPool)
+        {
+            m_device.destroyQueryPool(m_queryPool);
+        }
+        m_device.destroyFence(m_fence);
+        m_device.destroyCommandPool(m_commandPool);
+        m_device.destroyFramebuffer(m_framebuffer);
+        m_device.destroyRenderPass(m_renderPass);
+        m_device.destroyImageView(m_renderTargetView);
+        m_device.destroyImage(m_renderTarget);
+        m_device.freeMemory(m_renderTargetMemory);
+        m_device.destroy();
+        m_device = vk::Device();
+
+        m_instance.destroy();
+    }
+
+    ReplaySettings                   m_settings;
+    FrameCaptureFile                 m_capture;
+    vk::Instance                     m_instance;
+    vk::PhysicalDevice               m_physicalDevice;
+    std::string                      m_deviceName;
+    float                            m_timestampPeriod     = 1.f; // Nanoseconds per timestamp tick
+    bool                             m_timestampsSupported = false;
+    uint32_t                         m_queueFamily         = 0;
+    vk::Device                       m_device;
+    vk::Queue                        m_queue;
+    vk::Image                        m_renderTarget;
+    vk::DeviceMemory                 m_renderTargetMemory;
+    vk::ImageView                    m_renderTargetView;
+    vk::RenderPass                   m_renderPass;
+    vk::Framebuffer                  m_framebuffer;
+    PipelineLayoutCache              m_pipelineLayoutCache;
+    std::map<uint32_t, vk::Pipeline> m_pipelines; // By captured id
+    vk::CommandPool                  m_commandPool;
+    vk::CommandBuffer                m_commandBuffer;
+    vk::Fence                        m_fence;
+    vk::QueryPool                    m_queryPool;
+    vk::Buffer                       m_readbackBuffer;
+    vk::DeviceMemory                 m_readbackMemory;
+};
+
+static void writeReport(std::ostream& stream, std::string const& capturePath, FrameCaptureFile const& capture, std::string const& deviceName, ReplayResult const& result)
+{
+    JsonWriter json(stream);
+    json.beginObject();
+    json.field("capture", capturePath);
+    json.field("device", deviceName);
+    json.field("format", vk::to_string(capture.format));
+    json.field("width", capture.extent.width);
+    json.field("height", capture.extent.height);
+    json.field("pipelines", capture.pipelines.size());
+    json.field("commands", result.commands);
+    json.field("draws", result.draws);
+    json.field("iterations", result.iterations);
+    writeSeries(json, "cpu_frame_time_ms", result.cpuFrameTimes);
+    writeSeries(json, "gpu_frame_time_ms", result.gpuFrameTimes);
+    json.field("image_hash", formatHex(result.lastImageHash));
+    // The same commands on the same device have to produce the same image every time
+    json.field("deterministic", result.firstImageHash == result.lastImageHash);
+    json.endObject();
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        ReplaySettings   settings = parseCommandLine(argc, argv);
+        FrameCaptureFile capture  = loadFrameCapture(settings.capturePath);
+
+        FrameReplay replay(settings, capture);
+        replay.initialize();
+
+        std::cerr << "replaying '" << settings.capturePath << "' " << settings.iterations << " times..." << std::endl;
+        ReplayResult result = replay.run();
+
+        if (settings.outputPath.empty())
+        {
+            writeReport(std::cout, settings.capturePath, capture, replay.deviceName(), result);
+        }
+        else
+        {
+            std::ofstream output(settings.outputPath);
+            if (!output.is_open())
+            {
+                throw std::runtime_error("failed to open output file '" + settings.outputPath + "'");
+            }
+            writeReport(output, settings.capturePath, capture, replay.deviceName(), result);
+        }
+
+        if (result.firstImageHash != result.lastImageHash)
+        {
+            std::cerr << "replay is not deterministic, the image changed between iterations" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
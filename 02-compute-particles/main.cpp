@@ -0,0 +1,2043 @@
+#include <vulkan/vulkan.hpp>
+
+#include <GLFW/glfw3.h>
+
+#include <common/command-line.hpp>
+#include <common/debug-messenger.hpp>
+#include <common/device-selection.hpp>
+#include <common/spirv-reflection.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+constexpr int      WINDOW_WIDTH           = 800;
+constexpr int      WINDOW_HEIGHT          = 600;
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT   = 2;
+constexpr uint32_t DEFAULT_PARTICLE_COUNT = 1U << 21;
+constexpr uint32_t SIMULATION_GROUP_SIZE  = 256; // Has to match numthreads in the compute shader
+constexpr uint32_t TIMESTAMPS_PER_FRAME   = 4;   // Compute begin/end, graphics begin/end
+
+using Clock = std::chrono::steady_clock;
+
+struct ApplicationSettings
+{
+    uint32_t particleCount = DEFAULT_PARTICLE_COUNT;
+    // Run the simulation on a separate compute queue, overlapping the rendering of the previous frame.
+    bool asyncCompute = false;
+    // Index, UUID or part of the name of the device to use. The best ranked device if not set.
+    std::optional<std::string> device;
+    // Run the simulation on a second device and upload its results for rendering. Selected like
+    // the primary device, or the best ranked other device if no selector is given.
+    bool                       secondaryDevice = false;
+    std::optional<std::string> secondaryDeviceSelector;
+    // Filter and rate limit of the validation layer messages, only used in debug builds
+    DebugMessengerSettings debugMessages;
+};
+
+static ApplicationSettings parseCommandLine(int argc, char** argv)
+{
+    ApplicationSettings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+
+        auto nextValue = [&]() -> std::string {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("missing value for option '" + option + "'");
+            }
+            return argv[++i];
+        };
+
+        if (option == "--particles")
+        {
+            // The device limits are checked once the device is selected, the upper bound here
+            // only keeps the rounded up group count from overflowing
+            settings.particleCount = parseCount(option, nextValue(), 1U, UINT32_MAX - (SIMULATION_GROUP_SIZE - 1));
+        }
+        else if (option == "--async-compute")
+        {
+            settings.asyncCompute = true;
+        }
+        else if (option == "--device")
+        {
+            settings.device = nextValue();
+        }
+        else if (option == "--secondary-device")
+        {
+            settings.secondaryDevice = true;
+
+            auto selector = nextValue();
+            if (selector != "auto")
+            {
+                settings.secondaryDeviceSelector = selector;
+            }
+        }
+        else if (option == "--debug-severity")
+        {
+            settings.debugMessages.minimumSeverity = parseDebugSeverity(nextValue());
+        }
+        else if (option == "--debug-types")
+        {
+            settings.debugMessages.types = parseDebugTypes(nextValue());
+        }
+        else if (option == "--debug-rate")
+        {
+            settings.debugMessages.messagesPerInterval = parseCount(option, nextValue(), 1U, 1000U);
+        }
+        else
+        {
+            throw std::runtime_error("unknown option '" + option + "'");
+        }
+    }
+
+    if (settings.asyncCompute && settings.secondaryDevice)
+    {
+        throw std::runtime_error("'--async-compute' and '--secondary-device' can't be combined");
+    }
+
+    return settings;
+}
+
+static std::vector<char> readFile(std::string const& filename)
+{
+    std::ifstream file(filename, std::ios_base::ate | std::ios_base::binary);
+
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open file '" + filename + "'");
+    }
+
+    size_t            fileSize = static_cast<size_t>(file.tellg());
+    std::vector<char> buffer(fileSize);
+
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+
+    return buffer;
+}
+
+// Descriptor set layout bindings of one set, as declared by the shader
+static std::vector<vk::DescriptorSetLayoutBinding> reflectedSetBindings(ShaderReflection const& reflection, uint32_t set)
+{
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    for (auto const& binding : reflection.descriptorBindings)
+    {
+        if (binding.set == set)
+        {
+            bindings.push_back(vk::DescriptorSetLayoutBinding(binding.binding, binding.type, binding.count, binding.stages));
+        }
+    }
+
+    std::sort(std::begin(bindings), std::end(bindings), [](auto const& a, auto const& b) { return a.binding < b.binding; });
+    return bindings;
+}
+
+// Matches the particle struct in the shaders
+struct Particle
+{
+    float position[2];
+    float velocity[2];
+};
+
+// Particles on a disc, circling around the center
+static std::vector<Particle> createInitialParticles(uint32_t particleCount)
+{
+    std::vector<Particle>                 particles(particleCount);
+    std::mt19937                          random(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (auto& particle : particles)
+    {
+        float radius = 0.9f * std::sqrt(unit(random));
+        float angle  = 2.0f * 3.14159265f * unit(random);
+        float speed  = 0.2f + 0.1f * unit(random);
+
+        particle = {{radius * std::cos(angle), radius * std::sin(angle)}, {-speed * std::sin(angle), speed * std::cos(angle)}};
+    }
+
+    return particles;
+}
+
+// Matches the push constants of the simulation shader
+struct SimulationConstants
+{
+    float    attractor[2];
+    float    deltaTime;
+    uint32_t particleCount;
+};
+
+struct QueueFamilyIndices
+{
+    std::optional<uint32_t> graphicsFamily;
+    std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> computeFamily; // Prefers a family without graphics support
+
+    bool isComplete()
+    {
+        return graphicsFamily.has_value() &&
+               presentFamily.has_value() &&
+               computeFamily.has_value();
+    }
+};
+
+struct SwapChainSupportDetails
+{
+    vk::SurfaceCapabilitiesKHR        capabilities;
+    std::vector<vk::SurfaceFormatKHR> formats;
+    std::vector<vk::PresentModeKHR>   presentModes;
+};
+
+// GPU timestamps of one frame in milliseconds, relative to an arbitrary origin
+struct FrameTimestamps
+{
+    double computeBegin  = 0.0;
+    double computeEnd    = 0.0;
+    double graphicsBegin = 0.0;
+    double graphicsEnd   = 0.0;
+};
+
+// Accumulates simulation throughput and the overlap of the simulation
+// with the rendering of the previous frame.
+//
+// With a secondary device, the compute timestamps of the primary device bracket the upload of
+// the simulation results instead. The simulation times of the secondary device are added on their
+// own, they have a different time base and can't be compared with the rendering.
+class SimulationStatistics
+{
+public:
+    void enableSecondaryDevice()
+    {
+        m_secondaryDevice = true;
+    }
+
+    void addFrame(FrameTimestamps const& frame, std::optional<FrameTimestamps> const& previousFrame)
+    {
+        m_computeTime += frame.computeEnd - frame.computeBegin;
+        m_graphicsTime += frame.graphicsEnd - frame.graphicsBegin;
+        ++m_frames;
+
+        if (previousFrame && !m_secondaryDevice)
+        {
+            double overlapBegin = std::max(frame.computeBegin, previousFrame->graphicsBegin);
+            double overlapEnd   = std::min(frame.computeEnd, previousFrame->graphicsEnd);
+            m_overlapTime += std::max(0.0, overlapEnd - overlapBegin);
+        }
+    }
+
+    void addSecondarySimulation(double simulationTime)
+    {
+        m_secondaryTime += simulationTime;
+        ++m_secondaryFrames;
+    }
+
+    void report(std::ostream& stream, uint32_t particleCount, uint64_t frameCount, double seconds) const
+    {
+        stream << std::fixed << std::setprecision(3);
+        stream << "simulated " << frameCount << " frames of " << particleCount << " particles in " << seconds << " s" << std::endl;
+        stream << "  throughput: " << particleCount * (frameCount / seconds) / 1e6 << " M particles/s" << std::endl;
+
+        if (m_secondaryFrames > 0)
+        {
+            double secondaryTime = m_secondaryTime / m_secondaryFrames;
+
+            stream << "  gpu simulation on the secondary device: " << secondaryTime << " ms (" << particleCount / secondaryTime / 1e3 << " M particles/s)" << std::endl;
+        }
+
+        if (m_frames > 0)
+        {
+            double computeTime  = m_computeTime / m_frames;
+            double graphicsTime = m_graphicsTime / m_frames;
+            double overlapTime  = m_overlapTime / m_frames;
+
+            if (m_secondaryDevice)
+            {
+                stream << "  gpu upload of the simulation results: " << computeTime << " ms" << std::endl;
+                stream << "  gpu rendering: " << graphicsTime << " ms" << std::endl;
+            }
+            else
+            {
+                stream << "  gpu simulation: " << computeTime << " ms (" << particleCount / computeTime / 1e3 << " M particles/s)" << std::endl;
+                stream << "  gpu rendering: " << graphicsTime << " ms" << std::endl;
+                stream << "  overlap with previous frame's rendering: " << overlapTime << " ms ("
+                       << (computeTime > 0.0 ? 100.0 * overlapTime / computeTime : 0.0) << " % of simulation)" << std::endl;
+            }
+        }
+
+        stream << std::defaultfloat;
+    }
+
+private:
+    bool     m_secondaryDevice = false;
+    double   m_computeTime     = 0.0;
+    double   m_graphicsTime    = 0.0;
+    double   m_overlapTime     = 0.0;
+    uint64_t m_frames          = 0;
+    double   m_secondaryTime   = 0.0;
+    uint64_t m_secondaryFrames = 0;
+};
+
+// The simulation on a second device, e.g. a discrete GPU next to the integrated one driving the display.
+//
+// The particles stay on the secondary device. Every simulation also copies its result into host
+// visible memory, from where the application uploads it to the primary device for rendering.
+// Frame n renders the result of simulation n - 1, so simulation n runs on the secondary device
+// while the primary device renders frame n. The particles are copied twice per frame (into and out
+// of host memory), which only pays off if the simulation costs more than the copies.
+class SecondarySimulation
+{
+public:
+    // The compute family of a device, preferring one without graphics, which is less likely to be busy with other work
+    static std::optional<uint32_t> findComputeQueueFamily(vk::PhysicalDevice const& device)
+    {
+        auto familyProperties = device.getQueueFamilyProperties();
+
+        std::optional<uint32_t> family;
+        for (uint32_t i = 0; i < familyProperties.size(); ++i)
+        {
+            if (familyProperties[i].queueCount > 0 && familyProperties[i].queueFlags & vk::QueueFlagBits::eCompute)
+            {
+                if (!(familyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics))
+                {
+                    return i;
+                }
+                if (!family)
+                {
+                    family = i;
+                }
+            }
+        }
+
+        return family;
+    }
+
+    void create(vk::PhysicalDevice physicalDevice, std::vector<char> const& compShaderCode, std::vector<Particle> const& initialParticles)
+    {
+        m_physicalDevice = physicalDevice;
+        m_particleCount  = static_cast<uint32_t>(initialParticles.size());
+        m_size           = sizeof(Particle) * initialParticles.size();
+
+        createDevice();
+        createPipeline(compShaderCode);
+        createBuffers(initialParticles);
+        createDescriptorSets();
+        createSyncObjects();
+    }
+
+    // Waits for the simulation of the previous frame and copies its result, or the initial state
+    // in the first frame. Has to be called before submit() of the same frame.
+    void readResult(uint64_t frame, void* destination)
+    {
+        vk::SemaphoreWaitInfo waitInfo;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores    = &m_timeline;
+        waitInfo.pValues        = &frame;
+        m_device.waitSemaphores(waitInfo, UINT64_MAX);
+
+        std::memcpy(destination, m_readbackData + ((frame + 1) % 2) * m_size, m_size);
+    }
+
+    // GPU time of a finished simulation in milliseconds
+    std::optional<double> simulationTime(uint64_t simulation)
+    {
+        if (!m_queryPool)
+        {
+            return std::nullopt;
+        }
+
+        uint64_t timestamps[2] = {};
+        auto     result        = m_device.getQueryPoolResults(m_queryPool, static_cast<uint32_t>(simulation % 2) * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess)
+        {
+            return std::nullopt;
+        }
+
+        return (timestamps[1] - timestamps[0]) * static_cast<double>(m_timestampPeriod) / 1e6;
+    }
+
+    // Simulation n reads buffer n % 2, writes the other one and copies it into readback slot n % 2
+    void submit(uint64_t frame, SimulationConstants const& constants)
+    {
+        uint32_t source  = static_cast<uint32_t>(frame % 2);
+        auto     command = m_commandBuffers[source];
+
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        command.begin(beginInfo);
+
+        if (m_queryPool)
+        {
+            command.resetQueryPool(m_queryPool, source * 2, 2);
+            command.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool, source * 2);
+        }
+
+        command.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+        command.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, {m_descriptorSets[source]}, {});
+        command.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+        command.dispatch((m_particleCount + SIMULATION_GROUP_SIZE - 1) / SIMULATION_GROUP_SIZE, 1, 1);
+
+        vk::MemoryBarrier simulationDone;
+        simulationDone.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        simulationDone.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+        command.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, {simulationDone}, {}, {});
+
+        command.copyBuffer(m_particleBuffers[1 - source], m_readbackBuffer, {vk::BufferCopy(0, source * m_size, m_size)});
+
+        vk::MemoryBarrier copyDone;
+        copyDone.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        copyDone.dstAccessMask = vk::AccessFlagBits::eHostRead;
+        command.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, {copyDone}, {}, {});
+
+        if (m_queryPool)
+        {
+            command.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, source * 2 + 1);
+        }
+
+        command.end();
+
+        // Simulation n - 1 (value n) wrote the buffer read here and read the buffer written here
+        uint64_t               waitValue   = frame;
+        uint64_t               signalValue = frame + 1;
+        vk::PipelineStageFlags waitStage   = vk::PipelineStageFlagBits::eAllCommands;
+
+        vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo;
+        timelineSubmitInfo.waitSemaphoreValueCount   = 1;
+        timelineSubmitInfo.pWaitSemaphoreValues      = &waitValue;
+        timelineSubmitInfo.signalSemaphoreValueCount = 1;
+        timelineSubmitInfo.pSignalSemaphoreValues    = &signalValue;
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.pNext                = &timelineSubmitInfo;
+        submitInfo.waitSemaphoreCount   = 1;
+        submitInfo.pWaitSemaphores      = &m_timeline;
+        submitInfo.pWaitDstStageMask    = &waitStage;
+        submitInfo.commandBufferCount   = 1;
+        submitInfo.pCommandBuffers      = &command;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores    = &m_timeline;
+
+        m_queue.submit({submitInfo}, vk::Fence());
+    }
+
+    void destroy()
+    {
+        if (!m_device)
+        {
+            return;
+        }
+
+        m_device.waitIdle();
+
+        m_device.destroySemaphore(m_timeline);
+        if (m_queryPool)
+        {
+            m_device.destroyQueryPool(m_queryPool);
+        }
+
+        m_device.destroyDescriptorPool(m_descriptorPool);
+
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            m_device.destroyBuffer(m_particleBuffers[i]);
+            m_device.freeMemory(m_particleMemories[i]);
+        }
+        m_device.destroyBuffer(m_readbackBuffer);
+        m_device.freeMemory(m_readbackMemory);
+
+        m_device.destroyCommandPool(m_commandPool);
+        m_device.destroyPipeline(m_pipeline);
+        m_layoutCache.destroy();
+        m_device.destroy();
+        m_device = vk::Device();
+    }
+
+private:
+    void createDevice()
+    {
+        m_computeFamily = findComputeQueueFamily(m_physicalDevice).value();
+
+        float                     queuePriority = 1.0f;
+        vk::DeviceQueueCreateInfo queueCreateInfo;
+        queueCreateInfo.queueFamilyIndex = m_computeFamily;
+        queueCreateInfo.queueCount       = 1U;
+        queueCreateInfo.pQueuePriorities = &queuePriority;
+
+        vk::PhysicalDeviceVulkan12Features vulkan12Features;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+
+        vk::PhysicalDeviceFeatures2 deviceFeatures;
+        deviceFeatures.pNext = &vulkan12Features;
+
+        vk::DeviceCreateInfo createInfo;
+        createInfo.pNext                = &deviceFeatures;
+        createInfo.pQueueCreateInfos    = &queueCreateInfo;
+        createInfo.queueCreateInfoCount = 1U;
+
+        m_device = m_physicalDevice.createDevice(createInfo);
+        m_queue  = m_device.getQueue(m_computeFamily, 0U);
+        m_layoutCache.setDevice(m_device);
+
+        vk::CommandPoolCreateInfo poolInfo;
+        poolInfo.flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        poolInfo.queueFamilyIndex = m_computeFamily;
+        m_commandPool             = m_device.createCommandPool(poolInfo);
+
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.commandPool        = m_commandPool;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = 2;
+        m_commandBuffers             = m_device.allocateCommandBuffers(allocInfo);
+    }
+
+    void createPipeline(std::vector<char> const& compShaderCode)
+    {
+        auto compReflection = reflectShader(compShaderCode);
+
+        m_pipelineLayout   = m_layoutCache.getPipelineLayout({compReflection});
+        m_descriptorLayout = m_layoutCache.getDescriptorSetLayout(reflectedSetBindings(compReflection, 0));
+
+        vk::ShaderModuleCreateInfo moduleInfo;
+        moduleInfo.codeSize = compShaderCode.size();
+        moduleInfo.pCode    = reinterpret_cast<const uint32_t*>(compShaderCode.data());
+
+        auto compShaderModule = m_device.createShaderModule(moduleInfo);
+
+        vk::ComputePipelineCreateInfo pipelineInfo;
+        pipelineInfo.stage.stage  = vk::ShaderStageFlagBits::eCompute;
+        pipelineInfo.stage.module = compShaderModule;
+        pipelineInfo.stage.pName  = "main";
+        pipelineInfo.layout       = m_pipelineLayout;
+
+        m_pipeline = m_device.createComputePipelines(vk::PipelineCache(), {pipelineInfo}).value[0];
+
+        m_device.destroyShaderModule(compShaderModule);
+    }
+
+    std::optional<uint32_t> findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+    {
+        auto memoryProperties = m_physicalDevice.getMemoryProperties();
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+        {
+            if ((typeFilter & (1U << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return i;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    void createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, std::vector<vk::MemoryPropertyFlags> const& preferredProperties, vk::Buffer& buffer, vk::DeviceMemory& memory)
+    {
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.size        = size;
+        bufferInfo.usage       = usage;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+        buffer = m_device.createBuffer(bufferInfo);
+
+        auto memoryRequirements = m_device.getBufferMemoryRequirements(buffer);
+
+        std::optional<uint32_t> memoryType;
+        for (auto properties : preferredProperties)
+        {
+            memoryType = findMemoryType(memoryRequirements.memoryTypeBits, properties);
+            if (memoryType)
+            {
+                break;
+            }
+        }
+
+        if (!memoryType)
+        {
+            throw std::runtime_error("failed to find suitable memory type on the secondary device");
+        }
+
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = memoryType.value();
+
+        memory = m_device.allocateMemory(allocInfo);
+        m_device.bindBufferMemory(buffer, memory, 0);
+    }
+
+    void createBuffers(std::vector<Particle> const& initialParticles)
+    {
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            createBuffer(m_size, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+                         {vk::MemoryPropertyFlagBits::eDeviceLocal}, m_particleBuffers[i], m_particleMemories[i]);
+        }
+
+        // The CPU reads every byte of it each frame, so cached memory is preferred
+        auto hostCoherent = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        createBuffer(2 * m_size, vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+                     {hostCoherent | vk::MemoryPropertyFlagBits::eHostCached, hostCoherent}, m_readbackBuffer, m_readbackMemory);
+        m_readbackData = static_cast<uint8_t*>(m_device.mapMemory(m_readbackMemory, 0, 2 * m_size));
+
+        // The initial state is the "result" the first frame reads (slot 1) and the input of the first simulation (buffer 0)
+        std::memcpy(m_readbackData + m_size, initialParticles.data(), m_size);
+
+        auto commandBuffer = m_commandBuffers[0];
+        commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        commandBuffer.copyBuffer(m_readbackBuffer, m_particleBuffers[0], {vk::BufferCopy(m_size, 0, m_size)});
+        commandBuffer.end();
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers    = &commandBuffer;
+        m_queue.submit({submitInfo}, vk::Fence());
+        m_queue.waitIdle();
+    }
+
+    void createDescriptorSets()
+    {
+        vk::DescriptorPoolSize poolSize;
+        poolSize.type            = vk::DescriptorType::eStorageBuffer;
+        poolSize.descriptorCount = 4;
+
+        vk::DescriptorPoolCreateInfo poolInfo;
+        poolInfo.maxSets       = 2;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes    = &poolSize;
+
+        m_descriptorPool = m_device.createDescriptorPool(poolInfo);
+
+        std::vector<vk::DescriptorSetLayout> layouts{m_descriptorLayout, m_descriptorLayout};
+
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.descriptorPool     = m_descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+        allocInfo.pSetLayouts        = layouts.data();
+
+        auto sets = m_device.allocateDescriptorSets(allocInfo);
+
+        std::vector<vk::DescriptorBufferInfo> bufferInfos;
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            bufferInfos.push_back(vk::DescriptorBufferInfo(m_particleBuffers[i], 0, VK_WHOLE_SIZE));
+        }
+
+        std::vector<vk::WriteDescriptorSet> writes;
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            m_descriptorSets[i] = sets[i];
+
+            // Reads buffer i, writes the other one
+            writes.push_back(vk::WriteDescriptorSet(m_descriptorSets[i], 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[i]));
+            writes.push_back(vk::WriteDescriptorSet(m_descriptorSets[i], 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[1 - i]));
+        }
+
+        m_device.updateDescriptorSets(writes, {});
+    }
+
+    void createSyncObjects()
+    {
+        // Simulation n signals value n + 1
+        vk::SemaphoreTypeCreateInfo timelineInfo;
+        timelineInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        timelineInfo.initialValue  = 0U;
+
+        vk::SemaphoreCreateInfo semaphoreInfo;
+        semaphoreInfo.pNext = &timelineInfo;
+
+        m_timeline = m_device.createSemaphore(semaphoreInfo);
+
+        if (m_physicalDevice.getQueueFamilyProperties()[m_computeFamily].timestampValidBits > 0)
+        {
+            vk::QueryPoolCreateInfo queryPoolInfo;
+            queryPoolInfo.queryType  = vk::QueryType::eTimestamp;
+            queryPoolInfo.queryCount = 4; // Begin and end of both simulations in flight
+
+            m_queryPool       = m_device.createQueryPool(queryPoolInfo);
+            m_timestampPeriod = m_physicalDevice.getProperties().limits.timestampPeriod;
+        }
+    }
+
+    vk::PhysicalDevice             m_physicalDevice;
+    vk::Device                     m_device;
+    uint32_t                       m_computeFamily = 0;
+    vk::Queue                      m_queue;
+    PipelineLayoutCache            m_layoutCache;
+    vk::PipelineLayout             m_pipelineLayout; // Owned by the pipeline layout cache
+    vk::DescriptorSetLayout        m_descriptorLayout;
+    vk::Pipeline                   m_pipeline;
+    vk::CommandPool                m_commandPool;
+    std::vector<vk::CommandBuffer> m_commandBuffers; // Indexed by the source buffer
+    uint32_t                       m_particleCount = 0;
+    vk::DeviceSize                 m_size          = 0;
+    vk::Buffer                     m_particleBuffers[2];
+    vk::DeviceMemory               m_particleMemories[2];
+    vk::Buffer                     m_readbackBuffer; // Two slots, indexed by the source buffer of the simulation
+    vk::DeviceMemory               m_readbackMemory;
+    uint8_t*                       m_readbackData = nullptr;
+    vk::DescriptorPool             m_descriptorPool;
+    vk::DescriptorSet              m_descriptorSets[2]; // Indexed by the source buffer
+    vk::Semaphore                  m_timeline;
+    vk::QueryPool                  m_queryPool;
+    float                          m_timestampPeriod = 1.f;
+};
+
+class ComputeParticlesApplication
+{
+public:
+    explicit ComputeParticlesApplication(ApplicationSettings const& settings)
+        : m_settings(settings)
+#if !defined(NDEBUG)
+        , m_debugMessenger(settings.debugMessages)
+#endif
+    {
+    }
+
+    void run()
+    {
+        initialize();
+        mainLoop();
+        uninitialize();
+    }
+
+private:
+    void initialize()
+    {
+        initializeWindow();
+        initializeVulkan();
+    }
+
+    void initializeWindow()
+    {
+        glfwInit();
+
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+
+        m_window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Compute Particles", nullptr, nullptr);
+    }
+
+    void initializeVulkan()
+    {
+        createInstance();
+#if !defined(NDEBUG)
+        m_debugMessenger.create(m_instance);
+#endif
+        createSurface();
+        selectPhysicalDevice();
+        createLogicalDevice();
+        createSwapChain();
+        createImageViews();
+        createRenderPass();
+        createPipelines();
+        createFramebuffers();
+        createCommandPools();
+        createCommandBuffers();
+        createParticleBuffers();
+        createDescriptorSets();
+        createQueryPool();
+        createSyncObjects();
+
+        if (m_secondaryPhysicalDevice)
+        {
+            createSecondarySimulation();
+        }
+    }
+
+    void createInstance()
+    {
+        auto requiredLayers = getRequiredLayers();
+
+        vk::ApplicationInfo applicationInfo;
+        applicationInfo.pApplicationName   = "Compute Particles";
+        applicationInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+        applicationInfo.apiVersion         = VK_API_VERSION_1_2;
+
+        auto requiredExtensions = getRequiredExtensions();
+
+        vk::InstanceCreateInfo instanceCreateInfo;
+        instanceCreateInfo.pApplicationInfo        = &applicationInfo;
+        instanceCreateInfo.ppEnabledLayerNames     = requiredLayers.data();
+        instanceCreateInfo.enabledLayerCount       = static_cast<uint32_t>(requiredLayers.size());
+        instanceCreateInfo.ppEnabledExtensionNames = requiredExtensions.data();
+        instanceCreateInfo.enabledExtensionCount   = static_cast<uint32_t>(requiredExtensions.size());
+
+#if !defined(NDEBUG)
+        VkDebugUtilsMessengerCreateInfoEXT messengerCreateInfo = m_debugMessenger.createInfo();
+        instanceCreateInfo.pNext                               = &messengerCreateInfo;
+#endif
+
+        m_instance = vk::createInstance(instanceCreateInfo);
+    }
+
+    std::vector<char const*> getRequiredLayers()
+    {
+        std::vector<const char*> layers;
+
+#if !defined(NDEBUG)
+        layers.push_back("VK_LAYER_KHRONOS_validation");
+#endif
+
+        return layers;
+    }
+
+    std::vector<char const*> getRequiredExtensions()
+    {
+        uint32_t     glfwNumExtension = 0U;
+        char const** glfwExtensions   = glfwGetRequiredInstanceExtensions(&glfwNumExtension);
+
+        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwNumExtension);
+
+#if !defined(NDEBUG)
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+#endif
+
+        return extensions;
+    }
+
+    std::vector<char const*> getRequiredDeviceExtensions()
+    {
+        return { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    }
+
+    bool checkDeviceExtensionSupport(vk::PhysicalDevice const& device, std::vector<char const*> const& requiredExtensionNames)
+    {
+        auto deviceExtensions = device.enumerateDeviceExtensionProperties();
+
+        std::vector<std::string> deviceExtensionNames(deviceExtensions.size());
+        std::transform(std::begin(deviceExtensions), std::end(deviceExtensions),
+                       std::begin(deviceExtensionNames),
+                       [](vk::ExtensionProperties const& e) { return std::string(e.extensionName.data()); });
+
+        return std::all_of(std::begin(requiredExtensionNames), std::end(requiredExtensionNames),
+                           [&deviceExtensionNames](char const* name) { return std::find(std::begin(deviceExtensionNames), std::end(deviceExtensionNames), std::string(name)) != std::end(deviceExtensionNames); });
+    }
+
+    void createSurface()
+    {
+        VkSurfaceKHR surfaceRaw;
+        if (glfwCreateWindowSurface(m_instance, m_window, nullptr, &surfaceRaw) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create window surface");
+        }
+
+        m_surface = surfaceRaw;
+    }
+
+    QueueFamilyIndices findQueueFamilies(vk::PhysicalDevice const& device)
+    {
+        QueueFamilyIndices indices;
+
+        auto familyProperties = device.getQueueFamilyProperties();
+        bool dedicatedCompute = false;
+
+        for (uint32_t i = 0; i < familyProperties.size(); ++i)
+        {
+            auto const& queueFamily = familyProperties[i];
+            if (queueFamily.queueCount == 0)
+            {
+                continue;
+            }
+
+            bool graphics = static_cast<bool>(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics);
+            bool compute  = static_cast<bool>(queueFamily.queueFlags & vk::QueueFlagBits::eCompute);
+
+            if (graphics && !indices.graphicsFamily)
+            {
+                indices.graphicsFamily = i;
+            }
+
+            // A family without graphics is more likely to map to separate hardware queues
+            if (compute && !graphics && !dedicatedCompute)
+            {
+                indices.computeFamily = i;
+                dedicatedCompute      = true;
+            }
+            else if (compute && !indices.computeFamily)
+            {
+                indices.computeFamily = i;
+            }
+
+            if (!indices.presentFamily && device.getSurfaceSupportKHR(i, m_surface))
+            {
+                indices.presentFamily = i;
+            }
+        }
+
+        return indices;
+    }
+
+    SwapChainSupportDetails querySwapChainSupport(vk::PhysicalDevice const& device)
+    {
+        SwapChainSupportDetails details;
+
+        details.capabilities = device.getSurfaceCapabilitiesKHR(m_surface);
+        details.formats      = device.getSurfaceFormatsKHR(m_surface);
+        details.presentModes = device.getSurfacePresentModesKHR(m_surface);
+
+        return details;
+    }
+
+    vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats)
+    {
+        for (vk::SurfaceFormatKHR const& format : availableFormats)
+        {
+            if (format.format == vk::Format::eB8G8R8A8Srgb && format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)
+            {
+                return format;
+            }
+        }
+
+        return availableFormats[0];
+    }
+
+    // This sample measures throughput, so presentation should not throttle it
+    vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes)
+    {
+        for (auto preferredMode : {vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox})
+        {
+            if (std::find(std::begin(availablePresentModes), std::end(availablePresentModes), preferredMode) != std::end(availablePresentModes))
+            {
+                return preferredMode;
+            }
+        }
+
+        return vk::PresentModeKHR::eFifo;
+    }
+
+    vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities)
+    {
+        if (capabilities.currentExtent.width != UINT32_MAX)
+        {
+            return capabilities.currentExtent;
+        }
+        else
+        {
+            vk::Extent2D actualExtent(WINDOW_WIDTH, WINDOW_HEIGHT);
+
+            actualExtent.width  = std::min(capabilities.maxImageExtent.width, std::max(capabilities.minImageExtent.width, actualExtent.width));
+            actualExtent.height = std::min(capabilities.maxImageExtent.height, std::max(capabilities.minImageExtent.height, actualExtent.height));
+
+            return actualExtent;
+        }
+    }
+
+    bool isDeviceSuitable(vk::PhysicalDevice const& device)
+    {
+        auto queueFamilies = findQueueFamilies(device);
+
+        bool requiredExtensionsSupported = checkDeviceExtensionSupport(device, getRequiredDeviceExtensions());
+
+        bool swapChainAdequate = false;
+        if (requiredExtensionsSupported)
+        {
+            SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
+            swapChainAdequate                        = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        }
+
+        if (!queueFamilies.isComplete() || !requiredExtensionsSupported || !swapChainAdequate || device.getProperties().apiVersion < VK_API_VERSION_1_2)
+        {
+            return false;
+        }
+
+        auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+        return features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore;
+    }
+
+    void selectPhysicalDevice()
+    {
+        // With async compute requested, devices with a dedicated compute family are preferred
+        auto dedicatedComputeScore = [this](vk::PhysicalDevice const& device) -> int64_t {
+            auto indices = findQueueFamilies(device);
+            return m_settings.asyncCompute && indices.computeFamily && indices.computeFamily != indices.graphicsFamily ? 1000 : 0;
+        };
+
+        auto ranking = rankPhysicalDevices(m_instance, [this](auto const& d) { return isDeviceSuitable(d); }, dedicatedComputeScore);
+
+        if (ranking.empty())
+        {
+            throw std::runtime_error("failed to find GPUs with Vulkan support");
+        }
+
+        auto selected = findDevice(ranking, m_settings.device);
+        logDeviceRanking(std::cout, ranking, selected);
+
+        if (selected == nullptr)
+        {
+            throw std::runtime_error(m_settings.device ? "requested device '" + m_settings.device.value() + "' is not available or not suitable"
+                                                       : std::string("failed to find a suitable GPU!"));
+        }
+
+        // The simulation is a one-dimensional dispatch with one invocation per particle
+        uint64_t maxParticleCount = uint64_t(selected->properties.limits.maxComputeWorkGroupCount[0]) * SIMULATION_GROUP_SIZE;
+        if (m_settings.particleCount > maxParticleCount)
+        {
+            throw std::runtime_error("at most " + std::to_string(maxParticleCount) + " particles are supported by the selected device");
+        }
+
+        m_physicalDevice     = selected->device;
+        m_queueFamilyIndices = findQueueFamilies(m_physicalDevice);
+        m_timestampPeriod    = selected->properties.limits.timestampPeriod;
+
+        if (m_settings.secondaryDevice)
+        {
+            selectSecondaryDevice(selected->index);
+        }
+    }
+
+    // The secondary device only simulates, so it needs a compute queue but no surface support
+    void selectSecondaryDevice(uint32_t primaryIndex)
+    {
+        auto isSuitable = [this](vk::PhysicalDevice const& device) {
+            if (!SecondarySimulation::findComputeQueueFamily(device) || device.getProperties().apiVersion < VK_API_VERSION_1_2)
+            {
+                return false;
+            }
+
+            auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+            auto limits   = device.getProperties().limits;
+            return features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore &&
+                   m_settings.particleCount <= uint64_t(limits.maxComputeWorkGroupCount[0]) * SIMULATION_GROUP_SIZE;
+        };
+
+        // The primary device is left out, so "auto" means the best other device
+        auto ranking = rankPhysicalDevices(m_instance, isSuitable);
+        ranking.erase(std::remove_if(std::begin(ranking), std::end(ranking), [primaryIndex](auto const& c) { return c.index == primaryIndex; }), std::end(ranking));
+
+        auto selected = findDevice(ranking, m_settings.secondaryDeviceSelector);
+        if (selected == nullptr)
+        {
+            // Not fatal, the simulation stays on the primary device
+            std::cerr << "no secondary device available, simulating on the primary device." << std::endl;
+            return;
+        }
+
+        std::cout << "secondary device: [" << selected->index << "] " << selected->name() << std::endl;
+
+        m_secondaryPhysicalDevice = selected->device;
+    }
+
+    void createLogicalDevice()
+    {
+        QueueFamilyIndices const& indices = m_queueFamilyIndices;
+
+        auto familyProperties = m_physicalDevice.getQueueFamilyProperties();
+
+        // Without async compute the simulation is recorded into the graphics command buffer.
+        // With it, a separate queue is used: ideally from a dedicated compute family, otherwise
+        // a second queue of the graphics family. If neither exists, the submissions still go
+        // through the compute code path but end up on the graphics queue, so they can't overlap.
+        m_computeFamily = m_settings.asyncCompute ? indices.computeFamily.value() : indices.graphicsFamily.value();
+
+        uint32_t computeQueueIndex = 0U;
+        if (m_settings.asyncCompute && m_computeFamily == indices.graphicsFamily.value())
+        {
+            if (familyProperties[m_computeFamily].queueCount > 1)
+            {
+                computeQueueIndex = 1U;
+            }
+            else
+            {
+                std::cerr << "no separate compute queue available, the simulation will not overlap with rendering." << std::endl;
+            }
+        }
+
+        std::map<uint32_t, uint32_t> queueCounts; // Family -> number of queues
+        queueCounts[indices.graphicsFamily.value()] = 1U;
+        queueCounts[indices.presentFamily.value()]  = std::max(queueCounts[indices.presentFamily.value()], 1U);
+        queueCounts[m_computeFamily]                = std::max(queueCounts[m_computeFamily], computeQueueIndex + 1);
+
+        std::vector<float>                     priorities(2, 1.0f);
+        std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
+        for (auto const& entry : queueCounts)
+        {
+            vk::DeviceQueueCreateInfo queueCreateInfo;
+            queueCreateInfo.queueFamilyIndex = entry.first;
+            queueCreateInfo.queueCount       = entry.second;
+            queueCreateInfo.pQueuePriorities = priorities.data();
+
+            queueCreateInfos.push_back(queueCreateInfo);
+        }
+
+        vk::PhysicalDeviceVulkan12Features vulkan12Features;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+
+        vk::PhysicalDeviceFeatures2 deviceFeatures;
+        deviceFeatures.pNext = &vulkan12Features;
+
+        auto requiredDeviceExtensions = getRequiredDeviceExtensions();
+        auto requiredLayers           = getRequiredLayers();
+
+        vk::DeviceCreateInfo createInfo;
+        createInfo.pNext                   = &deviceFeatures;
+        createInfo.pQueueCreateInfos       = queueCreateInfos.data();
+        createInfo.queueCreateInfoCount    = static_cast<uint32_t>(queueCreateInfos.size());
+        createInfo.ppEnabledExtensionNames = requiredDeviceExtensions.data();
+        createInfo.enabledExtensionCount   = static_cast<uint32_t>(requiredDeviceExtensions.size());
+        createInfo.ppEnabledLayerNames     = requiredLayers.data();
+        createInfo.enabledLayerCount       = static_cast<uint32_t>(requiredLayers.size());
+
+        m_device = m_physicalDevice.createDevice(createInfo);
+
+        m_graphicsQueue = m_device.getQueue(indices.graphicsFamily.value(), 0U);
+        m_presentQueue  = m_device.getQueue(indices.presentFamily.value(), 0U);
+        m_computeQueue  = m_device.getQueue(m_computeFamily, computeQueueIndex);
+
+        m_pipelineLayoutCache.setDevice(m_device);
+
+        // Both queues write timestamps, so both families have to support them
+        m_timestampsSupported = familyProperties[indices.graphicsFamily.value()].timestampValidBits > 0 &&
+                                familyProperties[m_computeFamily].timestampValidBits > 0;
+        if (!m_timestampsSupported)
+        {
+            std::cerr << "timestamps not supported, GPU times and overlap will not be reported." << std::endl;
+        }
+    }
+
+    void createSwapChain()
+    {
+        auto swapChainSupport = querySwapChainSupport(m_physicalDevice);
+
+        m_swapchainExtent      = chooseSwapExtent(swapChainSupport.capabilities);
+        auto format            = chooseSwapSurfaceFormat(swapChainSupport.formats);
+        m_swapchainImageFormat = format.format;
+
+        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
+        {
+            imageCount = swapChainSupport.capabilities.maxImageCount;
+        }
+
+        vk::SwapchainCreateInfoKHR createInfo;
+        createInfo.surface          = m_surface;
+        createInfo.minImageCount    = imageCount;
+        createInfo.imageFormat      = format.format;
+        createInfo.imageColorSpace  = format.colorSpace;
+        createInfo.imageExtent      = m_swapchainExtent;
+        createInfo.imageArrayLayers = 1U;
+        createInfo.imageUsage       = vk::ImageUsageFlagBits::eColorAttachment;
+
+        QueueFamilyIndices const& indices = m_queueFamilyIndices;
+        std::vector<uint32_t>     queueFamilyIndices{indices.graphicsFamily.value(), indices.presentFamily.value()};
+
+        if (indices.graphicsFamily.value() != indices.presentFamily.value())
+        {
+            createInfo.imageSharingMode      = vk::SharingMode::eConcurrent;
+            createInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+            createInfo.pQueueFamilyIndices   = queueFamilyIndices.data();
+        }
+        else
+        {
+            createInfo.imageSharingMode = vk::SharingMode::eExclusive;
+        }
+
+        createInfo.preTransform   = swapChainSupport.capabilities.currentTransform;
+        createInfo.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
+        createInfo.presentMode    = chooseSwapPresentMode(swapChainSupport.presentModes);
+        createInfo.clipped        = VK_TRUE;
+
+        m_swapchain       = m_device.createSwapchainKHR(createInfo);
+        m_swapchainImages = m_device.getSwapchainImagesKHR(m_swapchain);
+    }
+
+    void createImageViews()
+    {
+        for (auto const& image : m_swapchainImages)
+        {
+            vk::ImageViewCreateInfo createInfo;
+            createInfo.image    = image;
+            createInfo.format   = m_swapchainImageFormat;
+            createInfo.viewType = vk::ImageViewType::e2D;
+
+            createInfo.subresourceRange.aspectMask     = vk::ImageAspectFlagBits::eColor;
+            createInfo.subresourceRange.baseMipLevel   = 0U;
+            createInfo.subresourceRange.levelCount     = 1U;
+            createInfo.subresourceRange.baseArrayLayer = 0U;
+            createInfo.subresourceRange.layerCount     = 1U;
+
+            m_swapchainImageViews.push_back(m_device.createImageView(createInfo));
+        }
+    }
+
+    vk::ShaderModule createShaderModule(const std::vector<char>& code)
+    {
+        vk::ShaderModuleCreateInfo createInfo;
+        createInfo.codeSize = code.size();
+        createInfo.pCode    = reinterpret_cast<const uint32_t*>(code.data());
+
+        return m_device.createShaderModule(createInfo);
+    }
+
+    void createRenderPass()
+    {
+        vk::AttachmentDescription colorAttachment;
+        colorAttachment.format         = m_swapchainImageFormat;
+        colorAttachment.samples        = vk::SampleCountFlagBits::e1;
+        colorAttachment.loadOp         = vk::AttachmentLoadOp::eClear;
+        colorAttachment.storeOp        = vk::AttachmentStoreOp::eStore;
+        colorAttachment.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
+        colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        colorAttachment.initialLayout  = vk::ImageLayout::eUndefined;
+        colorAttachment.finalLayout    = vk::ImageLayout::ePresentSrcKHR;
+
+        vk::AttachmentReference colorAttachmentRef;
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout     = vk::ImageLayout::eColorAttachmentOptimal;
+
+        vk::SubpassDescription subpass;
+        subpass.pipelineBindPoint    = vk::PipelineBindPoint::eGraphics;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments    = &colorAttachmentRef;
+
+        vk::SubpassDependency dependency;
+        dependency.srcSubpass    = VK_SUBPASS_EXTERNAL;
+        dependency.srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependency.srcAccessMask = vk::AccessFlags();
+        dependency.dstSubpass    = 0;
+        dependency.dstStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+
+        vk::RenderPassCreateInfo renderPassInfo;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments    = &colorAttachment;
+        renderPassInfo.subpassCount    = 1;
+        renderPassInfo.pSubpasses      = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies   = &dependency;
+
+        m_renderPass = m_device.createRenderPass(renderPassInfo);
+    }
+
+    void createPipelines()
+    {
+        createSimulationPipeline(readFile(PATH_PARTICLES_SIMULATE_COMP));
+        createRenderPipeline(readFile(PATH_PARTICLES_RENDER_VERT), readFile(PATH_PARTICLES_RENDER_FRAG));
+    }
+
+    void createSimulationPipeline(std::vector<char> const& compShaderCode)
+    {
+        auto compReflection = reflectShader(compShaderCode);
+
+        m_simulationPipelineLayout   = m_pipelineLayoutCache.getPipelineLayout({compReflection});
+        m_simulationDescriptorLayout = m_pipelineLayoutCache.getDescriptorSetLayout(reflectedSetBindings(compReflection, 0));
+
+        auto compShaderModule = createShaderModule(compShaderCode);
+
+        vk::ComputePipelineCreateInfo pipelineInfo;
+        pipelineInfo.stage.stage  = vk::ShaderStageFlagBits::eCompute;
+        pipelineInfo.stage.module = compShaderModule;
+        pipelineInfo.stage.pName  = "main";
+        pipelineInfo.layout       = m_simulationPipelineLayout;
+
+        m_simulationPipeline = m_device.createComputePipelines(vk::PipelineCache(), {pipelineInfo}).value[0];
+
+        m_device.destroyShaderModule(compShaderModule);
+    }
+
+    void createRenderPipeline(std::vector<char> const& vertShaderCode, std::vector<char> const& fragShaderCode)
+    {
+        auto vertReflection = reflectShader(vertShaderCode);
+        auto fragReflection = reflectShader(fragShaderCode);
+
+        m_renderPipelineLayout   = m_pipelineLayoutCache.getPipelineLayout({vertReflection, fragReflection});
+        m_renderDescriptorLayout = m_pipelineLayoutCache.getDescriptorSetLayout(reflectedSetBindings(vertReflection, 0));
+
+        auto vertShaderModule = createShaderModule(vertShaderCode);
+        auto fragShaderModule = createShaderModule(fragShaderCode);
+
+        vk::PipelineShaderStageCreateInfo shaderStages[2];
+        shaderStages[0].stage  = vk::ShaderStageFlagBits::eVertex;
+        shaderStages[0].module = vertShaderModule;
+        shaderStages[0].pName  = "main";
+        shaderStages[1].stage  = vk::ShaderStageFlagBits::eFragment;
+        shaderStages[1].module = fragShaderModule;
+        shaderStages[1].pName  = "main";
+
+        // The particles are read from the storage buffer in the vertex shader
+        VertexInputLayout                      vertexInputLayout(vertReflection);
+        vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vertexInputLayout.createInfo();
+
+        vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+        inputAssembly.topology               = vk::PrimitiveTopology::ePointList;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        vk::Viewport viewport;
+        viewport.x        = 0.f;
+        viewport.y        = 0.f;
+        viewport.width    = static_cast<float>(m_swapchainExtent.width);
+        viewport.height   = static_cast<float>(m_swapchainExtent.height);
+        viewport.minDepth = 0.f;
+        viewport.maxDepth = 1.f;
+
+        vk::Rect2D scissor;
+        scissor.offset = {0, 0};
+        scissor.extent = m_swapchainExtent;
+
+        vk::PipelineViewportStateCreateInfo viewportState;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports    = &viewport;
+        viewportState.scissorCount  = 1;
+        viewportState.pScissors     = &scissor;
+
+        vk::PipelineRasterizationStateCreateInfo rasterizer;
+        rasterizer.depthClampEnable        = VK_FALSE;
+        rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        rasterizer.polygonMode             = vk::PolygonMode::eFill;
+        rasterizer.lineWidth               = 1.f;
+        rasterizer.cullMode                = vk::CullModeFlagBits::eNone;
+        rasterizer.frontFace               = vk::FrontFace::eClockwise;
+        rasterizer.depthBiasEnable         = VK_FALSE;
+
+        vk::PipelineMultisampleStateCreateInfo multisampling;
+        multisampling.sampleShadingEnable  = VK_FALSE;
+        multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+        // Additive blending, so dense regions get brighter
+        vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+        colorBlendAttachment.colorWriteMask      = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+        colorBlendAttachment.blendEnable         = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = vk::BlendFactor::eOne;
+        colorBlendAttachment.dstColorBlendFactor = vk::BlendFactor::eOne;
+        colorBlendAttachment.colorBlendOp        = vk::BlendOp::eAdd;
+        colorBlendAttachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+        colorBlendAttachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
+        colorBlendAttachment.alphaBlendOp        = vk::BlendOp::eAdd;
+
+        vk::PipelineColorBlendStateCreateInfo colorBlending;
+        colorBlending.logicOpEnable   = VK_FALSE;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments    = &colorBlendAttachment;
+
+        vk::GraphicsPipelineCreateInfo pipelineInfo;
+        pipelineInfo.stageCount          = 2;
+        pipelineInfo.pStages             = shaderStages;
+        pipelineInfo.pVertexInputState   = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState      = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState   = &multisampling;
+        pipelineInfo.pColorBlendState    = &colorBlending;
+        pipelineInfo.layout              = m_renderPipelineLayout;
+        pipelineInfo.renderPass          = m_renderPass;
+        pipelineInfo.subpass             = 0;
+
+        m_renderPipeline = m_device.createGraphicsPipelines(vk::PipelineCache(), {pipelineInfo}).value[0];
+
+        m_device.destroyShaderModule(vertShaderModule);
+        m_device.destroyShaderModule(fragShaderModule);
+    }
+
+    void createFramebuffers()
+    {
+        m_swapchainFramebuffers.resize(m_swapchainImageViews.size());
+
+        for (size_t i = 0; i < m_swapchainImageViews.size(); ++i)
+        {
+            vk::ImageView attachments[] = {m_swapchainImageViews[i]};
+
+            vk::FramebufferCreateInfo framebufferInfo;
+            framebufferInfo.renderPass      = m_renderPass;
+            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.pAttachments    = attachments;
+            framebufferInfo.width           = m_swapchainExtent.width;
+            framebufferInfo.height          = m_swapchainExtent.height;
+            framebufferInfo.layers          = 1;
+
+            m_swapchainFramebuffers[i] = m_device.createFramebuffer(framebufferInfo);
+        }
+    }
+
+    void createCommandPools()
+    {
+        vk::CommandPoolCreateInfo poolInfo;
+        poolInfo.flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        poolInfo.queueFamilyIndex = m_queueFamilyIndices.graphicsFamily.value();
+
+        m_graphicsCommandPool = m_device.createCommandPool(poolInfo);
+
+        poolInfo.queueFamilyIndex = m_computeFamily;
+        m_computeCommandPool      = m_device.createCommandPool(poolInfo);
+    }
+
+    void createCommandBuffers()
+    {
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+
+        allocInfo.commandPool    = m_graphicsCommandPool;
+        m_graphicsCommandBuffers = m_device.allocateCommandBuffers(allocInfo);
+
+        allocInfo.commandPool   = m_computeCommandPool;
+        m_computeCommandBuffers = m_device.allocateCommandBuffers(allocInfo);
+    }
+
+    uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+    {
+        auto memoryProperties = m_physicalDevice.getMemoryProperties();
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+        {
+            if ((typeFilter & (1U << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("failed to find suitable memory type");
+    }
+
+    void createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer& buffer, vk::DeviceMemory& memory)
+    {
+        // Shared between the graphics and the compute family, which avoids queue family ownership transfers
+        std::vector<uint32_t> queueFamilies{m_queueFamilyIndices.graphicsFamily.value(), m_computeFamily};
+
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.size  = size;
+        bufferInfo.usage = usage;
+        if (queueFamilies[0] != queueFamilies[1])
+        {
+            bufferInfo.sharingMode           = vk::SharingMode::eConcurrent;
+            bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+            bufferInfo.pQueueFamilyIndices   = queueFamilies.data();
+        }
+        else
+        {
+            bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+        }
+
+        buffer = m_device.createBuffer(bufferInfo);
+
+        auto                   memoryRequirements = m_device.getBufferMemoryRequirements(buffer);
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, properties);
+
+        memory = m_device.allocateMemory(allocInfo);
+        m_device.bindBufferMemory(buffer, memory, 0);
+    }
+
+    void createParticleBuffers()
+    {
+        vk::DeviceSize size = sizeof(Particle) * m_settings.particleCount;
+
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            createBuffer(size, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal,
+                         m_particleBuffers[i], m_particleMemories[i]);
+        }
+
+        // The initial state is uploaded into the first buffer, which the first frame reads
+        vk::Buffer       stagingBuffer;
+        vk::DeviceMemory stagingMemory;
+        createBuffer(size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                     stagingBuffer, stagingMemory);
+
+        auto particles = createInitialParticles(m_settings.particleCount);
+        std::memcpy(m_device.mapMemory(stagingMemory, 0, size), particles.data(), size);
+        m_device.unmapMemory(stagingMemory);
+
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.commandPool        = m_graphicsCommandPool;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = 1;
+
+        auto commandBuffer = m_device.allocateCommandBuffers(allocInfo)[0];
+        commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        commandBuffer.copyBuffer(stagingBuffer, m_particleBuffers[0], {vk::BufferCopy(0, 0, size)});
+        commandBuffer.end();
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers    = &commandBuffer;
+        m_graphicsQueue.submit({submitInfo}, vk::Fence());
+        m_graphicsQueue.waitIdle();
+
+        m_device.freeCommandBuffers(m_graphicsCommandPool, {commandBuffer});
+        m_device.destroyBuffer(stagingBuffer);
+        m_device.freeMemory(stagingMemory);
+    }
+
+    // The simulation results of the secondary device are copied into one upload buffer per frame in flight
+    void createSecondarySimulation()
+    {
+        m_secondarySimulation.create(m_secondaryPhysicalDevice, readFile(PATH_PARTICLES_SIMULATE_COMP), createInitialParticles(m_settings.particleCount));
+        m_statistics.enableSecondaryDevice();
+
+        vk::DeviceSize size = sizeof(Particle) * m_settings.particleCount;
+
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        {
+            createBuffer(size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                         m_uploadBuffers[i], m_uploadMemories[i]);
+            m_uploadData[i] = m_device.mapMemory(m_uploadMemories[i], 0, size);
+        }
+    }
+
+    void createDescriptorSets()
+    {
+        vk::DescriptorPoolSize poolSize;
+        poolSize.type            = vk::DescriptorType::eStorageBuffer;
+        poolSize.descriptorCount = 6;
+
+        vk::DescriptorPoolCreateInfo poolInfo;
+        poolInfo.maxSets       = 4;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes    = &poolSize;
+
+        m_descriptorPool = m_device.createDescriptorPool(poolInfo);
+
+        // One simulation set per direction (0 -> 1 and 1 -> 0) and one render set per buffer
+        std::vector<vk::DescriptorSetLayout> layouts{m_simulationDescriptorLayout, m_simulationDescriptorLayout, m_renderDescriptorLayout, m_renderDescriptorLayout};
+
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.descriptorPool     = m_descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+        allocInfo.pSetLayouts        = layouts.data();
+
+        auto sets = m_device.allocateDescriptorSets(allocInfo);
+
+        std::vector<vk::DescriptorBufferInfo> bufferInfos;
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            bufferInfos.push_back(vk::DescriptorBufferInfo(m_particleBuffers[i], 0, VK_WHOLE_SIZE));
+        }
+
+        std::vector<vk::WriteDescriptorSet> writes;
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            m_simulationDescriptorSets[i] = sets[i];
+            m_renderDescriptorSets[i]     = sets[2 + i];
+
+            // Reads buffer i, writes the other one
+            writes.push_back(vk::WriteDescriptorSet(m_simulationDescriptorSets[i], 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[i]));
+            writes.push_back(vk::WriteDescriptorSet(m_simulationDescriptorSets[i], 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[1 - i]));
+            writes.push_back(vk::WriteDescriptorSet(m_renderDescriptorSets[i], 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[i]));
+        }
+
+        m_device.updateDescriptorSets(writes, {});
+    }
+
+    void createQueryPool()
+    {
+        if (!m_timestampsSupported)
+        {
+            return;
+        }
+
+        vk::QueryPoolCreateInfo queryPoolInfo;
+        queryPoolInfo.queryType  = vk::QueryType::eTimestamp;
+        queryPoolInfo.queryCount = TIMESTAMPS_PER_FRAME * MAX_FRAMES_IN_FLIGHT;
+
+        m_queryPool = m_device.createQueryPool(queryPoolInfo);
+    }
+
+    void createSyncObjects()
+    {
+        m_imageTimelineValues.resize(m_swapchainImages.size(), 0U);
+
+        vk::SemaphoreCreateInfo semaphoreInfo;
+
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        {
+            m_imageAvailableSemaphores[i] = m_device.createSemaphore(semaphoreInfo);
+            m_renderFinishedSemaphores[i] = m_device.createSemaphore(semaphoreInfo);
+        }
+
+        // Frame n signals value n + 1 on both timelines when its simulation respectively its rendering is done
+        vk::SemaphoreTypeCreateInfo timelineInfo;
+        timelineInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        timelineInfo.initialValue  = 0U;
+
+        vk::SemaphoreCreateInfo timelineSemaphoreInfo;
+        timelineSemaphoreInfo.pNext = &timelineInfo;
+
+        m_computeTimeline  = m_device.createSemaphore(timelineSemaphoreInfo);
+        m_graphicsTimeline = m_device.createSemaphore(timelineSemaphoreInfo);
+    }
+
+    void waitForTimeline(vk::Semaphore timeline, uint64_t value)
+    {
+        vk::SemaphoreWaitInfo waitInfo;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores    = &timeline;
+        waitInfo.pValues        = &value;
+
+        m_device.waitSemaphores(waitInfo, UINT64_MAX);
+    }
+
+    // The attractor circles around the center, so the simulation keeps moving
+    SimulationConstants simulationConstants(float deltaTime)
+    {
+        float time = std::chrono::duration<float>(Clock::now() - m_startTime).count();
+
+        SimulationConstants constants;
+        constants.attractor[0]  = 0.5f * std::cos(0.5f * time);
+        constants.attractor[1]  = 0.5f * std::sin(0.5f * time);
+        constants.deltaTime     = deltaTime;
+        constants.particleCount = m_settings.particleCount;
+        return constants;
+    }
+
+    void recordSimulation(vk::CommandBuffer commandBuffer, uint32_t source, SimulationConstants const& constants)
+    {
+        uint32_t queryBase = TIMESTAMPS_PER_FRAME * m_currentFrame;
+
+        if (m_timestampsSupported)
+        {
+            commandBuffer.resetQueryPool(m_queryPool, queryBase, 2);
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool, queryBase);
+        }
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_simulationPipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_simulationPipelineLayout, 0, {m_simulationDescriptorSets[source]}, {});
+        commandBuffer.pushConstants(m_simulationPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+        commandBuffer.dispatch((m_settings.particleCount + SIMULATION_GROUP_SIZE - 1) / SIMULATION_GROUP_SIZE, 1, 1);
+
+        if (m_timestampsSupported)
+        {
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, queryBase + 1);
+        }
+    }
+
+    // Copies the simulation result of the secondary device into the particle buffer that is rendered.
+    // Uses the compute timestamps, the primary device doesn't simulate in this case.
+    void recordUpload(vk::CommandBuffer commandBuffer, uint32_t particleBuffer)
+    {
+        uint32_t queryBase = TIMESTAMPS_PER_FRAME * m_currentFrame;
+
+        if (m_timestampsSupported)
+        {
+            commandBuffer.resetQueryPool(m_queryPool, queryBase, 2);
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool, queryBase);
+        }
+
+        // The rendering of frame n - 2 read the buffer that is written now
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexShader, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, {});
+
+        vk::DeviceSize size = sizeof(Particle) * m_settings.particleCount;
+        commandBuffer.copyBuffer(m_uploadBuffers[m_currentFrame], m_particleBuffers[particleBuffer], {vk::BufferCopy(0, 0, size)});
+
+        vk::MemoryBarrier uploadDone;
+        uploadDone.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        uploadDone.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexShader, {}, {uploadDone}, {}, {});
+
+        if (m_timestampsSupported)
+        {
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, queryBase + 1);
+        }
+    }
+
+    void recordRendering(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t particleBuffer)
+    {
+        uint32_t queryBase = TIMESTAMPS_PER_FRAME * m_currentFrame;
+
+        if (m_timestampsSupported)
+        {
+            commandBuffer.resetQueryPool(m_queryPool, queryBase + 2, 2);
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool, queryBase + 2);
+        }
+
+        vk::RenderPassBeginInfo renderPassInfo;
+        renderPassInfo.renderPass        = m_renderPass;
+        renderPassInfo.framebuffer       = m_swapchainFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = m_swapchainExtent;
+
+        vk::ClearValue clearColor      = std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f});
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues    = &clearColor;
+
+        commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_renderPipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_renderPipelineLayout, 0, {m_renderDescriptorSets[particleBuffer]}, {});
+        commandBuffer.draw(m_settings.particleCount, 1, 0, 0);
+        commandBuffer.endRenderPass();
+
+        if (m_timestampsSupported)
+        {
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, queryBase + 3);
+        }
+    }
+
+    // Read the timestamps of the frame that last used the current frame slot
+    std::optional<FrameTimestamps> readFrameTimestamps()
+    {
+        uint64_t timestamps[TIMESTAMPS_PER_FRAME] = {};
+        uint32_t firstQuery                       = TIMESTAMPS_PER_FRAME * m_currentFrame;
+        auto     result                           = m_device.getQueryPoolResults(m_queryPool, firstQuery, TIMESTAMPS_PER_FRAME, sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess)
+        {
+            return std::nullopt;
+        }
+
+        // Timestamps of both queues are compared with each other, which assumes they share a time base.
+        // That's the case on common implementations, but not guaranteed without calibrated timestamps.
+        auto milliseconds = [this](uint64_t timestamp) { return timestamp * static_cast<double>(m_timestampPeriod) / 1e6; };
+
+        FrameTimestamps frame;
+        frame.computeBegin  = milliseconds(timestamps[0]);
+        frame.computeEnd    = milliseconds(timestamps[1]);
+        frame.graphicsBegin = milliseconds(timestamps[2]);
+        frame.graphicsEnd   = milliseconds(timestamps[3]);
+        return frame;
+    }
+
+    void mainLoop()
+    {
+        m_startTime = Clock::now();
+
+        auto previousFrameTime = m_startTime;
+        auto titleUpdateTime   = m_startTime;
+        auto titleUpdateFrame  = m_frameNumber;
+
+        while (!glfwWindowShouldClose(m_window))
+        {
+            glfwPollEvents();
+
+            auto  now         = Clock::now();
+            float deltaTime   = std::min(std::chrono::duration<float>(now - previousFrameTime).count(), 0.05f);
+            previousFrameTime = now;
+
+            drawFrame(deltaTime);
+
+            double secondsSinceTitleUpdate = std::chrono::duration<double>(now - titleUpdateTime).count();
+            if (secondsSinceTitleUpdate >= 1.0)
+            {
+                std::ostringstream title;
+                title << "Compute Particles - " << std::fixed << std::setprecision(1)
+                      << m_settings.particleCount * ((m_frameNumber - titleUpdateFrame) / secondsSinceTitleUpdate) / 1e6 << " M particles/s";
+                glfwSetWindowTitle(m_window, title.str().c_str());
+
+                titleUpdateTime  = now;
+                titleUpdateFrame = m_frameNumber;
+            }
+        }
+
+        m_device.waitIdle();
+
+        double seconds = std::chrono::duration<double>(Clock::now() - m_startTime).count();
+        std::cout << "async compute: " << (m_settings.asyncCompute ? "on" : "off") << std::endl;
+        std::cout << "secondary device: " << (m_secondaryPhysicalDevice ? "on (rendering one frame behind the simulation)" : "off") << std::endl;
+        m_statistics.report(std::cout, m_settings.particleCount, m_frameNumber, seconds);
+    }
+
+    // Frame n simulates from buffer n % 2 into the other buffer, which it then renders.
+    //
+    // Without async compute, both happen in one command buffer on the graphics queue.
+    // With async compute, the simulation of frame n is submitted to the compute queue and may
+    // run while frame n - 1 is being rendered (which reads the buffer the simulation reads).
+    // It may not start before frame n - 2 is rendered, since that frame reads the buffer the
+    // simulation writes, nor before the simulation of frame n - 1 is done, which writes the
+    // buffer it reads. The rendering of frame n waits for the simulation of frame n.
+    // With a secondary device, frame n uploads the result of simulation n - 1 instead and
+    // renders it while simulation n runs on the other device (see SecondarySimulation).
+    void drawFrame(float deltaTime)
+    {
+        uint64_t frame          = m_frameNumber;
+        uint32_t sourceBuffer   = static_cast<uint32_t>(frame % 2);
+        uint32_t particleBuffer = 1 - sourceBuffer;
+
+        // Wait until the frame that last used this slot is rendered (its simulation finished before)
+        if (frame >= MAX_FRAMES_IN_FLIGHT)
+        {
+            waitForTimeline(m_graphicsTimeline, frame + 1 - MAX_FRAMES_IN_FLIGHT);
+
+            if (m_timestampsSupported)
+            {
+                auto timestamps = readFrameTimestamps();
+                if (timestamps)
+                {
+                    m_statistics.addFrame(timestamps.value(), m_previousTimestamps);
+                }
+                m_previousTimestamps = timestamps;
+            }
+        }
+
+        uint32_t imageIndex = m_device.acquireNextImageKHR(m_swapchain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], vk::Fence());
+        waitForTimeline(m_graphicsTimeline, m_imageTimelineValues[imageIndex]);
+        m_imageTimelineValues[imageIndex] = frame + 1;
+
+        auto constants       = simulationConstants(deltaTime);
+        auto graphicsCommand = m_graphicsCommandBuffers[m_currentFrame];
+
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+        if (m_settings.asyncCompute)
+        {
+            auto computeCommand = m_computeCommandBuffers[m_currentFrame];
+            computeCommand.begin(beginInfo);
+            recordSimulation(computeCommand, sourceBuffer, constants);
+            computeCommand.end();
+
+            // Wait for the rendering of frame n - 2 (graphics value n - 1), which reads the buffer written here,
+            // and for the simulation of frame n - 1 (compute value n), which writes the buffer read here.
+            // Submission order on the compute queue alone doesn't order the two simulations, and with only
+            // one queue they would not even be on the same queue as the rendering they depend on.
+            // Waiting before any command keeps the begin timestamp from being written too early.
+            vk::Semaphore          waitSemaphores[] = {m_graphicsTimeline, m_computeTimeline};
+            uint64_t               waitValues[]     = {frame >= 1 ? frame - 1 : 0, frame};
+            vk::PipelineStageFlags waitStages[]     = {vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands};
+            uint64_t               signalValue      = frame + 1;
+
+            vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo;
+            timelineSubmitInfo.waitSemaphoreValueCount   = 2;
+            timelineSubmitInfo.pWaitSemaphoreValues      = waitValues;
+            timelineSubmitInfo.signalSemaphoreValueCount = 1;
+            timelineSubmitInfo.pSignalSemaphoreValues    = &signalValue;
+
+            vk::SubmitInfo submitInfo;
+            submitInfo.pNext                = &timelineSubmitInfo;
+            submitInfo.waitSemaphoreCount   = 2;
+            submitInfo.pWaitSemaphores      = waitSemaphores;
+            submitInfo.pWaitDstStageMask    = waitStages;
+            submitInfo.commandBufferCount   = 1;
+            submitInfo.pCommandBuffers      = &computeCommand;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores    = &m_computeTimeline;
+
+            m_computeQueue.submit({submitInfo}, vk::Fence());
+
+            graphicsCommand.begin(beginInfo);
+        }
+        else if (m_secondaryPhysicalDevice)
+        {
+            // The upload buffer of this slot was last read by frame n - 2, which is rendered.
+            // Host writes to coherent memory are visible to the commands submitted afterwards.
+            m_secondarySimulation.readResult(frame, m_uploadData[m_currentFrame]);
+            if (frame >= 1)
+            {
+                auto simulationTime = m_secondarySimulation.simulationTime(frame - 1);
+                if (simulationTime)
+                {
+                    m_statistics.addSecondarySimulation(simulationTime.value());
+                }
+            }
+
+            // Runs on the secondary device while this frame renders the previous result
+            m_secondarySimulation.submit(frame, constants);
+
+            graphicsCommand.begin(beginInfo);
+            recordUpload(graphicsCommand, particleBuffer);
+        }
+        else
+        {
+            graphicsCommand.begin(beginInfo);
+
+            // The simulation of frame n - 1 wrote the buffer that is read now, and the rendering of
+            // frame n - 2 read the buffer that is written now. The previous frame's writes were only
+            // made visible to the vertex shader, so the simulation needs its own memory dependency.
+            vk::MemoryBarrier previousFrame;
+            previousFrame.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            previousFrame.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+            graphicsCommand.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexShader, vk::PipelineStageFlagBits::eComputeShader,
+                                            {}, {previousFrame}, {}, {});
+
+            recordSimulation(graphicsCommand, sourceBuffer, constants);
+
+            vk::MemoryBarrier simulationDone;
+            simulationDone.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            simulationDone.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            graphicsCommand.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexShader, {}, {simulationDone}, {}, {});
+        }
+
+        recordRendering(graphicsCommand, imageIndex, particleBuffer);
+        graphicsCommand.end();
+
+        // Values for binary semaphores are ignored. Without async compute the compute timeline
+        // isn't signaled, so waiting for it is skipped by only passing the first wait.
+        // The simulation is waited for before any command, like above for the timestamps.
+        vk::Semaphore          waitSemaphores[]   = {m_imageAvailableSemaphores[m_currentFrame], m_computeTimeline};
+        vk::PipelineStageFlags waitStages[]       = {vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eAllCommands};
+        uint64_t               waitValues[]       = {0U, frame + 1};
+        vk::Semaphore          signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame], m_graphicsTimeline};
+        uint64_t               signalValues[]     = {0U, frame + 1};
+        uint32_t               waitCount          = m_settings.asyncCompute ? 2U : 1U;
+
+        vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo;
+        timelineSubmitInfo.waitSemaphoreValueCount   = waitCount;
+        timelineSubmitInfo.pWaitSemaphoreValues      = waitValues;
+        timelineSubmitInfo.signalSemaphoreValueCount = 2;
+        timelineSubmitInfo.pSignalSemaphoreValues    = signalValues;
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.pNext                = &timelineSubmitInfo;
+        submitInfo.waitSemaphoreCount   = waitCount;
+        submitInfo.pWaitSemaphores      = waitSemaphores;
+        submitInfo.pWaitDstStageMask    = waitStages;
+        submitInfo.commandBufferCount   = 1;
+        submitInfo.pCommandBuffers      = &graphicsCommand;
+        submitInfo.signalSemaphoreCount = 2;
+        submitInfo.pSignalSemaphores    = signalSemaphores;
+
+        m_graphicsQueue.submit({submitInfo}, vk::Fence());
+
+        vk::PresentInfoKHR presentInfo;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores    = &m_renderFinishedSemaphores[m_currentFrame];
+        presentInfo.swapchainCount     = 1;
+        presentInfo.pSwapchains        = &m_swapchain;
+        presentInfo.pImageIndices      = &imageIndex;
+
+        m_presentQueue.presentKHR(presentInfo);
+
+        ++m_frameNumber;
+        m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    }
+
+    void uninitialize()
+    {
+        glfwDestroyWindow(m_window);
+        glfwTerminate();
+
+        m_secondarySimulation.destroy();
+
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        {
+            if (m_uploadBuffers[i])
+            {
+                m_device.destroyBuffer(m_uploadBuffers[i]);
+                m_device.freeMemory(m_uploadMemories[i]);
+            }
+        }
+
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        {
+            m_device.destroySemaphore(m_imageAvailableSemaphores[i]);
+            m_device.destroySemaphore(m_renderFinishedSemaphores[i]);
+        }
+
+        m_device.destroySemaphore(m_computeTimeline);
+        m_device.destroySemaphore(m_graphicsTimeline);
+
+        if (m_queryPool)
+        {
+            m_device.destroyQueryPool(m_queryPool);
+        }
+
+        m_device.destroyDescriptorPool(m_descriptorPool);
+
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            m_device.destroyBuffer(m_particleBuffers[i]);
+            m_device.freeMemory(m_particleMemories[i]);
+        }
+
+        m_device.destroyCommandPool(m_computeCommandPool);
+        m_device.destroyCommandPool(m_graphicsCommandPool);
+
+        for (auto framebuffer : m_swapchainFramebuffers)
+        {
+            m_device.destroyFramebuffer(framebuffer);
+        }
+
+        for (auto imageView : m_swapchainImageViews)
+        {
+            m_device.destroyImageView(imageView);
+        }
+
+        m_device.destroyPipeline(m_renderPipeline);
+        m_device.destroyPipeline(m_simulationPipeline);
+        m_pipelineLayoutCache.destroy();
+        m_device.destroyRenderPass(m_renderPass);
+        m_device.destroySwapchainKHR(m_swapchain);
+        m_device.destroy();
+
+#if !defined(NDEBUG)
+        m_debugMessenger.destroy();
+#endif
+        m_instance.destroySurfaceKHR(m_surface);
+        m_instance.destroy();
+    }
+
+    ApplicationSettings m_settings;
+    GLFWwindow*         m_window;
+    vk::Instance        m_instance;
+#if !defined(NDEBUG)
+    DebugMessenger m_debugMessenger; // Outlives the instance, it receives the messages of its destruction
+#endif
+    vk::SurfaceKHR             m_surface;
+    vk::PhysicalDevice         m_physicalDevice;
+    vk::PhysicalDevice         m_secondaryPhysicalDevice; // Only set if the simulation runs on a second device
+    QueueFamilyIndices         m_queueFamilyIndices;
+    uint32_t                   m_computeFamily = 0; // Graphics family without async compute
+    vk::Device                 m_device;
+    vk::Queue                  m_graphicsQueue;
+    vk::Queue                  m_presentQueue;
+    vk::Queue                  m_computeQueue;
+    vk::SwapchainKHR           m_swapchain;
+    vk::Format                 m_swapchainImageFormat;
+    vk::Extent2D               m_swapchainExtent;
+    std::vector<vk::Image>     m_swapchainImages;
+    std::vector<vk::ImageView> m_swapchainImageViews;
+    vk::RenderPass             m_renderPass;
+
+    PipelineLayoutCache     m_pipelineLayoutCache;
+    vk::PipelineLayout      m_simulationPipelineLayout; // Owned by the pipeline layout cache
+    vk::DescriptorSetLayout m_simulationDescriptorLayout;
+    vk::Pipeline            m_simulationPipeline;
+    vk::PipelineLayout      m_renderPipelineLayout;
+    vk::DescriptorSetLayout m_renderDescriptorLayout;
+    vk::Pipeline            m_renderPipeline;
+
+    std::vector<vk::Framebuffer>   m_swapchainFramebuffers;
+    vk::CommandPool                m_graphicsCommandPool;
+    vk::CommandPool                m_computeCommandPool;
+    std::vector<vk::CommandBuffer> m_graphicsCommandBuffers;
+    std::vector<vk::CommandBuffer> m_computeCommandBuffers;
+
+    vk::Buffer         m_particleBuffers[2];
+    vk::DeviceMemory   m_particleMemories[2];
+    vk::DescriptorPool m_descriptorPool;
+    vk::DescriptorSet  m_simulationDescriptorSets[2]; // Indexed by the source buffer
+    vk::DescriptorSet  m_renderDescriptorSets[2];     // Indexed by the rendered buffer
+
+    SecondarySimulation m_secondarySimulation;
+    vk::Buffer          m_uploadBuffers[MAX_FRAMES_IN_FLIGHT];
+    vk::DeviceMemory    m_uploadMemories[MAX_FRAMES_IN_FLIGHT];
+    void*               m_uploadData[MAX_FRAMES_IN_FLIGHT] = {};
+
+    vk::QueryPool                  m_queryPool;
+    float                          m_timestampPeriod     = 1.f; // Nanoseconds per timestamp tick
+    bool                           m_timestampsSupported = false;
+    std::optional<FrameTimestamps> m_previousTimestamps;
+    SimulationStatistics           m_statistics;
+
+    vk::Semaphore         m_imageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];
+    vk::Semaphore         m_renderFinishedSemaphores[MAX_FRAMES_IN_FLIGHT];
+    vk::Semaphore         m_computeTimeline;
+    vk::Semaphore         m_graphicsTimeline;
+    std::vector<uint64_t> m_imageTimelineValues; // Graphics timeline value of the last frame rendering to each image
+    uint32_t              m_currentFrame = 0;
+    uint64_t              m_frameNumber  = 0;
+    Clock::time_point     m_startTime;
+};
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        ComputeParticlesApplication app(parseCommandLine(argc, argv));
+        app.run();
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
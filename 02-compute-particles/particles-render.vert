@@ -0,0 +1,41 @@
+//////////////
+// TYPEDEFS //
+//////////////
+struct Particle
+{
+    float2 position;
+    float2 velocity;
+};
+
+struct VertexInputType
+{
+    uint vertexId : SV_VertexId;
+};
+
+struct PixelInputType
+{
+    float4 position : SV_Position;
+    float4 color : COLOR0;
+    [[vk::builtin("PointSize")]] float pointSize : PSIZE;
+};
+
+// The state written by this frame's simulation, one point per particle
+[[vk::binding(0, 0)]] StructuredBuffer<Particle> particles;
+
+////////////////////////////////////////////////////////////////////////////////
+// Vertex Shader
+////////////////////////////////////////////////////////////////////////////////
+PixelInputType main(VertexInputType input)
+{
+    PixelInputType output;
+
+    Particle particle = particles[input.vertexId];
+    output.position = float4(particle.position, 0.0f, 1.0f);
+    output.pointSize = 1.0f;
+
+    // Slow particles are blue, fast ones orange. Dim, since they are blended additively.
+    float speed = saturate(length(particle.velocity));
+    output.color = float4(lerp(float3(0.1f, 0.3f, 1.0f), float3(1.0f, 0.5f, 0.1f), speed) * 0.2f, 1.0f);
+
+    return output;
+}
@@ -24,8 +24,12 @@ function(add_shader_compile_target TARGET_NAME SHADER_FILES)
 		string(SUBSTRING ${FILE_EXT} 1 -1 FILE_EXT)
 		string(TOUPPER ${FILE_EXT} FILE_EXT)
 		list(APPEND SHADER_COMPILE_DEFINITIONS -DPATH_${FILE_NAME_PLAIN}_${FILE_EXT}="${SPIRV_FILE}")
+		list(APPEND SHADER_COMPILE_DEFINITIONS -DSOURCE_PATH_${FILE_NAME_PLAIN}_${FILE_EXT}="${SHADER_FILE}")
 	endforeach(SHADER_FILE)
 
+	# The compiler is also needed at runtime for recompiling shaders on the fly
+	list(APPEND SHADER_COMPILE_DEFINITIONS -DSHADER_COMPILER="${GLSLANG_VALIDATOR}")
+
 	# Add custom target for the shaders
 	add_custom_target(
     ${TARGET_NAME}-shaders 
@@ -38,6 +42,7 @@ function(add_shader_compile_target TARGET_NAME SHADER_FILES)
 	# so they can be referenced from within the code.
 	# For a shader file named 'triangle-shader.vert' the
 	# corresponding definition is 'PATH_TRIANGLE_SHADER_VERT'
+	# and the path of the source file is 'SOURCE_PATH_TRIANGLE_SHADER_VERT'
 	foreach(SHADER_COMPILE_DEFINITION ${SHADER_COMPILE_DEFINITIONS})
 		target_compile_definitions(${TARGET_NAME} PRIVATE ${SHADER_COMPILE_DEFINITION})
 	endforeach(SHADER_COMPILE_DEFINITION)
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Parses an unsigned command line value and checks that it lies in [minimum, maximum].
+// Signs, trailing characters and values that do not fit are rejected with a message
+// naming the option, rather than the bare "stoul" std::stoul would throw.
+inline uint32_t parseCount(std::string const& option, std::string const& value, uint32_t minimum, uint32_t maximum)
+{
+    bool const digitsOnly = !value.empty() && std::all_of(std::begin(value), std::end(value), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; });
+    if (!digitsOnly)
+    {
+        throw std::runtime_error("invalid value '" + value + "' for option '" + option + "'");
+    }
+
+    // Out of range values are reported with the bounds below.
+    unsigned long long count = ULLONG_MAX;
+    try
+    {
+        count = std::stoull(value);
+    }
+    catch (std::out_of_range const&)
+    {
+    }
+
+    if (count < minimum || count > maximum)
+    {
+        throw std::runtime_error("value for option '" + option + "' must be in [" + std::to_string(minimum) + ", " + std::to_string(maximum) + "]");
+    }
+
+    return static_cast<uint32_t>(count);
+}
@@ -0,0 +1,517 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// What the debug messenger reports and how often
+struct DebugMessengerSettings
+{
+    // Messages below this severity are dropped. Verbose and info messages are plentiful
+    // and slow the layers down as much as the printing, so they are off by default.
+    vk::DebugUtilsMessageSeverityFlagBitsEXT minimumSeverity = vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning;
+    vk::DebugUtilsMessageTypeFlagsEXT        types           = vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral |
+                                                vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation |
+                                                vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance;
+    // Messages printed per message ID and interval, further repeats are only counted
+    uint32_t                  messagesPerInterval = 1;
+    std::chrono::milliseconds interval{1000};
+};
+
+inline vk::DebugUtilsMessageSeverityFlagBitsEXT parseDebugSeverity(std::string const& name)
+{
+    if (name == "verbose")
+    {
+        return vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose;
+    }
+    else if (name == "info")
+    {
+        return vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo;
+    }
+    else if (name == "warning")
+    {
+        return vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning;
+    }
+    else if (name == "error")
+    {
+        return vk::DebugUtilsMessageSeverityFlagBitsEXT::eError;
+    }
+
+    throw std::runtime_error("unknown debug message severity '" + name + "'");
+}
+
+// Comma separated list of "general", "validation" and "performance"
+inline vk::DebugUtilsMessageTypeFlagsEXT parseDebugTypes(std::string const& list)
+{
+    vk::DebugUtilsMessageTypeFlagsEXT types;
+
+    std::istringstream stream(list);
+    std::string        name;
+    while (std::getline(stream, name, ','))
+    {
+        if (name == "general")
+        {
+            types |= vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral;
+        }
+        else if (name == "validation")
+        {
+            types |= vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation;
+        }
+        else if (name == "performance")
+        {
+            types |= vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance;
+        }
+        else
+        {
+            throw std::runtime_error("unknown debug message type '" + name + "'");
+        }
+    }
+
+    return types;
+}
+
+// Receives the messages of the validation layers through VK_EXT_debug_utils without
+// slowing down the threads that trigger them.
+//
+// The callback runs on whichever thread made the Vulkan call. It only filters the message
+// by severity and type, counts it per message ID and, unless the ID is over its rate
+// limit, hands it to a lock-free queue. A logger thread writes the queued messages with
+// one flush per batch, together with the number of repeats suppressed in between.
+// A summary of the most frequent messages is written when the messenger is destroyed.
+//
+// The messenger must outlive the instance if createInfo() was chained into the instance
+// create info, since the layers call it until the instance is destroyed.
+class DebugMessenger
+{
+public:
+    explicit DebugMessenger(DebugMessengerSettings const& settings = DebugMessengerSettings(), std::ostream& stream = std::cerr)
+        : m_settings(settings)
+        , m_stream(stream)
+        , m_counters(new MessageCounter[COUNTER_COUNT])
+    {
+        setFilter(settings.minimumSeverity, settings.types);
+        m_logger = std::thread([this]() { runLogger(); });
+    }
+
+    DebugMessenger(DebugMessenger const&)            = delete;
+    DebugMessenger& operator=(DebugMessenger const&) = delete;
+
+    ~DebugMessenger()
+    {
+        m_stop = true;
+        m_wake.notify_one();
+        m_logger.join();
+
+        writeSummary();
+    }
+
+    // For VkInstanceCreateInfo::pNext, to also receive the messages of instance creation and destruction
+    vk::DebugUtilsMessengerCreateInfoEXT createInfo() const
+    {
+        vk::DebugUtilsMessengerCreateInfoEXT createInfo;
+        createInfo.messageSeverity = vk::DebugUtilsMessageSeverityFlagsEXT(m_severityMask.load());
+        createInfo.messageType     = vk::DebugUtilsMessageTypeFlagsEXT(m_typeMask.load());
+        createInfo.pfnUserCallback = callback;
+        createInfo.pUserData       = const_cast<DebugMessenger*>(this);
+
+        return createInfo;
+    }
+
+    void create(vk::Instance instance)
+    {
+        // The extension commands are loaded once, not on every create and destroy
+        m_instance = instance;
+        m_dispatch = vk::DispatchLoaderDynamic(instance, vkGetInstanceProcAddr);
+
+        auto info              = createInfo();
+        m_messenger            = m_instance.createDebugUtilsMessengerEXT(info, nullptr, m_dispatch);
+        m_registeredSeverities = info.messageSeverity;
+        m_registeredTypes      = info.messageType;
+    }
+
+    void destroy()
+    {
+        if (m_messenger)
+        {
+            m_instance.destroyDebugUtilsMessengerEXT(m_messenger, nullptr, m_dispatch);
+            m_messenger = vk::DebugUtilsMessengerEXT();
+        }
+    }
+
+    // Takes effect immediately for every thread. The layers only generate the messages the
+    // messenger was created for, so widening the filter recreates it, which must not race
+    // with other threads creating or destroying messengers.
+    void setFilter(vk::DebugUtilsMessageSeverityFlagBitsEXT minimumSeverity, vk::DebugUtilsMessageTypeFlagsEXT types)
+    {
+        // Severity bits grow with the severity, so the mask is every bit from the minimum up
+        uint32_t minimum = static_cast<uint32_t>(minimumSeverity);
+        uint32_t all     = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
+                       VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+
+        m_severityMask = all & ~(minimum - 1);
+        m_typeMask     = static_cast<uint32_t>(types);
+
+        bool widened = (vk::DebugUtilsMessageSeverityFlagsEXT(m_severityMask.load()) & ~m_registeredSeverities) ||
+                       (types & ~m_registeredTypes);
+        if (m_messenger && widened)
+        {
+            destroy();
+            create(m_instance);
+        }
+    }
+
+private:
+    static constexpr size_t QUEUE_CAPACITY = 1024; // Power of two
+    static constexpr size_t COUNTER_COUNT  = 1024; // Power of two, distinct message IDs tracked
+
+    struct Message
+    {
+        vk::DebugUtilsMessageSeverityFlagBitsEXT severity = vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose;
+        uint64_t                                 key      = 0;
+        std::string                              idName;
+        std::string                              text;
+        uint64_t                                 suppressed = 0; // Repeats since the last message written with this ID
+    };
+
+    // Per message ID, claimed by the first thread reporting the ID and never released
+    struct MessageCounter
+    {
+        std::atomic<uint64_t> key{0}; // 0 while unused
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> suppressed{0};   // Since the last message queued with this ID
+        std::atomic<int64_t>  windowStart{0};  // Nanoseconds, start of the current rate limit interval
+        std::atomic<uint32_t> windowCount{0};  // Messages in the current interval
+    };
+
+    // Bounded multi-producer single-consumer queue (D. Vyukov). Every cell carries a sequence
+    // number telling producers and the consumer whose turn it is, so neither side locks.
+    class MessageQueue
+    {
+    public:
+        MessageQueue()
+            : m_cells(new Cell[QUEUE_CAPACITY])
+        {
+            for (size_t i = 0; i < QUEUE_CAPACITY; ++i)
+            {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // Fails if the queue is full, producers never wait for the consumer
+        bool push(Message&& message)
+        {
+            size_t position = m_pushPosition.load(std::memory_order_relaxed);
+            Cell*  cell     = nullptr;
+
+            for (;;)
+            {
+                cell              = &m_cells[position & (QUEUE_CAPACITY - 1)];
+                size_t   sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t distance = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+                if (distance == 0)
+                {
+                    if (m_pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (distance < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = m_pushPosition.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->message = std::move(message);
+            cell->sequence.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Only called by the logger thread
+        bool pop(Message& message)
+        {
+            size_t position = m_popPosition.load(std::memory_order_relaxed);
+            Cell&  cell     = m_cells[position & (QUEUE_CAPACITY - 1)];
+
+            if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+            {
+                return false;
+            }
+
+            message = std::move(cell.message);
+            cell.sequence.store(position + QUEUE_CAPACITY, std::memory_order_release);
+            m_popPosition.store(position + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence{0};
+            Message             message;
+        };
+
+        std::unique_ptr<Cell[]> m_cells;
+        alignas(64) std::atomic<size_t> m_pushPosition{0};
+        alignas(64) std::atomic<size_t> m_popPosition{0};
+    };
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL
+    callback(VkDebugUtilsMessageSeverityFlagBitsEXT      messageSeverity,
+             VkDebugUtilsMessageTypeFlagsEXT             messageTypes,
+             VkDebugUtilsMessengerCallbackDataEXT const* pCallbackData,
+             void*                                       pUserData)
+    {
+        static_cast<DebugMessenger*>(pUserData)->receive(messageSeverity, messageTypes, *pCallbackData);
+
+        // The call that triggered the message is never aborted
+        return VK_FALSE;
+    }
+
+    void receive(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT types, VkDebugUtilsMessengerCallbackDataEXT const& data)
+    {
+        if (!(severity & m_severityMask.load(std::memory_order_relaxed)) || !(types & m_typeMask.load(std::memory_order_relaxed)))
+        {
+            return;
+        }
+
+        m_received.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t        key     = messageKey(data);
+        MessageCounter* counter = findCounter(key);
+
+        // Too many distinct IDs to track, written without rate limit
+        uint64_t suppressed = 0;
+        if (counter != nullptr)
+        {
+            counter->count.fetch_add(1, std::memory_order_relaxed);
+
+            if (!withinRateLimit(*counter))
+            {
+                counter->suppressed.fetch_add(1, std::memory_order_relaxed);
+                m_suppressed.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            suppressed = counter->suppressed.exchange(0, std::memory_order_relaxed);
+        }
+
+        Message message;
+        message.severity   = static_cast<vk::DebugUtilsMessageSeverityFlagBitsEXT>(severity);
+        message.key        = key;
+        message.idName     = data.pMessageIdName != nullptr ? data.pMessageIdName : "";
+        message.text       = data.pMessage != nullptr ? data.pMessage : "";
+        message.suppressed = suppressed;
+
+        if (!m_queue.push(std::move(message)))
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        m_wake.notify_one();
+    }
+
+    // Validation messages have a unique ID number, others may only have a name or nothing at all
+    static uint64_t messageKey(VkDebugUtilsMessengerCallbackDataEXT const& data)
+    {
+        uint32_t id = static_cast<uint32_t>(data.messageIdNumber);
+
+        if (id == 0)
+        {
+            char const* name = data.pMessageIdName != nullptr ? data.pMessageIdName : (data.pMessage != nullptr ? data.pMessage : "");
+
+            // FNV-1a
+            id = 2166136261U;
+            for (char const* c = name; *c != '\0'; ++c)
+            {
+                id = (id ^ static_cast<uint8_t>(*c)) * 16777619U;
+            }
+        }
+
+        // Keeps zero free to mark unused counters
+        return (uint64_t(1) << 32) | id;
+    }
+
+    // Open addressing with linear probing, counters are claimed with a compare and swap
+    MessageCounter* findCounter(uint64_t key)
+    {
+        size_t index = static_cast<size_t>(key * 0x9E3779B97F4A7C15ULL >> 32);
+
+        for (size_t probe = 0; probe < COUNTER_COUNT; ++probe)
+        {
+            MessageCounter& counter = m_counters[(index + probe) & (COUNTER_COUNT - 1)];
+
+            uint64_t current = counter.key.load(std::memory_order_acquire);
+            if (current == 0 && counter.key.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+            {
+                return &counter;
+            }
+            if (current == key)
+            {
+                return &counter;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Concurrent reports may let one message more than configured through when an interval
+    // starts, which doesn't matter for a rate limit
+    bool withinRateLimit(MessageCounter& counter)
+    {
+        int64_t now         = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+        int64_t windowStart = counter.windowStart.load(std::memory_order_relaxed);
+        int64_t interval    = std::chrono::duration_cast<std::chrono::nanoseconds>(m_settings.interval).count();
+
+        if ((now - windowStart >= interval || windowStart == 0) && counter.windowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed))
+        {
+            counter.windowCount.store(0, std::memory_order_relaxed);
+        }
+
+        return counter.windowCount.fetch_add(1, std::memory_order_relaxed) < m_settings.messagesPerInterval;
+    }
+
+    void runLogger()
+    {
+        for (;;)
+        {
+            // Checked before draining, so messages queued before stopping are still written
+            bool stopping = m_stop.load();
+
+            writeQueuedMessages();
+
+            if (stopping)
+            {
+                return;
+            }
+
+            // Producers don't take the mutex, a missed notification only delays the next batch
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+
+    void writeQueuedMessages()
+    {
+        Message message;
+        bool    written = false;
+
+        while (m_queue.pop(message))
+        {
+            m_stream << "validation layer [" << severityName(message.severity) << "]";
+            if (!message.idName.empty())
+            {
+                m_stream << " " << message.idName;
+            }
+            m_stream << ": " << message.text;
+            if (message.suppressed > 0)
+            {
+                m_stream << " (" << message.suppressed << " repeats suppressed)";
+            }
+            m_stream << '\n';
+
+            m_names.emplace(message.key, message.idName.empty() ? message.text.substr(0, 80) : message.idName);
+            written = true;
+        }
+
+        if (written)
+        {
+            m_stream.flush();
+        }
+    }
+
+    void writeSummary()
+    {
+        uint64_t received = m_received.load();
+        if (received == 0)
+        {
+            return;
+        }
+
+        m_stream << "debug messages: " << received << " received, " << m_suppressed.load() << " suppressed by rate limit, "
+                 << m_dropped.load() << " dropped with full queue" << std::endl;
+
+        // The most frequent repeated messages, the usual suspects for slow debug builds
+        std::vector<std::pair<uint64_t, uint64_t>> counts; // Count, key
+        for (size_t i = 0; i < COUNTER_COUNT; ++i)
+        {
+            uint64_t count = m_counters[i].count.load();
+            if (count > 1)
+            {
+                counts.emplace_back(count, m_counters[i].key.load());
+            }
+        }
+
+        std::sort(std::begin(counts), std::end(counts), [](auto const& a, auto const& b) { return a.first > b.first; });
+        counts.resize(std::min<size_t>(counts.size(), 10));
+
+        for (auto const& [count, key] : counts)
+        {
+            auto name = m_names.find(key);
+            m_stream << "  " << count << "x  " << (name != std::end(m_names) ? name->second : "<not written>")
+                     << " [0x" << std::hex << static_cast<uint32_t>(key) << std::dec << "]" << std::endl;
+        }
+    }
+
+    static char const* severityName(vk::DebugUtilsMessageSeverityFlagBitsEXT severity)
+    {
+        switch (severity)
+        {
+        case vk::DebugUtilsMessageSeverityFlagBitsEXT::eError:
+            return "error";
+        case vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning:
+            return "warning";
+        case vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo:
+            return "info";
+        default:
+            return "verbose";
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    DebugMessengerSettings m_settings;
+    std::ostream&          m_stream;
+
+    vk::Instance                          m_instance;
+    vk::DispatchLoaderDynamic             m_dispatch;
+    vk::DebugUtilsMessengerEXT            m_messenger;
+    vk::DebugUtilsMessageSeverityFlagsEXT m_registeredSeverities;
+    vk::DebugUtilsMessageTypeFlagsEXT     m_registeredTypes;
+
+    std::atomic<uint32_t> m_severityMask{0};
+    std::atomic<uint32_t> m_typeMask{0};
+
+    std::unique_ptr<MessageCounter[]> m_counters;
+    MessageQueue                      m_queue;
+    std::atomic<uint64_t>             m_received{0};
+    std::atomic<uint64_t>             m_suppressed{0};
+    std::atomic<uint64_t>             m_dropped{0};
+
+    // Only accessed by the logger thread, and after it has been joined
+    std::map<uint64_t, std::string> m_names; // Per message key, for the summary
+
+    std::atomic<bool>       m_stop{false};
+    std::mutex              m_wakeMutex;
+    std::condition_variable m_wake;
+    std::thread             m_logger;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+// Defers the destruction of GPU resources until the GPU is done with them.
+//
+// Each deleter is tagged with a timeline value (e.g. the value of the last submission
+// that may still reference the resource) and runs once the completed value reported
+// by the queue's timeline semaphore has reached it. Values are expected to be pushed
+// in non-decreasing order, which holds when tagging with the last submitted value.
+//
+// Not thread-safe, push and collect from the thread that submits work.
+class DeletionQueue
+{
+public:
+    void push(uint64_t timelineValue, std::function<void()> deleter)
+    {
+        m_entries.push_back({timelineValue, std::move(deleter)});
+    }
+
+    // Run all deleters with a timeline value less or equal to completedValue.
+    // Returns the number of deleters that ran.
+    size_t collect(uint64_t completedValue)
+    {
+        size_t count = 0;
+
+        while (!m_entries.empty() && m_entries.front().timelineValue <= completedValue)
+        {
+            // Pop before running, so a deleter may safely push new entries
+            auto deleter = std::move(m_entries.front().deleter);
+            m_entries.pop_front();
+
+            deleter();
+            ++count;
+        }
+
+        return count;
+    }
+
+    // Run all remaining deleters, the device must be idle.
+    void flush()
+    {
+        collect(UINT64_MAX);
+    }
+
+    size_t size() const
+    {
+        return m_entries.size();
+    }
+
+    bool empty() const
+    {
+        return m_entries.empty();
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t              timelineValue;
+        std::function<void()> deleter;
+    };
+
+    std::deque<Entry> m_entries;
+};
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A physical device together with everything the ranking is based on
+struct DeviceCandidate
+{
+    vk::PhysicalDevice                device;
+    uint32_t                          index = 0; // position in enumeratePhysicalDevices()
+    vk::PhysicalDeviceProperties      properties;
+    std::array<uint8_t, VK_UUID_SIZE> uuid{};
+    vk::DeviceSize                    deviceLocalMemory = 0; // size of the largest device local heap
+    bool                              dedicatedCompute  = false;
+    bool                              dedicatedTransfer = false;
+    bool                              suitable          = false;
+    int64_t                           score             = 0;
+
+    std::string name() const
+    {
+        return properties.deviceName.data();
+    }
+};
+
+inline std::string formatUuid(std::array<uint8_t, VK_UUID_SIZE> const& uuid)
+{
+    std::ostringstream stream;
+    stream << std::hex << std::setfill('0');
+
+    for (size_t i = 0; i < uuid.size(); ++i)
+    {
+        if (i == 4 || i == 6 || i == 8 || i == 10)
+        {
+            stream << '-';
+        }
+        stream << std::setw(2) << static_cast<uint32_t>(uuid[i]);
+    }
+
+    return stream.str();
+}
+
+inline char const* deviceTypeName(vk::PhysicalDeviceType type)
+{
+    switch (type)
+    {
+    case vk::PhysicalDeviceType::eDiscreteGpu:
+        return "discrete";
+    case vk::PhysicalDeviceType::eIntegratedGpu:
+        return "integrated";
+    case vk::PhysicalDeviceType::eVirtualGpu:
+        return "virtual";
+    case vk::PhysicalDeviceType::eCpu:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+// Heuristic score of a device, higher is better.
+//
+// The device type dominates, so a discrete GPU always wins over an integrated one even if
+// the integrated one reports more (shared) device local memory. Within a type, memory,
+// limits and dedicated queue families break ties.
+inline int64_t scoreDevice(DeviceCandidate const& candidate)
+{
+    int64_t score = 0;
+
+    switch (candidate.properties.deviceType)
+    {
+    case vk::PhysicalDeviceType::eDiscreteGpu:
+        score += 1000000;
+        break;
+    case vk::PhysicalDeviceType::eIntegratedGpu:
+        score += 100000;
+        break;
+    case vk::PhysicalDeviceType::eVirtualGpu:
+        score += 50000;
+        break;
+    default:
+        break;
+    }
+
+    // One point per MiB, capped so memory never outweighs the device type
+    score += static_cast<int64_t>(std::min<vk::DeviceSize>(candidate.deviceLocalMemory >> 20, 49999));
+
+    auto const& limits = candidate.properties.limits;
+    score += limits.maxImageDimension2D / 64;
+    score += limits.maxComputeSharedMemorySize / 1024;
+
+    if (candidate.dedicatedCompute)
+    {
+        score += 500;
+    }
+    if (candidate.dedicatedTransfer)
+    {
+        score += 250;
+    }
+
+    return score;
+}
+
+// Collect, score and sort all physical devices of the instance, best first.
+// Unsuitable devices are kept in the list (for logging) but ranked after all suitable ones.
+// The optional extra score lets an application reward features it can make use of.
+inline std::vector<DeviceCandidate> rankPhysicalDevices(vk::Instance const&                                      instance,
+                                                        std::function<bool(vk::PhysicalDevice const&)> const&    isSuitable,
+                                                        std::function<int64_t(vk::PhysicalDevice const&)> const& extraScore = {})
+{
+    auto physicalDevices = instance.enumeratePhysicalDevices();
+
+    std::vector<DeviceCandidate> candidates;
+    candidates.reserve(physicalDevices.size());
+
+    for (uint32_t i = 0; i < physicalDevices.size(); ++i)
+    {
+        DeviceCandidate candidate;
+        candidate.device     = physicalDevices[i];
+        candidate.index      = i;
+        candidate.properties = candidate.device.getProperties();
+
+        // The device UUID is core since Vulkan 1.1
+        if (candidate.properties.apiVersion >= VK_API_VERSION_1_1)
+        {
+            auto properties = candidate.device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+            auto const& id  = properties.get<vk::PhysicalDeviceIDProperties>();
+            std::copy(std::begin(id.deviceUUID), std::end(id.deviceUUID), std::begin(candidate.uuid));
+        }
+
+        auto memoryProperties = candidate.device.getMemoryProperties();
+        for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; ++heap)
+        {
+            if (memoryProperties.memoryHeaps[heap].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+            {
+                candidate.deviceLocalMemory = std::max(candidate.deviceLocalMemory, memoryProperties.memoryHeaps[heap].size);
+            }
+        }
+
+        for (auto const& family : candidate.device.getQueueFamilyProperties())
+        {
+            bool graphics = static_cast<bool>(family.queueFlags & vk::QueueFlagBits::eGraphics);
+            bool compute  = static_cast<bool>(family.queueFlags & vk::QueueFlagBits::eCompute);
+            bool transfer = static_cast<bool>(family.queueFlags & vk::QueueFlagBits::eTransfer);
+
+            candidate.dedicatedCompute  = candidate.dedicatedCompute || (compute && !graphics);
+            candidate.dedicatedTransfer = candidate.dedicatedTransfer || (transfer && !compute && !graphics);
+        }
+
+        candidate.suitable = isSuitable(candidate.device);
+        candidate.score    = scoreDevice(candidate) + (extraScore ? extraScore(candidate.device) : 0);
+
+        candidates.push_back(candidate);
+    }
+
+    std::stable_sort(std::begin(candidates), std::end(candidates), [](auto const& a, auto const& b) {
+        if (a.suitable != b.suitable)
+        {
+            return a.suitable;
+        }
+        return a.score > b.score;
+    });
+
+    return candidates;
+}
+
+enum class SelectorMatch
+{
+    None,
+    Name,  // The selector is a case-insensitive part of the device name
+    Exact, // The selector is the enumeration index or the UUID of the device
+};
+
+// A device selector is either the enumeration index, the device UUID (with or
+// without dashes) or a case-insensitive part of the device name. All-digit selectors
+// can be both an index and a part of a name (e.g. "4090"), exact matches take precedence.
+inline SelectorMatch matchDeviceSelector(DeviceCandidate const& candidate, std::string const& selector)
+{
+    auto lower = [](std::string text) {
+        std::transform(std::begin(text), std::end(text), std::begin(text), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    };
+
+    if (!selector.empty() && std::all_of(std::begin(selector), std::end(selector), [](unsigned char c) { return std::isdigit(c); }))
+    {
+        // Digit strings too long for an integer can't be an index either
+        std::optional<unsigned long long> index;
+        try
+        {
+            index = std::stoull(selector);
+        }
+        catch (std::out_of_range const&)
+        {
+        }
+
+        if (index && index.value() == candidate.index)
+        {
+            return SelectorMatch::Exact;
+        }
+    }
+
+    auto withoutDashes = [](std::string text) {
+        text.erase(std::remove(std::begin(text), std::end(text), '-'), std::end(text));
+        return text;
+    };
+
+    if (lower(withoutDashes(selector)) == withoutDashes(formatUuid(candidate.uuid)))
+    {
+        return SelectorMatch::Exact;
+    }
+
+    return lower(candidate.name()).find(lower(selector)) != std::string::npos ? SelectorMatch::Name : SelectorMatch::None;
+}
+
+// The strongest match of the selector among the candidates, so "--device 0" means index 0
+// even if a better ranked device has a 0 in its name.
+inline SelectorMatch bestSelectorMatch(std::vector<DeviceCandidate> const& candidates, std::string const& selector)
+{
+    SelectorMatch best = SelectorMatch::None;
+    for (auto const& candidate : candidates)
+    {
+        best = std::max(best, matchDeviceSelector(candidate, selector));
+    }
+    return best;
+}
+
+// Pick the best suitable device, or the best suitable device matching the selector.
+inline DeviceCandidate const* findDevice(std::vector<DeviceCandidate> const& ranking, std::optional<std::string> const& selector)
+{
+    // Resolved over the whole ranking first, an unsuitable exact match must not fall back to a name match
+    SelectorMatch required = selector ? bestSelectorMatch(ranking, selector.value()) : SelectorMatch::None;
+    if (selector && required == SelectorMatch::None)
+    {
+        return nullptr;
+    }
+
+    for (auto const& candidate : ranking)
+    {
+        if (candidate.suitable && (!selector || matchDeviceSelector(candidate, selector.value()) == required))
+        {
+            return &candidate;
+        }
+    }
+
+    return nullptr;
+}
+
+inline void logDeviceRanking(std::ostream& stream, std::vector<DeviceCandidate> const& ranking, DeviceCandidate const* selected)
+{
+    stream << "physical devices (best first):" << std::endl;
+
+    for (auto const& candidate : ranking)
+    {
+        stream << (&candidate == selected ? "  * " : "    ")
+               << "[" << candidate.index << "] " << candidate.name()
+               << " (" << deviceTypeName(candidate.properties.deviceType)
+               << ", " << (candidate.deviceLocalMemory >> 20) << " MiB"
+               << ", uuid " << formatUuid(candidate.uuid) << ")";
+
+        if (candidate.suitable)
+        {
+            stream << " score " << candidate.score << std::endl;
+        }
+        else
+        {
+            stream << " not suitable" << std::endl;
+        }
+    }
+}
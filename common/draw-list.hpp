@@ -0,0 +1,223 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Sort key of a draw, compared as a single 64-bit integer. From most to least significant:
+//
+//   pass (4 bits) | pipeline (16 bits) | descriptor set (16 bits) | depth (28 bits)
+//
+// Pipeline and descriptor set are small ids assigned by the caller, draws with equal ids
+// share the same object, so sorting groups them and makes consecutive binds redundant.
+// Depth in [0, 1] is quantized, lower depths sort first (front to back).
+struct DrawKey
+{
+    static constexpr uint32_t PASS_BITS           = 4;
+    static constexpr uint32_t PIPELINE_BITS       = 16;
+    static constexpr uint32_t DESCRIPTOR_SET_BITS = 16;
+    static constexpr uint32_t DEPTH_BITS          = 28;
+
+    static constexpr uint64_t make(uint32_t pass, uint32_t pipelineId, uint32_t descriptorSetId, float depth = 0.0f)
+    {
+        // Quantized in double: in float, 1.0 * (2^28 - 1) rounds up to 2^28 and would carry into
+        // the descriptor set. The comparison also maps NaN to 0, and the integer is clamped as well.
+        constexpr uint32_t depthMax  = (1U << DEPTH_BITS) - 1;
+        double             clamped   = depth > 0.0f ? std::min(static_cast<double>(depth), 1.0) : 0.0;
+        uint64_t           depthBits = std::min<uint64_t>(static_cast<uint64_t>(clamped * depthMax), depthMax);
+
+        return (static_cast<uint64_t>(pass & ((1U << PASS_BITS) - 1)) << (PIPELINE_BITS + DESCRIPTOR_SET_BITS + DEPTH_BITS)) |
+               (static_cast<uint64_t>(pipelineId & ((1U << PIPELINE_BITS) - 1)) << (DESCRIPTOR_SET_BITS + DEPTH_BITS)) |
+               (static_cast<uint64_t>(descriptorSetId & ((1U << DESCRIPTOR_SET_BITS) - 1)) << DEPTH_BITS) |
+               depthBits;
+    }
+};
+
+// The farthest depth fills the depth field without touching the descriptor set
+static_assert(DrawKey::make(0, 0, 0, 1.0f) == (1U << DrawKey::DEPTH_BITS) - 1, "depth 1.0 must quantize to the largest depth");
+static_assert(DrawKey::make(0, 0, 6, 1.0f) >> DrawKey::DEPTH_BITS == 6, "depth 1.0 must not carry into the descriptor set");
+static_assert(DrawKey::make(0, 0, 0, 0.5f) < DrawKey::make(0, 0, 0, 1.0f), "depths must sort front to back");
+static_assert(DrawKey::make(0, 0, 0, 2.0f) == DrawKey::make(0, 0, 0, 1.0f) && DrawKey::make(0, 0, 0, -1.0f) == 0, "depth must be clamped to [0, 1]");
+
+// Everything needed to record one draw
+struct DrawCommand
+{
+    static constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 32;
+
+    vk::Pipeline       pipeline;
+    vk::PipelineLayout layout;
+    vk::DescriptorSet  descriptorSet; // Bound to set 0, optional
+
+    vk::ShaderStageFlags                        pushConstantStages;
+    uint32_t                                    pushConstantSize = 0;
+    std::array<uint8_t, MAX_PUSH_CONSTANT_SIZE> pushConstants{};
+
+    uint32_t vertexCount   = 0;
+    uint32_t instanceCount = 1;
+    uint32_t firstVertex   = 0;
+    uint32_t firstInstance = 0;
+
+    // Optional predicate for conditional rendering (VK_EXT_conditional_rendering),
+    // the draw is discarded by the GPU if the 32-bit value at the offset is zero
+    vk::Buffer     conditionBuffer;
+    vk::DeviceSize conditionOffset = 0;
+
+    template<typename T>
+    void setPushConstants(vk::ShaderStageFlags stages, T const& value)
+    {
+        static_assert(sizeof(T) <= MAX_PUSH_CONSTANT_SIZE, "push constants too large for a draw command");
+        pushConstantStages = stages;
+        pushConstantSize   = sizeof(T);
+        std::memcpy(pushConstants.data(), &value, sizeof(T));
+    }
+};
+
+// Bind calls issued to the command buffer and those skipped because the state was already bound
+struct DrawListStatistics
+{
+    uint64_t draws                    = 0;
+    uint64_t pipelineBinds            = 0;
+    uint64_t pipelineBindsElided      = 0;
+    uint64_t descriptorSetBinds       = 0;
+    uint64_t descriptorSetBindsElided = 0;
+    uint64_t conditionalDraws         = 0; // Draws the GPU may discard
+};
+
+// Collects the draws of a frame, sorts them by key and records them with redundant binds removed.
+// Meant to be cleared and refilled every frame, the storage is kept between frames.
+class DrawList
+{
+public:
+    void clear()
+    {
+        m_keys.clear();
+        m_commands.clear();
+    }
+
+    void add(uint64_t key, DrawCommand const& command)
+    {
+        m_keys.push_back({key, static_cast<uint32_t>(m_commands.size())});
+        m_commands.push_back(command);
+    }
+
+    size_t size() const
+    {
+        return m_commands.size();
+    }
+
+    // Stable LSD radix sort over the key bytes, draws with equal keys keep their submission order
+    void sort()
+    {
+        m_scratch.resize(m_keys.size());
+
+        for (uint32_t shift = 0; shift < 64; shift += 8)
+        {
+            std::array<uint32_t, 256> counts{};
+            for (auto const& entry : m_keys)
+            {
+                ++counts[(entry.key >> shift) & 0xFF];
+            }
+
+            // All keys share this byte, the pass wouldn't change the order
+            if (std::find(std::begin(counts), std::end(counts), static_cast<uint32_t>(m_keys.size())) != std::end(counts))
+            {
+                continue;
+            }
+
+            uint32_t offset = 0;
+            for (auto& count : counts)
+            {
+                uint32_t bucketSize = count;
+                count               = offset;
+                offset += bucketSize;
+            }
+
+            for (auto const& entry : m_keys)
+            {
+                m_scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+            }
+
+            std::swap(m_keys, m_scratch);
+        }
+    }
+
+    // Record the draws in key order (submission order if not sorted), skipping binds of state
+    // that is already bound. Nothing is assumed about the state bound before.
+    // Draws with a condition need a dispatcher with the conditional rendering commands loaded.
+    void record(vk::CommandBuffer commandBuffer, DrawListStatistics& statistics, vk::DispatchLoaderDynamic const* dispatch = nullptr) const
+    {
+        vk::Pipeline       boundPipeline;
+        vk::PipelineLayout boundLayout;
+        vk::DescriptorSet  boundDescriptorSet;
+
+        for (auto const& entry : m_keys)
+        {
+            auto const& command = m_commands[entry.index];
+
+            if (command.pipeline != boundPipeline)
+            {
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, command.pipeline);
+                boundPipeline = command.pipeline;
+                ++statistics.pipelineBinds;
+            }
+            else
+            {
+                ++statistics.pipelineBindsElided;
+            }
+
+            // A set stays bound across pipelines as long as their layouts are compatible,
+            // which is only assumed for the same layout here
+            if (command.descriptorSet)
+            {
+                if (command.descriptorSet != boundDescriptorSet || command.layout != boundLayout)
+                {
+                    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, command.layout, 0, {command.descriptorSet}, {});
+                    boundDescriptorSet = command.descriptorSet;
+                    boundLayout        = command.layout;
+                    ++statistics.descriptorSetBinds;
+                }
+                else
+                {
+                    ++statistics.descriptorSetBindsElided;
+                }
+            }
+
+            if (command.pushConstantSize > 0)
+            {
+                commandBuffer.pushConstants(command.layout, command.pushConstantStages, 0, command.pushConstantSize, command.pushConstants.data());
+            }
+
+            if (command.conditionBuffer)
+            {
+                vk::ConditionalRenderingBeginInfoEXT conditionInfo;
+                conditionInfo.buffer = command.conditionBuffer;
+                conditionInfo.offset = command.conditionOffset;
+
+                commandBuffer.beginConditionalRenderingEXT(conditionInfo, *dispatch);
+                commandBuffer.draw(command.vertexCount, command.instanceCount, command.firstVertex, command.firstInstance);
+                commandBuffer.endConditionalRenderingEXT(*dispatch);
+                ++statistics.conditionalDraws;
+            }
+            else
+            {
+                commandBuffer.draw(command.vertexCount, command.instanceCount, command.firstVertex, command.firstInstance);
+            }
+            ++statistics.draws;
+        }
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t index; // Into m_commands
+    };
+
+    std::vector<Entry>       m_keys;
+    std::vector<Entry>       m_scratch;
+    std::vector<DrawCommand> m_commands;
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Watches a set of files and invokes a callback on its own thread whenever some of them changed.
+//
+// Editors often save by writing a temporary file and renaming it, so the parent
+// directories are watched instead of the files themselves. Changes arriving in quick
+// succession are collected into a single callback invocation.
+//
+// Only implemented with inotify on Linux, on other platforms the watcher does nothing.
+class FileWatcher
+{
+public:
+    using Callback = std::function<void(std::set<std::string> const& changedFiles)>;
+
+    FileWatcher(std::vector<std::string> const& files, Callback callback)
+        : m_files(std::begin(files), std::end(files))
+        , m_callback(std::move(callback))
+    {
+#if defined(__linux__)
+        m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotify < 0)
+        {
+            std::cerr << "failed to initialize inotify, file watching disabled." << std::endl;
+            return;
+        }
+
+        for (auto const& file : m_files)
+        {
+            std::string directory = parentDirectory(file);
+            if (std::find_if(std::begin(m_directories), std::end(m_directories), [&](auto const& d) { return d.second == directory; }) != std::end(m_directories))
+            {
+                continue;
+            }
+
+            int watch = inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (watch < 0)
+            {
+                std::cerr << "failed to watch directory '" << directory << "'." << std::endl;
+                continue;
+            }
+
+            m_directories[watch] = directory;
+        }
+
+        m_thread = std::thread([this]() { run(); });
+#else
+        std::cerr << "file watching is not supported on this platform." << std::endl;
+#endif
+    }
+
+    ~FileWatcher()
+    {
+        m_stop = true;
+
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+
+#if defined(__linux__)
+        if (m_inotify >= 0)
+        {
+            close(m_inotify);
+        }
+#endif
+    }
+
+    FileWatcher(FileWatcher const&) = delete;
+    FileWatcher& operator=(FileWatcher const&) = delete;
+
+private:
+    static std::string parentDirectory(std::string const& file)
+    {
+        auto separator = file.find_last_of("/\\");
+        return separator == std::string::npos ? std::string(".") : file.substr(0, separator);
+    }
+
+#if defined(__linux__)
+    void run()
+    {
+        // Short timeouts, so the thread notices when it should stop
+        constexpr int POLL_TIMEOUT_MS = 100;
+        constexpr int SETTLE_TIME_MS  = 50;
+
+        std::set<std::string> changedFiles;
+
+        while (!m_stop)
+        {
+            pollfd descriptor{m_inotify, POLLIN, 0};
+            int    ready = poll(&descriptor, 1, changedFiles.empty() ? POLL_TIMEOUT_MS : SETTLE_TIME_MS);
+
+            if (ready > 0)
+            {
+                readEvents(changedFiles);
+            }
+            else if (ready == 0 && !changedFiles.empty())
+            {
+                // Nothing changed for a while, report the collected changes
+                m_callback(changedFiles);
+                changedFiles.clear();
+            }
+        }
+    }
+
+    void readEvents(std::set<std::string>& changedFiles)
+    {
+        alignas(inotify_event) char buffer[4096];
+
+        ssize_t length;
+        while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* p = buffer; p < buffer + length;)
+            {
+                auto const* event = reinterpret_cast<inotify_event const*>(p);
+                p += sizeof(inotify_event) + event->len;
+
+                auto directory = m_directories.find(event->wd);
+                if (event->len == 0 || directory == std::end(m_directories))
+                {
+                    continue;
+                }
+
+                std::string file = directory->second + "/" + event->name;
+                if (m_files.count(file) > 0)
+                {
+                    changedFiles.insert(file);
+                }
+            }
+        }
+    }
+
+    int                        m_inotify = -1;
+    std::map<int, std::string> m_directories;
+#endif
+
+    std::set<std::string> m_files;
+    Callback              m_callback;
+    std::atomic<bool>     m_stop{false};
+    std::thread           m_thread;
+};
@@ -0,0 +1,419 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Capture of the commands of a single frame, together with everything needed to execute them
+// again without the application: the pipelines they bind (SPIR-V and fixed function state) and
+// the format and size of the image they render to.
+//
+// File layout, values in host byte order:
+//
+//   uint32 magic ("VKFC"), uint32 version
+//   chunks: uint32 type, uint32 payload size in bytes, payload
+//     RenderTarget: uint32 format, uint32 width, uint32 height
+//     Pipeline:     uint32 id, uint32 topology, uint32 polygon mode, uint32 cull mode, uint32 front face,
+//                   uint32 vertex shader size, SPIR-V, uint32 fragment shader size, SPIR-V
+//     Commands:     uint32 opcode followed by its operands, see CaptureCommand
+//
+// Unknown chunks are skipped when loading, so new ones can be added without breaking older captures.
+
+constexpr uint32_t CAPTURE_MAGIC   = 0x43464B56; // "VKFC"
+constexpr uint32_t CAPTURE_VERSION = 1;
+
+enum class CaptureChunk : uint32_t
+{
+    RenderTarget = 1,
+    Pipeline     = 2,
+    Commands     = 3,
+};
+
+enum class CaptureCommand : uint32_t
+{
+    BeginRenderPass = 1, // float clear color[4], the render area is the whole render target
+    EndRenderPass   = 2,
+    BindPipeline    = 3, // uint32 pipeline id
+    Draw            = 4, // uint32 vertex count, instance count, first vertex, first instance
+};
+
+// Growable byte buffer with typed reads and writes of trivially copyable values
+class CaptureStream
+{
+public:
+    template<typename T>
+    void write(T const& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be captured");
+        writeBytes(&value, sizeof(T));
+    }
+
+    void writeBytes(void const* data, size_t size)
+    {
+        auto const* bytes = static_cast<uint8_t const*>(data);
+        m_data.insert(std::end(m_data), bytes, bytes + size);
+    }
+
+    template<typename T>
+    T read()
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be captured");
+        T value;
+        readBytes(&value, sizeof(T));
+        return value;
+    }
+
+    void readBytes(void* data, size_t size)
+    {
+        if (size > m_data.size() - m_readOffset)
+        {
+            throw std::runtime_error("capture is truncated");
+        }
+
+        std::memcpy(data, m_data.data() + m_readOffset, size);
+        m_readOffset += size;
+    }
+
+    void append(CaptureStream const& other)
+    {
+        m_data.insert(std::end(m_data), std::begin(other.m_data), std::end(other.m_data));
+    }
+
+    void clear()
+    {
+        m_data.clear();
+        m_readOffset = 0;
+    }
+
+    bool atEnd() const
+    {
+        return m_readOffset == m_data.size();
+    }
+
+    std::vector<uint8_t> const& data() const
+    {
+        return m_data;
+    }
+
+    std::vector<uint8_t>& data()
+    {
+        return m_data;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+    size_t               m_readOffset = 0;
+};
+
+// What is needed to create a captured pipeline again. The layout and vertex input are derived
+// from the shaders, the remaining state is the one the samples use.
+struct CapturedPipeline
+{
+    std::vector<char>     vertexShader;
+    std::vector<char>     fragmentShader;
+    vk::PrimitiveTopology topology    = vk::PrimitiveTopology::eTriangleList;
+    vk::PolygonMode       polygonMode = vk::PolygonMode::eFill;
+    vk::CullModeFlags     cullMode    = vk::CullModeFlagBits::eBack;
+    vk::FrontFace         frontFace   = vk::FrontFace::eClockwise;
+};
+
+// Commands captured from one command buffer
+struct CommandCapture
+{
+    CaptureStream      commands;
+    std::set<uint32_t> pipelines; // Ids of the pipelines bound by the commands
+
+    void clear()
+    {
+        commands.clear();
+        pipelines.clear();
+    }
+};
+
+// Knows the captured state of all pipelines that may be bound while capturing and writes the capture files.
+// Pipelines are registered when they are created, which may happen on any thread.
+class FrameCapture
+{
+public:
+    void registerPipeline(vk::Pipeline pipeline, CapturedPipeline description)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Handles may be reused after a pipeline was destroyed, the newest registration wins
+        uint32_t id     = m_nextId++;
+        m_ids[pipeline] = id;
+        m_pipelines.emplace(id, std::move(description));
+    }
+
+    // Call when a pipeline is destroyed or handed to a deletion queue. Pipelines are only replaced
+    // between frames, so a frame being captured never refers to an unregistered one.
+    void unregisterPipeline(vk::Pipeline pipeline)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_ids.find(pipeline);
+        if (it != std::end(m_ids))
+        {
+            m_pipelines.erase(it->second);
+            m_ids.erase(it);
+        }
+    }
+
+    uint32_t pipelineId(vk::Pipeline pipeline) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_ids.find(pipeline);
+        if (it == std::end(m_ids))
+        {
+            throw std::runtime_error("bound pipeline was not registered for capturing");
+        }
+        return it->second;
+    }
+
+    void save(std::string const& path, vk::Format format, vk::Extent2D extent, CommandCapture const& frame) const
+    {
+        CaptureStream file;
+        file.write(CAPTURE_MAGIC);
+        file.write(CAPTURE_VERSION);
+
+        CaptureStream renderTarget;
+        renderTarget.write(static_cast<uint32_t>(format));
+        renderTarget.write(extent.width);
+        renderTarget.write(extent.height);
+        writeChunk(file, CaptureChunk::RenderTarget, renderTarget);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            // Only the pipelines the frame uses, not every one ever registered
+            for (uint32_t id : frame.pipelines)
+            {
+                auto const& pipeline = m_pipelines.at(id);
+
+                CaptureStream chunk;
+                chunk.write(id);
+                chunk.write(static_cast<uint32_t>(pipeline.topology));
+                chunk.write(static_cast<uint32_t>(pipeline.polygonMode));
+                chunk.write(static_cast<uint32_t>(static_cast<VkCullModeFlags>(pipeline.cullMode)));
+                chunk.write(static_cast<uint32_t>(pipeline.frontFace));
+                chunk.write(static_cast<uint32_t>(pipeline.vertexShader.size()));
+                chunk.writeBytes(pipeline.vertexShader.data(), pipeline.vertexShader.size());
+                chunk.write(static_cast<uint32_t>(pipeline.fragmentShader.size()));
+                chunk.writeBytes(pipeline.fragmentShader.data(), pipeline.fragmentShader.size());
+                writeChunk(file, CaptureChunk::Pipeline, chunk);
+            }
+        }
+
+        writeChunk(file, CaptureChunk::Commands, frame.commands);
+
+        std::ofstream stream(path, std::ios_base::binary);
+        if (!stream.is_open())
+        {
+            throw std::runtime_error("failed to open capture file '" + path + "'");
+        }
+        stream.write(reinterpret_cast<char const*>(file.data().data()), file.data().size());
+    }
+
+private:
+    static void writeChunk(CaptureStream& file, CaptureChunk type, CaptureStream const& payload)
+    {
+        file.write(static_cast<uint32_t>(type));
+        file.write(static_cast<uint32_t>(payload.data().size()));
+        file.append(payload);
+    }
+
+    mutable std::mutex                   m_mutex;
+    std::map<vk::Pipeline, uint32_t>     m_ids;
+    std::map<uint32_t, CapturedPipeline> m_pipelines; // By id, only the registered ones
+    uint32_t                             m_nextId = 0;
+};
+
+// Forwards the commands to a command buffer and, if a capture is given, also appends them to it.
+// Without a capture, the only overhead is a branch per command.
+class CapturingCommandBuffer
+{
+public:
+    CapturingCommandBuffer(vk::CommandBuffer commandBuffer, FrameCapture const* frameCapture, CommandCapture* capture)
+        : m_commandBuffer(commandBuffer)
+        , m_frameCapture(frameCapture)
+        , m_capture(frameCapture != nullptr ? capture : nullptr)
+    {
+    }
+
+    void beginRenderPass(vk::RenderPassBeginInfo const& renderPassInfo, vk::SubpassContents contents)
+    {
+        m_commandBuffer.beginRenderPass(renderPassInfo, contents);
+
+        if (m_capture)
+        {
+            std::array<float, 4> clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+            if (renderPassInfo.clearValueCount > 0)
+            {
+                std::memcpy(clearColor.data(), &renderPassInfo.pClearValues[0].color.float32[0], sizeof(clearColor));
+            }
+
+            m_capture->commands.write(CaptureCommand::BeginRenderPass);
+            m_capture->commands.write(clearColor);
+        }
+    }
+
+    void endRenderPass()
+    {
+        m_commandBuffer.endRenderPass();
+
+        if (m_capture)
+        {
+            m_capture->commands.write(CaptureCommand::EndRenderPass);
+        }
+    }
+
+    void bindPipeline(vk::PipelineBindPoint bindPoint, vk::Pipeline pipeline)
+    {
+        m_commandBuffer.bindPipeline(bindPoint, pipeline);
+
+        if (m_capture)
+        {
+            if (bindPoint != vk::PipelineBindPoint::eGraphics)
+            {
+                throw std::runtime_error("only graphics pipelines can be captured");
+            }
+
+            uint32_t id = m_frameCapture->pipelineId(pipeline);
+            m_capture->commands.write(CaptureCommand::BindPipeline);
+            m_capture->commands.write(id);
+            m_capture->pipelines.insert(id);
+        }
+    }
+
+    void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+    {
+        m_commandBuffer.draw(vertexCount, instanceCount, firstVertex, firstInstance);
+
+        if (m_capture)
+        {
+            m_capture->commands.write(CaptureCommand::Draw);
+            m_capture->commands.write(std::array<uint32_t, 4>{vertexCount, instanceCount, firstVertex, firstInstance});
+        }
+    }
+
+    // The commands of the secondary command buffer are inlined into the capture,
+    // which only knows primary command buffers
+    void executeCommands(vk::CommandBuffer secondary, CommandCapture const* secondaryCapture)
+    {
+        m_commandBuffer.executeCommands({secondary});
+
+        if (m_capture)
+        {
+            if (secondaryCapture == nullptr)
+            {
+                throw std::runtime_error("secondary command buffer was not captured");
+            }
+
+            m_capture->commands.append(secondaryCapture->commands);
+            m_capture->pipelines.insert(std::begin(secondaryCapture->pipelines), std::end(secondaryCapture->pipelines));
+        }
+    }
+
+private:
+    vk::CommandBuffer   m_commandBuffer;
+    FrameCapture const* m_frameCapture;
+    CommandCapture*     m_capture;
+};
+
+// A capture file read back into memory
+struct FrameCaptureFile
+{
+    vk::Format                           format = vk::Format::eUndefined;
+    vk::Extent2D                         extent;
+    std::map<uint32_t, CapturedPipeline> pipelines;
+    CaptureStream                        commands;
+};
+
+inline FrameCaptureFile loadFrameCapture(std::string const& path)
+{
+    std::ifstream stream(path, std::ios_base::ate | std::ios_base::binary);
+    if (!stream.is_open())
+    {
+        throw std::runtime_error("failed to open capture file '" + path + "'");
+    }
+
+    CaptureStream file;
+    file.data().resize(static_cast<size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char*>(file.data().data()), file.data().size());
+
+    if (file.read<uint32_t>() != CAPTURE_MAGIC)
+    {
+        throw std::runtime_error("'" + path + "' is not a frame capture");
+    }
+    if (file.read<uint32_t>() != CAPTURE_VERSION)
+    {
+        throw std::runtime_error("unsupported version of frame capture '" + path + "'");
+    }
+
+    FrameCaptureFile capture;
+    bool             hasRenderTarget = false;
+
+    while (!file.atEnd())
+    {
+        auto type = file.read<CaptureChunk>();
+
+        CaptureStream chunk;
+        chunk.data().resize(file.read<uint32_t>());
+        file.readBytes(chunk.data().data(), chunk.data().size());
+
+        switch (type)
+        {
+        case CaptureChunk::RenderTarget:
+            capture.format        = static_cast<vk::Format>(chunk.read<uint32_t>());
+            capture.extent.width  = chunk.read<uint32_t>();
+            capture.extent.height = chunk.read<uint32_t>();
+            hasRenderTarget       = true;
+            break;
+        case CaptureChunk::Pipeline:
+        {
+            uint32_t          id       = chunk.read<uint32_t>();
+            CapturedPipeline& pipeline = capture.pipelines[id];
+
+            pipeline.topology    = static_cast<vk::PrimitiveTopology>(chunk.read<uint32_t>());
+            pipeline.polygonMode = static_cast<vk::PolygonMode>(chunk.read<uint32_t>());
+            pipeline.cullMode    = static_cast<vk::CullModeFlags>(chunk.read<uint32_t>());
+            pipeline.frontFace   = static_cast<vk::FrontFace>(chunk.read<uint32_t>());
+
+            pipeline.vertexShader.resize(chunk.read<uint32_t>());
+            chunk.readBytes(pipeline.vertexShader.data(), pipeline.vertexShader.size());
+            pipeline.fragmentShader.resize(chunk.read<uint32_t>());
+            chunk.readBytes(pipeline.fragmentShader.data(), pipeline.fragmentShader.size());
+            break;
+        }
+        case CaptureChunk::Commands:
+            capture.commands = std::move(chunk);
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (!hasRenderTarget)
+    {
+        throw std::runtime_error("frame capture '" + path + "' has no render target");
+    }
+
+    if (capture.commands.data().empty())
+    {
+        throw std::runtime_error("frame capture '" + path + "' has no commands");
+    }
+
+    return capture;
+}
@@ -0,0 +1,256 @@
+#include <common/job-system.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Micro-benchmark of the job system: job throughput and scheduling latency for an
+// increasing number of threads, written as JSON to stdout.
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchmarkSettings
+{
+    uint32_t jobCount      = 1U << 20; // Jobs per throughput run
+    uint32_t jobWork       = 100;      // Iterations of busy work per job
+    uint32_t latencySample = 10000;    // Jobs per latency run
+    uint32_t maxThreads    = std::max(std::thread::hardware_concurrency(), 1U);
+};
+
+struct BenchmarkResult
+{
+    uint32_t threadCount   = 0; // Workers plus the thread that starts the jobs
+    double   jobsPerSecond = 0.0;
+    double   speedup       = 0.0; // Throughput relative to a single thread
+
+    // Submit to start of execution, in microseconds. Hot means the workers are still spinning
+    // after the previous job, cold means they had time to go to sleep since then.
+    std::vector<double> hotLatencies;
+    std::vector<double> coldLatencies;
+};
+
+static BenchmarkSettings parseCommandLine(int argc, char** argv)
+{
+    BenchmarkSettings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+
+        auto nextValue = [&]() -> uint32_t {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("missing value for option '" + option + "'");
+            }
+            return static_cast<uint32_t>(std::stoul(argv[++i]));
+        };
+
+        if (option == "--jobs")
+        {
+            settings.jobCount = std::max(nextValue(), 1U);
+        }
+        else if (option == "--work")
+        {
+            settings.jobWork = nextValue();
+        }
+        else if (option == "--latency-samples")
+        {
+            settings.latencySample = std::max(nextValue(), 1U);
+        }
+        else if (option == "--max-threads")
+        {
+            settings.maxThreads = std::max(nextValue(), 1U);
+        }
+        else
+        {
+            throw std::runtime_error("unknown option '" + option + "'");
+        }
+    }
+
+    return settings;
+}
+
+// A few nanoseconds of work the compiler can't optimize away
+static void busyWork(uint32_t iterations, std::atomic<uint32_t>& sink)
+{
+    uint32_t value = iterations;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        value = value * 1664525U + 1013904223U;
+    }
+    sink.fetch_add(value & 1U, std::memory_order_relaxed);
+}
+
+// Spawning is spread over the threads like in a frame: the starting thread creates one job
+// per batch, each of which creates the leaf jobs on the deque of the thread running it
+static double measureThroughput(JobSystem& jobSystem, BenchmarkSettings const& settings)
+{
+    constexpr uint32_t BATCH_SIZE = 1024;
+
+    std::atomic<uint32_t> sink{0};
+    JobCounter            counter;
+
+    auto start = Clock::now();
+
+    for (uint32_t first = 0; first < settings.jobCount; first += BATCH_SIZE)
+    {
+        uint32_t count = std::min(BATCH_SIZE, settings.jobCount - first);
+
+        auto spawnBatch = [&jobSystem, &settings, &sink, &counter, count]() {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                jobSystem.run([&settings, &sink]() { busyWork(settings.jobWork, sink); }, &counter);
+            }
+        };
+
+        jobSystem.run(spawnBatch, &counter);
+    }
+
+    jobSystem.wait(counter);
+
+    std::chrono::duration<double> duration = Clock::now() - start;
+    return settings.jobCount / duration.count();
+}
+
+// The starting thread doesn't help while waiting, so every job has to be stolen by a worker
+static std::vector<double> measureLatency(JobSystem& jobSystem, uint32_t sampleCount, Clock::duration pause)
+{
+    std::vector<double> latencies;
+    latencies.reserve(sampleCount);
+
+    for (uint32_t i = 0; i < sampleCount; ++i)
+    {
+        JobCounter        counter;
+        Clock::time_point started;
+
+        auto submitted = Clock::now();
+        jobSystem.run([&started]() { started = Clock::now(); }, &counter);
+
+        while (!counter.isDone())
+        {
+            std::this_thread::yield();
+        }
+
+        latencies.push_back(std::chrono::duration<double, std::micro>(started - submitted).count());
+
+        if (pause > Clock::duration::zero())
+        {
+            std::this_thread::sleep_for(pause);
+        }
+    }
+
+    return latencies;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+
+    std::sort(std::begin(values), std::end(values));
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static void writeLatency(std::ostream& stream, char const* name, std::vector<double> const& latencies)
+{
+    stream << "      \"" << name << "\": ";
+    if (latencies.empty())
+    {
+        // Without workers nothing can steal the jobs
+        stream << "null";
+        return;
+    }
+
+    stream << "{\"p50\": " << percentile(latencies, 0.5)
+           << ", \"p99\": " << percentile(latencies, 0.99)
+           << ", \"max\": " << percentile(latencies, 1.0) << "}";
+}
+
+static void writeReport(std::ostream& stream, BenchmarkSettings const& settings, std::vector<BenchmarkResult> const& results)
+{
+    stream << std::fixed << std::setprecision(3);
+    stream << "{\n";
+    stream << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    stream << "  \"jobs\": " << settings.jobCount << ",\n";
+    stream << "  \"work_per_job\": " << settings.jobWork << ",\n";
+    stream << "  \"runs\": [\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        auto const& result = results[i];
+
+        stream << "    {\n";
+        stream << "      \"threads\": " << result.threadCount << ",\n";
+        stream << "      \"jobs_per_second\": " << result.jobsPerSecond << ",\n";
+        stream << "      \"speedup\": " << result.speedup << ",\n";
+        writeLatency(stream, "hot_latency_us", result.hotLatencies);
+        stream << ",\n";
+        writeLatency(stream, "cold_latency_us", result.coldLatencies);
+        stream << "\n";
+        stream << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    stream << "  ]\n";
+    stream << "}" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        BenchmarkSettings settings = parseCommandLine(argc, argv);
+
+        // Powers of two up to the maximum, plus the maximum itself
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t threads = 1; threads < settings.maxThreads; threads *= 2)
+        {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(settings.maxThreads);
+
+        std::vector<BenchmarkResult> results;
+        for (uint32_t threads : threadCounts)
+        {
+            std::cerr << "running with " << threads << " thread(s)..." << std::endl;
+
+            JobSystem jobSystem(threads - 1);
+
+            // Warm up, so the first run doesn't pay for page faults of the job allocations
+            measureThroughput(jobSystem, settings);
+
+            BenchmarkResult result;
+            result.threadCount   = threads;
+            result.jobsPerSecond = measureThroughput(jobSystem, settings);
+            result.speedup       = results.empty() ? 1.0 : result.jobsPerSecond / results.front().jobsPerSecond;
+
+            if (jobSystem.workerCount() > 0)
+            {
+                result.hotLatencies  = measureLatency(jobSystem, settings.latencySample, Clock::duration::zero());
+                // A fraction of the samples, every one of them takes the pause
+                result.coldLatencies = measureLatency(jobSystem, std::max(settings.latencySample / 20, 1U), std::chrono::milliseconds(2));
+            }
+
+            results.push_back(result);
+        }
+
+        writeReport(std::cout, settings, results);
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,494 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class JobSystem;
+
+// Counts the jobs that are still running for something the caller wants to wait on.
+//
+// A counter is incremented when a job is started with it and decremented once the job has
+// finished, so it can be waited on (JobSystem::wait) or used as dependency of other jobs
+// (JobSystem::runAfter). It can be reused once it reached zero again.
+// The first exception thrown by one of its jobs is kept and can be rethrown by the waiter.
+class JobCounter
+{
+public:
+    JobCounter() = default;
+
+    JobCounter(JobCounter const&)            = delete;
+    JobCounter& operator=(JobCounter const&) = delete;
+
+    bool isDone() const
+    {
+        return m_pending.load() == 0 && m_finishing.load() == 0;
+    }
+
+    // Rethrow the first exception thrown by a job of this counter, if any, and clear it
+    void rethrowIfFailed()
+    {
+        std::exception_ptr exception;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::swap(exception, m_exception);
+        }
+
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+private:
+    friend class JobSystem;
+
+    struct Job;
+
+    void fail(std::exception_ptr exception)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_exception)
+        {
+            m_exception = exception;
+        }
+    }
+
+    std::atomic<uint32_t> m_pending{0};
+    // Jobs that are past their function but still touching the counter. Waiters have to
+    // wait for them too, otherwise the counter could be destroyed under their feet.
+    std::atomic<uint32_t> m_finishing{0};
+
+    // Only taken when a dependent job is added or the counter reaches zero, never
+    // while jobs are pushed or stolen
+    std::mutex         m_mutex;
+    std::vector<Job*>  m_continuations; // Jobs started once the counter reaches zero
+    std::exception_ptr m_exception;
+};
+
+struct JobCounter::Job
+{
+    std::function<void()> function;
+    JobCounter*           counter = nullptr; // Optional, decremented once the function returned
+};
+
+// Work stealing job system without fibers.
+//
+// Every worker thread owns a Chase-Lev deque: it pushes and pops jobs at the bottom without
+// locks, idle workers steal from the top of the other deques. The thread creating the job
+// system takes part as well with a deque of its own, so jobs started by the frame loop
+// are pushed without locks, and waiting on a counter executes jobs instead of blocking.
+// Jobs started from threads that are not part of the system go through a locked queue.
+//
+// Jobs without a counter must not throw, there is nobody who could observe the exception.
+class JobSystem
+{
+public:
+    // One worker per hardware thread besides the one creating the job system
+    static uint32_t defaultWorkerCount()
+    {
+        return std::max(std::thread::hardware_concurrency(), 2U) - 1U;
+    }
+
+    explicit JobSystem(uint32_t workerCount = defaultWorkerCount())
+        : m_queues(workerCount + 1)
+        , m_ownerThread(std::this_thread::get_id())
+    {
+        for (uint32_t i = 1; i <= workerCount; ++i)
+        {
+            m_workers.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    // Finishes all jobs started so far before the workers are stopped
+    ~JobSystem()
+    {
+        while (m_outstanding.load(std::memory_order_acquire) > 0)
+        {
+            if (!executeOne())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        m_stop.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_wakeUp.notify_all();
+        }
+
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    JobSystem(JobSystem const&)            = delete;
+    JobSystem& operator=(JobSystem const&) = delete;
+
+    uint32_t workerCount() const
+    {
+        return static_cast<uint32_t>(m_workers.size());
+    }
+
+    // Start a job, the counter (if any) must outlive the job
+    void run(std::function<void()> function, JobCounter* counter = nullptr)
+    {
+        schedule(createJob(std::move(function), counter));
+    }
+
+    // Start a job once all jobs of the dependency have finished
+    void runAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter = nullptr)
+    {
+        Job* job = createJob(std::move(function), counter);
+
+        {
+            std::lock_guard<std::mutex> lock(dependency.m_mutex);
+            if (dependency.m_pending.load() > 0)
+            {
+                dependency.m_continuations.push_back(job);
+                return;
+            }
+        }
+
+        schedule(job);
+    }
+
+    // Split [0, count) into batches and run the function on each of them
+    void parallelFor(uint32_t count, uint32_t batchSize, std::function<void(uint32_t begin, uint32_t end)> const& function, JobCounter& counter)
+    {
+        batchSize = std::max(batchSize, 1U);
+
+        for (uint32_t begin = 0; begin < count; begin += batchSize)
+        {
+            uint32_t end = std::min(begin + batchSize, count);
+            run([function, begin, end]() { function(begin, end); }, &counter);
+        }
+    }
+
+    // Execute jobs until all jobs of the counter have finished. Never throws, the exceptions
+    // of the jobs are kept in the counter (see JobCounter::rethrowIfFailed).
+    void wait(JobCounter const& counter)
+    {
+        while (!counter.isDone())
+        {
+            if (!executeOne())
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    using Job = JobCounter::Job;
+
+    // Chase-Lev deque with a fixed capacity, following "Correct and Efficient Work-Stealing
+    // for Weak Memory Models" (Lê et al.). Only the owning thread calls push and pop,
+    // any thread may steal.
+    class WorkStealingDeque
+    {
+    public:
+        static constexpr int64_t CAPACITY = 4096;
+
+        bool push(Job* job)
+        {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            int64_t top    = m_top.load(std::memory_order_acquire);
+
+            if (bottom - top >= CAPACITY)
+            {
+                return false;
+            }
+
+            // The release store publishes the job to thieves reading bottom with acquire
+            m_jobs[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        Job* pop()
+        {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = m_top.load(std::memory_order_relaxed);
+
+            if (top > bottom)
+            {
+                // Empty
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job* job = m_jobs[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+
+            if (top == bottom)
+            {
+                // Last job, race against the thieves for it
+                if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    job = nullptr;
+                }
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+
+            return job;
+        }
+
+        Job* steal()
+        {
+            int64_t top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+            if (top >= bottom)
+            {
+                return nullptr;
+            }
+
+            Job* job = m_jobs[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                // Lost against the owner or another thief
+                return nullptr;
+            }
+
+            return job;
+        }
+
+    private:
+        // Separate cache lines, top is written by thieves and bottom by the owner
+        alignas(64) std::atomic<int64_t> m_top{0};
+        alignas(64) std::atomic<int64_t> m_bottom{0};
+        alignas(64) std::array<std::atomic<Job*>, CAPACITY> m_jobs{};
+    };
+
+    // Index of the deque owned by the calling thread, or none for outside threads
+    static constexpr uint32_t NO_QUEUE = UINT32_MAX;
+
+    struct ThreadContext
+    {
+        JobSystem const* system = nullptr;
+        uint32_t         queue  = NO_QUEUE;
+        uint32_t         random = 0x9E3779B9U; // xorshift state to pick steal victims
+    };
+
+    static ThreadContext& threadContext()
+    {
+        static thread_local ThreadContext context;
+        return context;
+    }
+
+    uint32_t currentQueue()
+    {
+        auto& context = threadContext();
+        if (context.system != this)
+        {
+            context.system = this;
+            context.queue  = std::this_thread::get_id() == m_ownerThread ? 0U : NO_QUEUE;
+        }
+        return context.queue;
+    }
+
+    Job* createJob(std::function<void()> function, JobCounter* counter)
+    {
+        if (counter)
+        {
+            counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_outstanding.fetch_add(1, std::memory_order_relaxed);
+
+        return new Job{std::move(function), counter};
+    }
+
+    void schedule(Job* job)
+    {
+        uint32_t queue = currentQueue();
+
+        if (queue != NO_QUEUE)
+        {
+            if (!m_queues[queue].push(job))
+            {
+                // Deque full, running it right away keeps the amount of queued work bounded
+                execute(job);
+                return;
+            }
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_injectionMutex);
+            m_injectionQueue.push_back(job);
+            m_injectionSize.fetch_add(1, std::memory_order_release);
+        }
+
+        if (m_sleeping.load(std::memory_order_acquire) > 0)
+        {
+            m_wakeUp.notify_one();
+        }
+    }
+
+    Job* findJob()
+    {
+        uint32_t queue = currentQueue();
+
+        if (queue != NO_QUEUE)
+        {
+            if (Job* job = m_queues[queue].pop())
+            {
+                return job;
+            }
+        }
+
+        if (m_injectionSize.load(std::memory_order_acquire) > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_injectionMutex);
+            if (!m_injectionQueue.empty())
+            {
+                Job* job = m_injectionQueue.front();
+                m_injectionQueue.pop_front();
+                m_injectionSize.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+
+        // Start at a random victim so thieves don't all hammer the same deque
+        auto& random = threadContext().random;
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+
+        uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+        for (uint32_t i = 0; i < queueCount; ++i)
+        {
+            uint32_t victim = (random + i) % queueCount;
+            if (victim == queue)
+            {
+                continue;
+            }
+
+            if (Job* job = m_queues[victim].steal())
+            {
+                return job;
+            }
+        }
+
+        return nullptr;
+    }
+
+    bool executeOne()
+    {
+        Job* job = findJob();
+        if (!job)
+        {
+            return false;
+        }
+
+        execute(job);
+        return true;
+    }
+
+    void execute(Job* job)
+    {
+        JobCounter* counter = job->counter;
+
+        if (counter)
+        {
+            try
+            {
+                job->function();
+            }
+            catch (...)
+            {
+                counter->fail(std::current_exception());
+            }
+        }
+        else
+        {
+            job->function();
+        }
+
+        delete job;
+
+        if (counter)
+        {
+            std::vector<Job*> continuations;
+
+            counter->m_finishing.fetch_add(1);
+            if (counter->m_pending.fetch_sub(1) == 1)
+            {
+                // Dependent jobs added before this point are taken here, later ones see
+                // the counter at zero and are scheduled right away by runAfter
+                std::lock_guard<std::mutex> lock(counter->m_mutex);
+                std::swap(continuations, counter->m_continuations);
+            }
+            // Last access to the counter
+            counter->m_finishing.fetch_sub(1);
+
+            for (Job* continuation : continuations)
+            {
+                schedule(continuation);
+            }
+        }
+
+        m_outstanding.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void workerLoop(uint32_t queue)
+    {
+        auto& context  = threadContext();
+        context.system = this;
+        context.queue  = queue;
+        context.random ^= queue * 0x85EBCA6BU;
+
+        // Spin a while before going to sleep, jobs of a frame tend to arrive in bursts
+        constexpr uint32_t SPIN_COUNT = 256;
+        uint32_t           idleCount  = 0;
+
+        while (!m_stop.load(std::memory_order_acquire))
+        {
+            if (executeOne())
+            {
+                idleCount = 0;
+                continue;
+            }
+
+            if (++idleCount < SPIN_COUNT)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // The timeout covers a wake up that raced with going to sleep
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_sleeping.fetch_add(1, std::memory_order_acq_rel);
+            m_wakeUp.wait_for(lock, std::chrono::milliseconds(1));
+            m_sleeping.fetch_sub(1, std::memory_order_acq_rel);
+            idleCount = 0;
+        }
+    }
+
+    std::vector<WorkStealingDeque> m_queues; // 0 belongs to the owner thread, the rest to the workers
+    std::vector<std::thread>       m_workers;
+    std::thread::id                m_ownerThread;
+
+    std::mutex            m_injectionMutex;
+    std::deque<Job*>      m_injectionQueue; // Jobs started by outside threads
+    std::atomic<uint32_t> m_injectionSize{0};
+
+    std::atomic<uint64_t>   m_outstanding{0}; // Started but not yet finished jobs
+    std::atomic<bool>       m_stop{false};
+    std::atomic<uint32_t>   m_sleeping{0};
+    std::mutex              m_sleepMutex;
+    std::condition_variable m_wakeUp;
+};
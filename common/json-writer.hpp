@@ -0,0 +1,205 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Streaming JSON writer, keeps track of the commas and the indentation
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::ostream& stream)
+        : m_stream(stream)
+    {
+        m_stream << std::setprecision(6);
+    }
+
+    void beginObject(char const* name = nullptr)
+    {
+        open(name, '{');
+    }
+
+    void endObject()
+    {
+        close('}');
+    }
+
+    void beginArray(char const* name = nullptr)
+    {
+        open(name, '[');
+    }
+
+    void endArray()
+    {
+        close(']');
+    }
+
+    template<typename T>
+    void field(char const* name, T const& value)
+    {
+        key(name);
+        write(value);
+    }
+
+    // An element of the current array
+    template<typename T>
+    void value(T const& value)
+    {
+        key(nullptr);
+        write(value);
+    }
+
+    // A complete JSON value written by another writer, indented to fit in here
+    void raw(char const* name, std::string const& text)
+    {
+        key(name);
+
+        std::string indentation(2 * m_empty.size(), ' ');
+        size_t      end = text.find_last_not_of('\n');
+        for (size_t i = 0; end != std::string::npos && i <= end; ++i)
+        {
+            m_stream << text[i];
+            if (text[i] == '\n')
+            {
+                m_stream << indentation;
+            }
+        }
+    }
+
+private:
+    void key(char const* name)
+    {
+        if (!m_empty.empty())
+        {
+            m_stream << (m_empty.back() ? "\n" : ",\n");
+            m_empty.back() = false;
+        }
+
+        m_stream << std::string(2 * m_empty.size(), ' ');
+        if (name != nullptr)
+        {
+            write(name);
+            m_stream << ": ";
+        }
+    }
+
+    void open(char const* name, char bracket)
+    {
+        key(name);
+        m_stream << bracket;
+        m_empty.push_back(true);
+    }
+
+    void close(char bracket)
+    {
+        bool empty = m_empty.back();
+        m_empty.pop_back();
+
+        if (!empty)
+        {
+            m_stream << "\n" << std::string(2 * m_empty.size(), ' ');
+        }
+        m_stream << bracket;
+
+        if (m_empty.empty())
+        {
+            m_stream << std::endl;
+        }
+    }
+
+    void write(bool value)
+    {
+        m_stream << (value ? "true" : "false");
+    }
+
+    void write(char const* value)
+    {
+        m_stream << '"';
+        for (char const* c = value; *c != '\0'; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                m_stream << '\\' << *c;
+            }
+            else if (static_cast<unsigned char>(*c) < 0x20)
+            {
+                // Control characters have to be escaped, e.g. in device names or paths
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(*c));
+                m_stream << escaped;
+            }
+            else
+            {
+                m_stream << *c;
+            }
+        }
+        m_stream << '"';
+    }
+
+    void write(std::string const& value)
+    {
+        write(value.c_str());
+    }
+
+    void write(double value)
+    {
+        // Not representable in JSON
+        if (!std::isfinite(value))
+        {
+            m_stream << "null";
+            return;
+        }
+        m_stream << value;
+    }
+
+    void write(float value)
+    {
+        write(static_cast<double>(value));
+    }
+
+    template<typename T>
+    std::enable_if_t<std::is_integral<T>::value> write(T value)
+    {
+        // Promoted, so 8-bit values aren't written as characters
+        m_stream << +value;
+    }
+
+    template<typename Bits>
+    void write(vk::Flags<Bits> const& flags)
+    {
+        m_stream << static_cast<typename vk::Flags<Bits>::MaskType>(flags);
+    }
+
+    // Also takes the array wrappers of Vulkan-Hpp, which derive from std::array
+    template<typename T, size_t N>
+    void write(std::array<T, N> const& values)
+    {
+        m_stream << "[";
+        for (size_t i = 0; i < N; ++i)
+        {
+            m_stream << (i > 0 ? ", " : "");
+            write(values[i]);
+        }
+        m_stream << "]";
+    }
+
+    std::ostream&     m_stream;
+    std::vector<bool> m_empty; // Per open object or array, whether nothing was written into it yet
+};
+
+// 64-bit values don't survive JSON parsers that read numbers as doubles, hashes are written as hex strings
+inline std::string formatHex(uint64_t value)
+{
+    std::ostringstream stream;
+    stream << std::hex << std::setw(16) << std::setfill('0') << value;
+    return stream.str();
+}
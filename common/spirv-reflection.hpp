@@ -0,0 +1,769 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Minimal SPIR-V reflection for what is needed to create pipeline layouts and vertex input state:
+// descriptor bindings, push constant ranges and vertex shader inputs.
+//
+// The module is parsed directly, since only a handful of instructions are of interest,
+// see the SPIR-V specification for the instruction and enumerant values used below.
+
+struct ShaderReflection
+{
+    struct DescriptorBinding
+    {
+        uint32_t             set;
+        uint32_t             binding;
+        vk::DescriptorType   type;
+        uint32_t             count;
+        vk::ShaderStageFlags stages;
+    };
+
+    struct VertexInput
+    {
+        uint32_t   location;
+        vk::Format format;
+        uint32_t   size;
+    };
+
+    vk::ShaderStageFlagBits              stage = vk::ShaderStageFlagBits::eVertex;
+    std::vector<DescriptorBinding>       descriptorBindings;
+    std::optional<vk::PushConstantRange> pushConstantRange;
+    std::vector<VertexInput>             vertexInputs; // Sorted by location, only filled for vertex shaders
+};
+
+namespace spirv
+{
+    // Opcodes
+    constexpr uint32_t OP_ENTRY_POINT        = 15;
+    constexpr uint32_t OP_TYPE_INT           = 21;
+    constexpr uint32_t OP_TYPE_FLOAT         = 22;
+    constexpr uint32_t OP_TYPE_VECTOR        = 23;
+    constexpr uint32_t OP_TYPE_MATRIX        = 24;
+    constexpr uint32_t OP_TYPE_IMAGE         = 25;
+    constexpr uint32_t OP_TYPE_SAMPLER       = 26;
+    constexpr uint32_t OP_TYPE_SAMPLED_IMAGE = 27;
+    constexpr uint32_t OP_TYPE_ARRAY         = 28;
+    constexpr uint32_t OP_TYPE_RUNTIME_ARRAY = 29;
+    constexpr uint32_t OP_TYPE_STRUCT        = 30;
+    constexpr uint32_t OP_TYPE_POINTER       = 32;
+    constexpr uint32_t OP_CONSTANT           = 43;
+    constexpr uint32_t OP_VARIABLE           = 59;
+    constexpr uint32_t OP_DECORATE           = 71;
+    constexpr uint32_t OP_MEMBER_DECORATE    = 72;
+
+    // Decorations
+    constexpr uint32_t DECORATION_BLOCK          = 2;
+    constexpr uint32_t DECORATION_BUFFER_BLOCK   = 3;
+    constexpr uint32_t DECORATION_ARRAY_STRIDE   = 6;
+    constexpr uint32_t DECORATION_MATRIX_STRIDE  = 7;
+    constexpr uint32_t DECORATION_BUILT_IN       = 11;
+    constexpr uint32_t DECORATION_LOCATION       = 30;
+    constexpr uint32_t DECORATION_BINDING        = 33;
+    constexpr uint32_t DECORATION_DESCRIPTOR_SET = 34;
+    constexpr uint32_t DECORATION_OFFSET         = 35;
+
+    // Storage classes
+    constexpr uint32_t STORAGE_CLASS_UNIFORM_CONSTANT = 0;
+    constexpr uint32_t STORAGE_CLASS_INPUT            = 1;
+    constexpr uint32_t STORAGE_CLASS_UNIFORM          = 2;
+    constexpr uint32_t STORAGE_CLASS_PUSH_CONSTANT    = 9;
+    constexpr uint32_t STORAGE_CLASS_STORAGE_BUFFER   = 12;
+
+    // Image dimensions
+    constexpr uint32_t DIM_BUFFER       = 5;
+    constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+    constexpr uint32_t MAGIC_NUMBER = 0x07230203;
+
+    struct Id
+    {
+        uint32_t              opcode = 0;
+        std::vector<uint32_t> operands; // Operands of the defining type instruction without the result id, constants and variables keep all operands
+
+        std::optional<uint32_t> set;
+        std::optional<uint32_t> binding;
+        std::optional<uint32_t> location;
+        std::optional<uint32_t> arrayStride;
+        bool                    builtIn     = false;
+        bool                    block       = false;
+        bool                    bufferBlock = false;
+
+        std::map<uint32_t, uint32_t> memberOffsets;
+        std::map<uint32_t, uint32_t> memberMatrixStrides;
+    };
+
+    class Module
+    {
+    public:
+        explicit Module(std::vector<uint32_t> const& words)
+        {
+            if (words.size() < 5 || words[0] != MAGIC_NUMBER)
+            {
+                throw std::runtime_error("invalid SPIR-V module");
+            }
+
+            // Every id takes at least one word to define, so a larger bound can only come from a broken module
+            if (words[3] > words.size())
+            {
+                throw std::runtime_error("invalid SPIR-V id bound");
+            }
+            m_ids.resize(words[3]);
+
+            for (size_t i = 5; i < words.size();)
+            {
+                uint32_t opcode    = words[i] & 0xFFFFU;
+                uint32_t wordCount = words[i] >> 16U;
+
+                if (wordCount == 0 || i + wordCount > words.size())
+                {
+                    throw std::runtime_error("invalid SPIR-V instruction");
+                }
+
+                parseInstruction(opcode, &words[i + 1], wordCount - 1);
+                i += wordCount;
+            }
+        }
+
+        std::optional<uint32_t> executionModel;
+        std::vector<uint32_t>   variables;
+
+        Id const& id(uint32_t i) const
+        {
+            if (i >= m_ids.size())
+            {
+                throw std::runtime_error("invalid SPIR-V id");
+            }
+            return m_ids[i];
+        }
+
+    private:
+        // Operands (including result type and result id) the reflection reads of an instruction
+        static uint32_t minimumOperandCount(uint32_t opcode)
+        {
+            switch (opcode)
+            {
+            case OP_ENTRY_POINT:
+                return 1;
+            case OP_DECORATE:
+                return 2;
+            case OP_TYPE_SAMPLER:
+            case OP_TYPE_STRUCT:
+                return 1;
+            case OP_TYPE_FLOAT:
+            case OP_TYPE_SAMPLED_IMAGE:
+            case OP_TYPE_RUNTIME_ARRAY:
+                return 2;
+            case OP_TYPE_INT:
+            case OP_TYPE_VECTOR:
+            case OP_TYPE_MATRIX:
+            case OP_TYPE_ARRAY:
+            case OP_TYPE_POINTER:
+            case OP_CONSTANT:
+            case OP_VARIABLE:
+                return 3;
+            case OP_TYPE_IMAGE:
+                return 7;
+            default:
+                return 0;
+            }
+        }
+
+        void parseInstruction(uint32_t opcode, uint32_t const* operands, uint32_t count)
+        {
+            if (count < minimumOperandCount(opcode))
+            {
+                throw std::runtime_error("invalid SPIR-V instruction, too few operands");
+            }
+
+            switch (opcode)
+            {
+            case OP_ENTRY_POINT:
+                // Only the first entry point is of interest, the samples use one per module
+                if (!executionModel)
+                {
+                    executionModel = operands[0];
+                }
+                break;
+            case OP_DECORATE:
+                decorate(operands, count);
+                break;
+            case OP_MEMBER_DECORATE:
+                if (count >= 4 && operands[2] == DECORATION_OFFSET)
+                {
+                    at(operands[0]).memberOffsets[operands[1]] = operands[3];
+                }
+                else if (count >= 4 && operands[2] == DECORATION_MATRIX_STRIDE)
+                {
+                    at(operands[0]).memberMatrixStrides[operands[1]] = operands[3];
+                }
+                break;
+            case OP_TYPE_INT:
+            case OP_TYPE_FLOAT:
+            case OP_TYPE_VECTOR:
+            case OP_TYPE_MATRIX:
+            case OP_TYPE_IMAGE:
+            case OP_TYPE_SAMPLER:
+            case OP_TYPE_SAMPLED_IMAGE:
+            case OP_TYPE_ARRAY:
+            case OP_TYPE_RUNTIME_ARRAY:
+            case OP_TYPE_STRUCT:
+            case OP_TYPE_POINTER:
+                define(opcode, operands[0], operands + 1, count - 1);
+                break;
+            case OP_CONSTANT:
+            case OP_VARIABLE:
+                // Result type comes first for these
+                define(opcode, operands[1], operands, count);
+                if (opcode == OP_VARIABLE)
+                {
+                    variables.push_back(operands[1]);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        void decorate(uint32_t const* operands, uint32_t count)
+        {
+            Id& target = at(operands[0]);
+
+            switch (operands[1])
+            {
+            case DECORATION_BLOCK:
+                target.block = true;
+                break;
+            case DECORATION_BUFFER_BLOCK:
+                target.bufferBlock = true;
+                break;
+            case DECORATION_BUILT_IN:
+                target.builtIn = true;
+                break;
+            case DECORATION_ARRAY_STRIDE:
+                if (count >= 3)
+                {
+                    target.arrayStride = operands[2];
+                }
+                break;
+            case DECORATION_LOCATION:
+                if (count >= 3)
+                {
+                    target.location = operands[2];
+                }
+                break;
+            case DECORATION_BINDING:
+                if (count >= 3)
+                {
+                    target.binding = operands[2];
+                }
+                break;
+            case DECORATION_DESCRIPTOR_SET:
+                if (count >= 3)
+                {
+                    target.set = operands[2];
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        void define(uint32_t opcode, uint32_t result, uint32_t const* operands, uint32_t count)
+        {
+            Id& id     = at(result);
+            id.opcode  = opcode;
+            id.operands.assign(operands, operands + count);
+        }
+
+        Id& at(uint32_t i)
+        {
+            if (i >= m_ids.size())
+            {
+                throw std::runtime_error("invalid SPIR-V id");
+            }
+            return m_ids[i];
+        }
+
+        std::vector<Id> m_ids;
+    };
+
+    inline uint32_t constantValue(Module const& module, uint32_t constantId)
+    {
+        Id const& constant = module.id(constantId);
+        if (constant.opcode != OP_CONSTANT || constant.operands.size() < 3)
+        {
+            throw std::runtime_error("unsupported SPIR-V array length");
+        }
+        // Operands are result type, result id, value
+        return constant.operands[2];
+    }
+
+    // Size in bytes of a type in a buffer block
+    inline uint32_t typeSize(Module const& module, uint32_t typeId, uint32_t matrixStride = 0)
+    {
+        Id const& type = module.id(typeId);
+
+        switch (type.opcode)
+        {
+        case OP_TYPE_INT:
+        case OP_TYPE_FLOAT:
+            return type.operands[0] / 8;
+        case OP_TYPE_VECTOR:
+            return typeSize(module, type.operands[0]) * type.operands[1];
+        case OP_TYPE_MATRIX:
+            return (matrixStride > 0 ? matrixStride : typeSize(module, type.operands[0])) * type.operands[1];
+        case OP_TYPE_ARRAY:
+        {
+            uint32_t stride = type.arrayStride.value_or(typeSize(module, type.operands[0]));
+            return stride * constantValue(module, type.operands[1]);
+        }
+        case OP_TYPE_STRUCT:
+        {
+            uint32_t size = 0;
+            for (uint32_t member = 0; member < type.operands.size(); ++member)
+            {
+                auto     offset       = type.memberOffsets.find(member);
+                auto     stride       = type.memberMatrixStrides.find(member);
+                uint32_t memberOffset = offset != std::end(type.memberOffsets) ? offset->second : size;
+                uint32_t memberStride = stride != std::end(type.memberMatrixStrides) ? stride->second : 0;
+                size                  = std::max(size, memberOffset + typeSize(module, type.operands[member], memberStride));
+            }
+            return size;
+        }
+        default:
+            throw std::runtime_error("unsupported SPIR-V type in buffer block");
+        }
+    }
+
+    inline vk::Format vertexInputFormat(Module const& module, uint32_t typeId)
+    {
+        Id const& type = module.id(typeId);
+
+        uint32_t componentCount = 1;
+        Id const* component     = &type;
+        if (type.opcode == OP_TYPE_VECTOR)
+        {
+            componentCount = type.operands[1];
+            component      = &module.id(type.operands[0]);
+        }
+
+        if (component->operands.empty() || component->operands[0] != 32)
+        {
+            throw std::runtime_error("unsupported vertex input type, only 32 bit components are supported");
+        }
+
+        static vk::Format const floatFormats[] = {vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat};
+        static vk::Format const sintFormats[]  = {vk::Format::eR32Sint, vk::Format::eR32G32Sint, vk::Format::eR32G32B32Sint, vk::Format::eR32G32B32A32Sint};
+        static vk::Format const uintFormats[]  = {vk::Format::eR32Uint, vk::Format::eR32G32Uint, vk::Format::eR32G32B32Uint, vk::Format::eR32G32B32A32Uint};
+
+        if (componentCount < 1 || componentCount > 4)
+        {
+            throw std::runtime_error("unsupported vertex input type");
+        }
+
+        if (component->opcode == OP_TYPE_FLOAT)
+        {
+            return floatFormats[componentCount - 1];
+        }
+        else if (component->opcode == OP_TYPE_INT)
+        {
+            // Second operand is the signedness
+            return component->operands[1] ? sintFormats[componentCount - 1] : uintFormats[componentCount - 1];
+        }
+
+        throw std::runtime_error("unsupported vertex input type");
+    }
+
+    inline vk::ShaderStageFlagBits shaderStage(uint32_t executionModel)
+    {
+        switch (executionModel)
+        {
+        case 0:
+            return vk::ShaderStageFlagBits::eVertex;
+        case 1:
+            return vk::ShaderStageFlagBits::eTessellationControl;
+        case 2:
+            return vk::ShaderStageFlagBits::eTessellationEvaluation;
+        case 3:
+            return vk::ShaderStageFlagBits::eGeometry;
+        case 4:
+            return vk::ShaderStageFlagBits::eFragment;
+        case 5:
+            return vk::ShaderStageFlagBits::eCompute;
+        default:
+            throw std::runtime_error("unsupported SPIR-V execution model");
+        }
+    }
+
+    // Determine the descriptor type of a resource variable, the type is the pointee type of the variable
+    inline std::optional<vk::DescriptorType> descriptorType(uint32_t storageClass, Id const& type)
+    {
+        if (storageClass == STORAGE_CLASS_STORAGE_BUFFER)
+        {
+            return vk::DescriptorType::eStorageBuffer;
+        }
+        else if (storageClass == STORAGE_CLASS_UNIFORM)
+        {
+            return type.bufferBlock ? vk::DescriptorType::eStorageBuffer : vk::DescriptorType::eUniformBuffer;
+        }
+        else if (storageClass != STORAGE_CLASS_UNIFORM_CONSTANT)
+        {
+            return std::nullopt;
+        }
+
+        switch (type.opcode)
+        {
+        case OP_TYPE_SAMPLER:
+            return vk::DescriptorType::eSampler;
+        case OP_TYPE_SAMPLED_IMAGE:
+            return vk::DescriptorType::eCombinedImageSampler;
+        case OP_TYPE_IMAGE:
+        {
+            // Operands are sampled type, dim, depth, arrayed, multisampled, sampled, format
+            uint32_t dim     = type.operands[1];
+            uint32_t sampled = type.operands[5];
+            if (dim == DIM_BUFFER)
+            {
+                return sampled == 1 ? vk::DescriptorType::eUniformTexelBuffer : vk::DescriptorType::eStorageTexelBuffer;
+            }
+            else if (dim == DIM_SUBPASS_DATA)
+            {
+                return vk::DescriptorType::eInputAttachment;
+            }
+            return sampled == 1 ? vk::DescriptorType::eSampledImage : vk::DescriptorType::eStorageImage;
+        }
+        default:
+            return std::nullopt;
+        }
+    }
+} // namespace spirv
+
+inline ShaderReflection reflectShader(std::vector<uint32_t> const& words)
+{
+    spirv::Module module(words);
+
+    if (!module.executionModel)
+    {
+        throw std::runtime_error("SPIR-V module has no entry point");
+    }
+
+    ShaderReflection reflection;
+    reflection.stage = spirv::shaderStage(module.executionModel.value());
+
+    for (uint32_t variableId : module.variables)
+    {
+        spirv::Id const& variable = module.id(variableId);
+
+        // Operands are result type, result id, storage class
+        uint32_t         storageClass = variable.operands[2];
+        spirv::Id const& pointer      = module.id(variable.operands[0]);
+        if (pointer.opcode != spirv::OP_TYPE_POINTER)
+        {
+            throw std::runtime_error("invalid SPIR-V variable, its type is not a pointer");
+        }
+        uint32_t typeId = pointer.operands[1];
+
+        if (storageClass == spirv::STORAGE_CLASS_PUSH_CONSTANT)
+        {
+            vk::PushConstantRange range;
+            range.stageFlags             = reflection.stage;
+            range.offset                 = 0;
+            range.size                   = spirv::typeSize(module, typeId);
+            reflection.pushConstantRange = range;
+        }
+        else if (storageClass == spirv::STORAGE_CLASS_INPUT)
+        {
+            // Built-ins (like the vertex index) and inputs of other stages don't need vertex attributes
+            if (reflection.stage != vk::ShaderStageFlagBits::eVertex || variable.builtIn || !variable.location)
+            {
+                continue;
+            }
+
+            vk::Format format = spirv::vertexInputFormat(module, typeId);
+            reflection.vertexInputs.push_back({variable.location.value(), format, spirv::typeSize(module, typeId)});
+        }
+        else if (storageClass == spirv::STORAGE_CLASS_UNIFORM_CONSTANT ||
+                 storageClass == spirv::STORAGE_CLASS_UNIFORM ||
+                 storageClass == spirv::STORAGE_CLASS_STORAGE_BUFFER)
+        {
+            // Arrays of resources use one binding with multiple descriptors
+            uint32_t         count = 1;
+            spirv::Id const* type  = &module.id(typeId);
+            if (type->opcode == spirv::OP_TYPE_ARRAY)
+            {
+                count = spirv::constantValue(module, type->operands[1]);
+                type  = &module.id(type->operands[0]);
+            }
+            else if (type->opcode == spirv::OP_TYPE_RUNTIME_ARRAY)
+            {
+                throw std::runtime_error("runtime arrays of descriptors are not supported");
+            }
+
+            auto descriptorType = spirv::descriptorType(storageClass, *type);
+            if (!descriptorType)
+            {
+                continue;
+            }
+
+            reflection.descriptorBindings.push_back({variable.set.value_or(0), variable.binding.value_or(0), descriptorType.value(), count, reflection.stage});
+        }
+    }
+
+    std::sort(std::begin(reflection.vertexInputs), std::end(reflection.vertexInputs),
+              [](auto const& a, auto const& b) { return a.location < b.location; });
+
+    return reflection;
+}
+
+inline ShaderReflection reflectShader(std::vector<char> const& code)
+{
+    if (code.size() % sizeof(uint32_t) != 0)
+    {
+        throw std::runtime_error("invalid SPIR-V code size");
+    }
+
+    std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+    std::memcpy(words.data(), code.data(), code.size());
+
+    return reflectShader(words);
+}
+
+// Vertex input state for a single interleaved vertex buffer in binding 0,
+// with the attributes packed in the order of their locations.
+struct VertexInputLayout
+{
+    std::vector<vk::VertexInputBindingDescription>   bindings;
+    std::vector<vk::VertexInputAttributeDescription> attributes;
+
+    explicit VertexInputLayout(ShaderReflection const& vertexShader)
+    {
+        uint32_t offset = 0;
+        for (auto const& input : vertexShader.vertexInputs)
+        {
+            attributes.push_back(vk::VertexInputAttributeDescription(input.location, 0, input.format, offset));
+            offset += input.size;
+        }
+
+        if (!attributes.empty())
+        {
+            bindings.push_back(vk::VertexInputBindingDescription(0, offset, vk::VertexInputRate::eVertex));
+        }
+    }
+
+    vk::PipelineVertexInputStateCreateInfo createInfo() const
+    {
+        vk::PipelineVertexInputStateCreateInfo info;
+        info.vertexBindingDescriptionCount   = static_cast<uint32_t>(bindings.size());
+        info.pVertexBindingDescriptions      = bindings.data();
+        info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+        info.pVertexAttributeDescriptions    = attributes.data();
+        return info;
+    }
+};
+
+// Creates descriptor set layouts and pipeline layouts from the reflection of all stages of a pipeline.
+// Identical layouts are only created once and shared, so pipelines with the same interface
+// end up with the same (and therefore compatible) layout objects.
+//
+// Thread-safe, layouts live until destroy() is called.
+class PipelineLayoutCache
+{
+public:
+    explicit PipelineLayoutCache(vk::Device device = vk::Device())
+        : m_device(device)
+    {
+    }
+
+    void setDevice(vk::Device device)
+    {
+        m_device = device;
+    }
+
+    vk::PipelineLayout getPipelineLayout(std::vector<ShaderReflection> const& stages)
+    {
+        // Merge the bindings and push constants of all stages
+        std::map<std::pair<uint32_t, uint32_t>, ShaderReflection::DescriptorBinding> bindings;
+        std::optional<vk::PushConstantRange>                                          pushConstantRange;
+
+        for (auto const& stage : stages)
+        {
+            for (auto const& binding : stage.descriptorBindings)
+            {
+                auto it = bindings.find({binding.set, binding.binding});
+                if (it == std::end(bindings))
+                {
+                    bindings.emplace(std::make_pair(binding.set, binding.binding), binding);
+                }
+                else if (it->second.type != binding.type || it->second.count != binding.count)
+                {
+                    throw std::runtime_error("conflicting descriptor declarations for set " + std::to_string(binding.set) + ", binding " + std::to_string(binding.binding));
+                }
+                else
+                {
+                    it->second.stages |= binding.stages;
+                }
+            }
+
+            if (stage.pushConstantRange)
+            {
+                if (!pushConstantRange)
+                {
+                    pushConstantRange = stage.pushConstantRange;
+                }
+                else
+                {
+                    pushConstantRange->stageFlags |= stage.pushConstantRange->stageFlags;
+                    pushConstantRange->size = std::max(pushConstantRange->size, stage.pushConstantRange->size);
+                }
+            }
+        }
+
+        // Group the bindings by set, sets without bindings in between get an empty layout
+        uint32_t setCount = bindings.empty() ? 0 : std::prev(std::end(bindings))->first.first + 1;
+        std::vector<std::vector<vk::DescriptorSetLayoutBinding>> setBindings(setCount);
+        for (auto const& entry : bindings)
+        {
+            auto const& binding = entry.second;
+            setBindings[binding.set].push_back(vk::DescriptorSetLayoutBinding(binding.binding, binding.type, binding.count, binding.stages));
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::vector<vk::DescriptorSetLayout> setLayouts;
+        for (auto const& set : setBindings)
+        {
+            setLayouts.push_back(getDescriptorSetLayoutLocked(set));
+        }
+
+        Key key;
+        for (auto setLayout : setLayouts)
+        {
+            appendHandle(key, setLayout);
+        }
+        if (pushConstantRange)
+        {
+            key.insert(std::end(key), {static_cast<uint32_t>(pushConstantRange->stageFlags), pushConstantRange->offset, pushConstantRange->size});
+        }
+
+        auto it = m_pipelineLayouts.find(key);
+        if (it != std::end(m_pipelineLayouts))
+        {
+            ++m_hits;
+            return it->second;
+        }
+
+        vk::PipelineLayoutCreateInfo createInfo;
+        createInfo.setLayoutCount         = static_cast<uint32_t>(setLayouts.size());
+        createInfo.pSetLayouts            = setLayouts.data();
+        createInfo.pushConstantRangeCount = pushConstantRange ? 1U : 0U;
+        createInfo.pPushConstantRanges    = pushConstantRange ? &pushConstantRange.value() : nullptr;
+
+        ++m_misses;
+        return m_pipelineLayouts[key] = m_device.createPipelineLayout(createInfo);
+    }
+
+    vk::DescriptorSetLayout getDescriptorSetLayout(std::vector<vk::DescriptorSetLayoutBinding> const& bindings)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return getDescriptorSetLayoutLocked(bindings);
+    }
+
+    // Number of requests that were served from the cache and that had to create a new pipeline layout
+    size_t hits() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_hits;
+    }
+
+    size_t misses() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_misses;
+    }
+
+    void destroy()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto const& entry : m_pipelineLayouts)
+        {
+            m_device.destroyPipelineLayout(entry.second);
+        }
+        for (auto const& entry : m_setLayouts)
+        {
+            m_device.destroyDescriptorSetLayout(entry.second);
+        }
+
+        m_pipelineLayouts.clear();
+        m_setLayouts.clear();
+    }
+
+private:
+    // Layouts are identified by a canonical list of words describing them
+    using Key = std::vector<uint32_t>;
+
+    struct KeyHash
+    {
+        size_t operator()(Key const& key) const
+        {
+            // FNV-1a
+            uint64_t hash = 14695981039346656037ULL;
+            for (uint32_t word : key)
+            {
+                hash = (hash ^ word) * 1099511628211ULL;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    template<typename T>
+    static void appendHandle(Key& key, T handle)
+    {
+        auto value = reinterpret_cast<uint64_t>(static_cast<typename T::CType>(handle));
+        key.push_back(static_cast<uint32_t>(value));
+        key.push_back(static_cast<uint32_t>(value >> 32));
+    }
+
+    vk::DescriptorSetLayout getDescriptorSetLayoutLocked(std::vector<vk::DescriptorSetLayoutBinding> bindings)
+    {
+        std::sort(std::begin(bindings), std::end(bindings), [](auto const& a, auto const& b) { return a.binding < b.binding; });
+
+        Key key;
+        for (auto const& binding : bindings)
+        {
+            key.insert(std::end(key), {binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, static_cast<uint32_t>(binding.stageFlags)});
+        }
+
+        auto it = m_setLayouts.find(key);
+        if (it != std::end(m_setLayouts))
+        {
+            return it->second;
+        }
+
+        vk::DescriptorSetLayoutCreateInfo createInfo;
+        createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        createInfo.pBindings    = bindings.data();
+
+        return m_setLayouts[key] = m_device.createDescriptorSetLayout(createInfo);
+    }
+
+    vk::Device                                                          m_device;
+    mutable std::mutex                                                  m_mutex;
+    std::unordered_map<Key, vk::DescriptorSetLayout, KeyHash>           m_setLayouts;
+    std::unordered_map<Key, vk::PipelineLayout, KeyHash>                m_pipelineLayouts;
+    size_t                                                              m_hits   = 0;
+    size_t                                                              m_misses = 0;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Records how long each initialization stage takes and on which thread it ran,
+// relative to the creation of the profile (usually application start).
+//
+// Thread-safe, stages may be measured on worker threads.
+class StartupProfile
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    StartupProfile()
+        : m_origin(Clock::now())
+    {
+    }
+
+    // Run the function and record its duration as a stage
+    template<typename Function>
+    decltype(auto) measure(std::string const& name, Function&& function)
+    {
+        ScopedStage stage(*this, name);
+        return function();
+    }
+
+    // Record a point in time, like the first presented frame
+    void mark(std::string const& name)
+    {
+        auto now = Clock::now();
+        record(name, now, now);
+    }
+
+    void report(std::ostream& stream) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto stages = m_stages;
+        std::stable_sort(std::begin(stages), std::end(stages), [](auto const& a, auto const& b) { return a.start < b.start; });
+
+        // Number threads in order of appearance, the first one is usually the main thread
+        std::map<std::thread::id, size_t> threadNumbers;
+        double                            totalDuration = 0.0;
+        double                            end           = 0.0;
+
+        stream << "startup profile:" << std::endl;
+        stream << std::fixed << std::setprecision(3);
+
+        for (auto const& stage : stages)
+        {
+            auto threadNumber = threadNumbers.emplace(stage.thread, threadNumbers.size()).first->second;
+
+            stream << "  " << std::setw(10) << stage.start << " ms  +" << std::setw(9) << stage.duration
+                   << " ms  [thread " << threadNumber << "]  " << stage.name << std::endl;
+
+            totalDuration += stage.duration;
+            end = std::max(end, stage.start + stage.duration);
+        }
+
+        // Sum of the stage durations above the wall clock time means stages overlapped
+        stream << "  wall clock " << end << " ms, sum of stages " << totalDuration << " ms" << std::endl;
+        stream << std::defaultfloat;
+    }
+
+private:
+    struct Stage
+    {
+        std::string     name;
+        double          start;    // ms since origin
+        double          duration; // ms
+        std::thread::id thread;
+    };
+
+    class ScopedStage
+    {
+    public:
+        ScopedStage(StartupProfile& profile, std::string name)
+            : m_profile(profile)
+            , m_name(std::move(name))
+            , m_start(Clock::now())
+        {
+        }
+
+        ~ScopedStage()
+        {
+            m_profile.record(m_name, m_start, Clock::now());
+        }
+
+    private:
+        StartupProfile&   m_profile;
+        std::string       m_name;
+        Clock::time_point m_start;
+    };
+
+    void record(std::string const& name, Clock::time_point start, Clock::time_point end)
+    {
+        using Milliseconds = std::chrono::duration<double, std::milli>;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stages.push_back({name, Milliseconds(start - m_origin).count(), Milliseconds(end - start).count(), std::this_thread::get_id()});
+    }
+
+    Clock::time_point  m_origin;
+    mutable std::mutex m_mutex;
+    std::vector<Stage> m_stages;
+};
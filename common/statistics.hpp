@@ -0,0 +1,42 @@
+#pragma once
+
+#include <common/json-writer.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+inline double mean(std::vector<double> const& values)
+{
+    return values.empty() ? 0.0 : std::accumulate(std::begin(values), std::end(values), 0.0) / values.size();
+}
+
+// Nearest-rank percentile: the smallest sample that at least p of all samples are less or
+// equal to, so the result is always one of the samples. Used by all tools, so their
+// percentiles can be compared.
+inline double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+
+    std::sort(std::begin(values), std::end(values));
+
+    // The epsilon keeps e.g. 0.9 * 10 from rounding up to the next rank
+    size_t rank = static_cast<size_t>(std::ceil(std::clamp(p, 0.0, 1.0) * values.size() - 1e-9));
+    return values[std::max<size_t>(rank, 1) - 1];
+}
+
+// The summary every tool reports for a series of timings
+inline void writeSeries(JsonWriter& json, char const* name, std::vector<double> const& values)
+{
+    json.beginObject(name);
+    json.field("mean", mean(values));
+    json.field("p50", percentile(values, 0.5));
+    json.field("p90", percentile(values, 0.9));
+    json.field("p99", percentile(values, 0.99));
+    json.field("max", percentile(values, 1.0));
+    json.endObject();
+}
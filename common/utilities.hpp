@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Small helpers shared by the benchmark and the replay tool
+
+inline std::vector<char> readFile(std::string const& filename)
+{
+    std::ifstream file(filename, std::ios_base::ate | std::ios_base::binary);
+
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open file '" + filename + "'");
+    }
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    std::vector<char> buffer(fileSize);
+
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+
+    return buffer;
+}
+
+// FNV-1a, used to compare rendered images
+inline uint64_t hashBytes(uint8_t const* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Index of the first memory type allowed by typeFilter that has all the requested properties
+inline uint32_t findMemoryType(vk::PhysicalDevice const& physicalDevice, uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+{
+    auto memoryProperties = physicalDevice.getMemoryProperties();
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+    {
+        if ((typeFilter & (1U << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type");
+}